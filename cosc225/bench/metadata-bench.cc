@@ -0,0 +1,176 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Generates a metadata file in the format of keys/metadata*.keys and
+// ingests it with the parser CreateInvertedList used before
+// SearchIndex::AddMetadata and with AddMetadata over a mapped file, then
+// checks that both built the same index.
+//
+//   metadata-bench [documents] [terms per document] [file]
+//
+// Exits non-zero if the indexes differ.
+
+#include "ns3/search-index.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static const uint32_t VOCABULARY = 20000;
+
+static double
+Now ()
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Lines of "docN Tx Ty ...". Terms are drawn with a skew towards low
+// numbers, so that a few have long posting lists, as common words would
+static uint64_t
+Generate (const char *path, uint32_t documents, uint32_t terms)
+{
+  FILE *file = std::fopen (path, "w");
+  if (file == NULL)
+    {
+      return 0;
+    }
+  srand (1);
+  for (uint32_t d = 0; d < documents; d++)
+    {
+      std::fprintf (file, "doc%u", d);
+      for (uint32_t t = 0; t < terms; t++)
+        {
+          uint32_t r = rand () % VOCABULARY;
+          std::fprintf (file, " T%u", (uint32_t) ((uint64_t) r * r / VOCABULARY));
+        }
+      std::fputc ('\n', file);
+    }
+  std::fclose (file);
+  return (uint64_t) documents * terms;
+}
+
+// CreateInvertedList as it was: a line and a term at a time, each posting
+// set copied out, added to and copied back
+static void
+IngestOld (const char *path, std::map<std::string, std::set<std::string> > &index)
+{
+  std::string line;
+  std::ifstream file (path);
+  while (getline (file, line))
+    {
+      std::istringstream iss (line);
+      std::string key_term;
+      std::string document;
+      std::string temp;
+      uint32_t count = 0;
+      while (std::getline (iss, temp, ' '))
+        {
+          if (count == 0)
+            {
+              document = temp;
+              count++;
+              continue;
+            }
+          key_term = temp;
+          std::set<std::string> existing_docs (index[key_term]);
+          existing_docs.insert (document);
+          index[key_term] = existing_docs;
+        }
+    }
+}
+
+// CreateInvertedList now
+static uint32_t
+IngestMapped (const char *path, SearchIndex &index)
+{
+  int fd = open (path, O_RDONLY);
+  struct stat info;
+  if (fd < 0 || fstat (fd, &info) < 0 || info.st_size == 0)
+    {
+      return 0;
+    }
+  void *data = mmap (NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  uint32_t pairs = 0;
+  if (data != MAP_FAILED)
+    {
+      madvise (data, info.st_size, MADV_SEQUENTIAL);
+      pairs = index.AddMetadata ((const char *) data, (const char *) data + info.st_size);
+      munmap (data, info.st_size);
+    }
+  close (fd);
+  return pairs;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t documents = argc > 1 ? std::atoi (argv[1]) : 250000;
+  uint32_t terms = argc > 2 ? std::atoi (argv[2]) : 8;
+  const char *path = argc > 3 ? argv[3] : "/tmp/metadata-bench.keys";
+
+  double start = Now ();
+  uint64_t pairs = Generate (path, documents, terms);
+  if (pairs == 0)
+    {
+      std::printf ("FAIL: cannot write %s\n", path);
+      return 1;
+    }
+  struct stat info;
+  stat (path, &info);
+  std::printf ("%s: %u documents, %llu pairs, %.1f MB, written in %.2f s\n", path, documents,
+               (unsigned long long) pairs, info.st_size / 1e6, Now () - start);
+
+  StringDictionary termDictionary;
+  DocumentDictionary documentDictionary;
+  SearchIndex index (termDictionary, documentDictionary);
+  start = Now ();
+  uint32_t read = IngestMapped (path, index);
+  double mapped = Now () - start;
+  std::printf ("%-10s %10.2f s %14.0f pairs/s %10u terms %12u bytes stored\n", "AddMetadata", mapped,
+               read / mapped, index.GetSize (), index.GetByteSize ());
+
+  std::map<std::string, std::set<std::string> > old;
+  start = Now ();
+  IngestOld (path, old);
+  double parsed = Now () - start;
+  std::printf ("%-10s %10.2f s %14.0f pairs/s %10u terms (%.1fx the time)\n", "old parser", parsed,
+               pairs / parsed, (uint32_t) old.size (), parsed / mapped);
+
+  // same terms, and the same documents under each
+  bool ok = read == pairs && old.size () == index.GetSize ();
+  uint64_t postings = 0;
+  for (std::map<std::string, std::set<std::string> >::const_iterator it = old.begin (); ok && it != old.end (); it++)
+    {
+      ok = index.GetDocuments (it->first) == it->second;
+      postings += it->second.size ();
+    }
+  if (!ok)
+    {
+      std::printf ("FAIL: the two parsers built different indexes\n");
+      return 1;
+    }
+  std::printf ("both parsers built the same %llu postings\n", (unsigned long long) postings);
+  return 0;
+}
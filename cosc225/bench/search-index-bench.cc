@@ -0,0 +1,300 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Measures the posting-list codec, the front coded names a FETCH_REQ
+// carries and intersection against the document-name sets they replaced,
+// and checks that every list decodes to what was encoded and that
+// IntersectPostings agrees with std::set_intersection.
+//
+//   search-index-bench [repeats]
+//
+// Exits non-zero if a check fails.
+
+#include "ns3/search-index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <time.h>
+
+static double
+Now ()
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static double
+Best (double best, double time)
+{
+  return best < 0 || time < best ? time : best;
+}
+
+// names as the metadata files in keys/ use them, every stride-th from first
+static std::set<std::string>
+MakeDocuments (uint32_t count, uint32_t first, uint32_t stride = 1)
+{
+  std::set<std::string> documents;
+  for (uint32_t i = 0; i < count; i++)
+    {
+      std::ostringstream name;
+      name << "doc" << first + i * stride;
+      documents.insert (name.str ());
+    }
+  return documents;
+}
+
+// documents in the keys/ metadata files of a large scenario
+static const uint32_t CORPUS = 250000;
+
+// bytes of the name list STORE_REQ and FETCH_RSP carry
+static uint32_t
+GetNameBytes (const std::set<std::string> &documents)
+{
+  uint32_t bytes = sizeof (uint32_t);
+  for (std::set<std::string>::const_iterator it = documents.begin (); it != documents.end (); it++)
+    {
+      bytes += sizeof (uint16_t) + it->length ();
+    }
+  return bytes;
+}
+
+static bool
+BenchCodec (uint32_t repeats)
+{
+  static const uint32_t lengths[] = { 16, 128, 1024, 16384, 131072 };
+  bool ok = true;
+
+  // every document interned in order, as AddMetadata gives out ids
+  StringDictionary terms;
+  DocumentDictionary dictionary;
+  SearchIndex index (terms, dictionary);
+  for (uint32_t i = 0; i < CORPUS; i++)
+    {
+      std::ostringstream name;
+      name << "doc" << i;
+      dictionary.Intern (name.str ());
+    }
+  srand (1);
+
+  std::printf ("%-8s %12s %12s %12s %10s %12s %12s %12s\n", "ids", "set bytes", "name bytes", "wire bytes",
+               "ratio", "memory B/id", "encode ns/id", "decode ns/id");
+  for (uint32_t l = 0; l < sizeof (lengths) / sizeof (lengths[0]); l++)
+    {
+      // a term's documents, spread over the corpus
+      std::set<std::string> documents;
+      while (documents.size () < lengths[l])
+        {
+          std::ostringstream name;
+          name << "doc" << (uint32_t) (((uint64_t) rand () * RAND_MAX + rand ()) % CORPUS);
+          documents.insert (name.str ());
+        }
+      PostingList postings = index.ToPostings (documents);
+
+      CompressedPostings coded;
+      double start = Now ();
+      for (uint32_t r = 0; r < repeats; r++)
+        {
+          coded.Encode (postings);
+        }
+      double encode = Now () - start;
+
+      PostingList decoded;
+      start = Now ();
+      for (uint32_t r = 0; r < repeats; r++)
+        {
+          coded.Decode (decoded);
+        }
+      double decode = Now () - start;
+
+      // what a FETCH_REQ carries for the list: count, length, names
+      std::vector<uint8_t> wire;
+      EncodeNames (documents, wire);
+      std::set<std::string> received;
+      if (decoded != postings || !DecodeNames (wire, documents.size (), received) || received != documents)
+        {
+          std::printf ("FAIL: %u ids do not decode to what was encoded\n", lengths[l]);
+          ok = false;
+        }
+      uint32_t wireBytes = 2 * sizeof (uint32_t) + wire.size ();
+      uint32_t nameBytes = GetNameBytes (documents);
+      // a std::set node holds three pointers, a color and the string;
+      // names this short stay inside the string
+      uint32_t setBytes = lengths[l] * (4 * sizeof (void *) + sizeof (std::string));
+      double ids = (double) lengths[l] * repeats;
+      std::printf ("%-8u %12u %12u %12u %10.2f %12.2f %12.2f %12.2f\n", lengths[l], setBytes, nameBytes, wireBytes,
+                   (double) nameBytes / wireBytes, (double) coded.GetBytes ().size () / lengths[l],
+                   encode * 1e9 / ids, decode * 1e9 / ids);
+    }
+  return ok;
+}
+
+// ProcessFetchReq before posting lists: every pair of names compared
+static std::set<std::string>
+IntersectNested (const std::set<std::string> &a, const std::set<std::string> &b)
+{
+  std::set<std::string> common;
+  for (std::set<std::string>::const_iterator i = a.begin (); i != a.end (); i++)
+    {
+      for (std::set<std::string>::const_iterator j = b.begin (); j != b.end (); j++)
+        {
+          if (*i == *j)
+            {
+              common.insert (*i);
+            }
+        }
+    }
+  return common;
+}
+
+// Random sorted lists, some far apart in length, against
+// std::set_intersection
+static bool
+CheckIntersect (uint32_t pairs)
+{
+  srand (1);
+  uint32_t failures = 0;
+  for (uint32_t t = 0; t < pairs; t++)
+    {
+      uint32_t range = 1 + rand () % 2000;
+      uint32_t lengthA = rand () % 300;
+      uint32_t lengthB = t % 3 == 0 ? rand () % 20000 : rand () % 300;
+      PostingList a, b;
+      for (uint32_t i = 0; i < lengthA; i++)
+        {
+          a.push_back (rand () % range);
+        }
+      for (uint32_t i = 0; i < lengthB; i++)
+        {
+          b.push_back (rand () % (t % 3 == 0 ? range * 50 : range));
+        }
+      std::sort (a.begin (), a.end ());
+      a.erase (std::unique (a.begin (), a.end ()), a.end ());
+      std::sort (b.begin (), b.end ());
+      b.erase (std::unique (b.begin (), b.end ()), b.end ());
+
+      PostingList result, expected;
+      IntersectPostings (a, b, result);
+      std::set_intersection (a.begin (), a.end (), b.begin (), b.end (), std::back_inserter (expected));
+      if (result != expected)
+        {
+          failures++;
+        }
+    }
+  std::printf ("IntersectPostings against std::set_intersection: %u of %u pairs differ\n", failures, pairs);
+  return failures == 0;
+}
+
+static bool
+BenchIntersect (uint32_t repeats)
+{
+  // lengths of the two lists and how many documents they share
+  static const uint32_t lengths[][3] = { { 128, 128, 64 }, { 1024, 1024, 512 }, { 1024, 1024, 16 },
+                                         { 16384, 16384, 8192 }, { 16384, 16384, 256 },
+                                         { 128, 16384, 64 }, { 1024, 131072, 512 } };
+  bool ok = true;
+
+  std::printf ("%-16s %8s %14s %14s %14s %14s\n", "lengths", "common", "nested us", "set names us",
+               "set ids us", "Intersect us");
+  for (uint32_t l = 0; l < sizeof (lengths) / sizeof (lengths[0]); l++)
+    {
+      StringDictionary terms;
+      DocumentDictionary dictionary;
+      SearchIndex index (terms, dictionary);
+      // the shared documents are spread over the whole of b, so that no
+      // method can stop once the shorter list runs out
+      std::set<std::string> namesB = MakeDocuments (lengths[l][1], 0);
+      std::set<std::string> namesA = MakeDocuments (lengths[l][2], 0, lengths[l][1] / lengths[l][2]);
+      std::set<std::string> onlyA = MakeDocuments (lengths[l][0] - lengths[l][2], lengths[l][1]);
+      namesA.insert (onlyA.begin (), onlyA.end ());
+      index.Add ("b", namesB);
+      index.Add ("a", namesA);
+      PostingList a, b;
+      index.Find ("a", a);
+      index.Find ("b", b);
+
+      // best of the repeats, each method timed in turn so that noise on a
+      // shared machine hits all of them alike
+      double nested = -1, setNames = -1, setIds = -1, intersect = -1;
+      std::set<std::string> commonNames;
+      PostingList expected, common;
+      // runs per sample, so that a sample lasts well above the clock's
+      // resolution
+      uint32_t runs = std::max (1u, 1000000u / (lengths[l][0] + lengths[l][1]));
+      for (uint32_t r = 0; r < repeats; r++)
+        {
+          double start;
+          // the nested loop takes minutes past a few thousand names
+          if ((double) lengths[l][0] * lengths[l][1] <= 4e6 && r < 3)
+            {
+              start = Now ();
+              IntersectNested (namesA, namesB);
+              nested = Best (nested, Now () - start);
+            }
+
+          start = Now ();
+          for (uint32_t run = 0; run < runs; run++)
+            {
+              commonNames.clear ();
+              std::set_intersection (namesA.begin (), namesA.end (), namesB.begin (), namesB.end (),
+                                     std::inserter (commonNames, commonNames.end ()));
+            }
+          setNames = Best (setNames, (Now () - start) / runs);
+
+          start = Now ();
+          for (uint32_t run = 0; run < runs; run++)
+            {
+              expected.clear ();
+              std::set_intersection (a.begin (), a.end (), b.begin (), b.end (), std::back_inserter (expected));
+            }
+          setIds = Best (setIds, (Now () - start) / runs);
+
+          start = Now ();
+          for (uint32_t run = 0; run < runs; run++)
+            {
+              common.clear ();
+              IntersectPostings (a, b, common);
+            }
+          intersect = Best (intersect, (Now () - start) / runs);
+        }
+
+      if (common != expected || index.GetDocuments (common) != commonNames)
+        {
+          std::printf ("FAIL: %u x %u ids intersect differently\n", lengths[l][0], lengths[l][1]);
+          ok = false;
+        }
+      std::ostringstream label;
+      label << lengths[l][0] << " x " << lengths[l][1];
+      std::printf ("%-16s %8u %14.2f %14.2f %14.2f %14.2f\n", label.str ().c_str (), (uint32_t) common.size (),
+                   nested * 1e6, setNames * 1e6, setIds * 1e6, intersect * 1e6);
+    }
+  std::printf ("(a negative time was not measured)\n");
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t repeats = argc > 1 ? std::atoi (argv[1]) : 20;
+  bool ok = BenchCodec (repeats);
+  ok = CheckIntersect (20000) && ok;
+  ok = BenchIntersect (repeats) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/timer-wheel.h"
+
+using namespace ns3;
+
+TimerWheel::TimerWheel (Time tick, uint32_t slots)
+  : m_tickMs (tick.GetMilliSeconds () > 0 ? tick.GetMilliSeconds () : 1),
+    m_currentTick (0),
+    m_slots (slots > 0 ? slots : 1)
+{
+}
+
+uint32_t
+TimerWheel::GetSlot (int64_t tick) const
+{
+  return (uint32_t) (tick % (int64_t) m_slots.size ());
+}
+
+void
+TimerWheel::Insert (uint32_t id, Time deadline)
+{
+  Remove (id);
+  int64_t deadlineMs = deadline.GetMilliSeconds ();
+  int64_t tick = deadlineMs / m_tickMs;
+  // already due, make sure the next sweep sees it
+  if (tick < m_currentTick)
+    {
+      tick = m_currentTick;
+    }
+  uint32_t slot = GetSlot (tick);
+  m_slots[slot][id] = deadlineMs;
+  m_slotOf[id] = slot;
+}
+
+void
+TimerWheel::Remove (uint32_t id)
+{
+  std::map<uint32_t, uint32_t>::iterator it = m_slotOf.find (id);
+  if (it == m_slotOf.end ())
+    {
+      return;
+    }
+  m_slots[it->second].erase (id);
+  m_slotOf.erase (it);
+}
+
+bool
+TimerWheel::Contains (uint32_t id) const
+{
+  return m_slotOf.find (id) != m_slotOf.end ();
+}
+
+std::vector<uint32_t>
+TimerWheel::Expire (Time now)
+{
+  std::vector<uint32_t> expired;
+  int64_t nowMs = now.GetMilliSeconds ();
+  int64_t nowTick = nowMs / m_tickMs;
+  if (m_slotOf.empty ())
+    {
+      m_currentTick = nowTick;
+      return expired;
+    }
+
+  // one revolution visits every slot, no need to go further
+  int64_t first = m_currentTick;
+  if (nowTick - first >= (int64_t) m_slots.size ())
+    {
+      first = nowTick - m_slots.size () + 1;
+    }
+  for (int64_t tick = first; tick <= nowTick; tick++)
+    {
+      std::map<uint32_t, int64_t> &slot = m_slots[GetSlot (tick)];
+      std::map<uint32_t, int64_t>::iterator it;
+      for (it = slot.begin (); it != slot.end ();)
+        {
+          if (it->second <= nowMs)
+            {
+              expired.push_back (it->first);
+              m_slotOf.erase (it->first);
+              slot.erase (it++);
+            }
+          else
+            {
+              ++it;
+            }
+        }
+    }
+  m_currentTick = nowTick;
+  return expired;
+}
+
+uint32_t
+TimerWheel::GetSize () const
+{
+  return m_slotOf.size ();
+}
+
+bool
+TimerWheel::IsEmpty () const
+{
+  return m_slotOf.empty ();
+}
+
+Time
+TimerWheel::GetTick () const
+{
+  return MilliSeconds (m_tickMs);
+}
+
+void
+TimerWheel::Clear ()
+{
+  for (uint32_t i = 0; i < m_slots.size (); i++)
+    {
+      m_slots[i].clear ();
+    }
+  m_slotOf.clear ();
+}
@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "ns3/nstime.h"
+
+#include <map>
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \brief Hashed timer wheel of deadlines keyed by transaction id
+ *
+ * Deadlines are hashed into a ring of slots one tick wide. Insert and
+ * Remove touch one slot, and Expire only visits the slots whose tick has
+ * passed since the previous call, so a periodic audit costs time
+ * proportional to the elapsed ticks and the expired entries rather than
+ * to everything outstanding. Entries more than one revolution away stay
+ * in their slot until their own deadline passes.
+ */
+class TimerWheel
+{
+  public:
+    TimerWheel (Time tick = MilliSeconds (100), uint32_t slots = 256);
+
+    /**
+     *  \brief Sets the deadline of id, replacing any earlier one
+     */
+    void Insert (uint32_t id, Time deadline);
+    void Remove (uint32_t id);
+    bool Contains (uint32_t id) const;
+
+    /**
+     *  \returns Ids whose deadline is at or before now, removed from the
+     *  wheel, in slot order
+     */
+    std::vector<uint32_t> Expire (Time now);
+
+    uint32_t GetSize () const;
+    bool IsEmpty () const;
+    Time GetTick () const;
+    void Clear ();
+
+  private:
+    uint32_t GetSlot (int64_t tick) const;
+
+    int64_t m_tickMs;
+    // last tick Expire has swept up to
+    int64_t m_currentTick;
+    // per slot: id -> deadline in milliseconds
+    std::vector<std::map<uint32_t, int64_t> > m_slots;
+    // id -> slot holding it
+    std::map<uint32_t, uint32_t> m_slotOf;
+};
+
+#endif
@@ -90,6 +90,7 @@ DVRoutingProtocol::DoDispose ()
   m_auditPingsTimer.Cancel ();
  
   m_pingTracker.clear (); 
+  m_pingDeadlines.Clear ();
 
   GURoutingProtocol::DoDispose ();
 }
@@ -259,6 +260,7 @@ DVRoutingProtocol::ProcessCommand (std::vector<std::string> tokens)
           Ptr<PingRequest> pingRequest = Create<PingRequest> (sequenceNumber, Simulator::Now(), destAddress, pingMessage);
           // Add to ping-tracker
           m_pingTracker.insert (std::make_pair (sequenceNumber, pingRequest));
+          m_pingDeadlines.Insert (sequenceNumber, pingRequest->GetTimestamp () + m_pingTimeout);
           Ptr<Packet> packet = Create<Packet> ();
           DVMessage dvMessage = DVMessage (DVMessage::PING_REQ, sequenceNumber, m_maxTTL, m_mainAddress);
           dvMessage.SetPingReq (destAddress, pingMessage);
@@ -369,6 +371,7 @@ DVRoutingProtocol::ProcessPingRsp (DVMessage dvMessage)
           std::string fromNode = ReverseLookup (dvMessage.GetOriginatorAddress ());
           TRAFFIC_LOG ("Received PING_RSP, From Node: " << fromNode << ", Message: " << dvMessage.GetPingRsp().pingMessage);
           m_pingTracker.erase (iter);
+          m_pingDeadlines.Remove (dvMessage.GetSequenceNumber ());
         }
       else
         {
@@ -396,20 +399,19 @@ DVRoutingProtocol::IsOwnAddress (Ipv4Address originatorAddress)
 void
 DVRoutingProtocol::AuditPings ()
 {
-  std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  for (iter = m_pingTracker.begin () ; iter != m_pingTracker.end();)
+  // only pings whose deadline passed, not every outstanding one
+  std::vector<uint32_t> expired = m_pingDeadlines.Expire (Simulator::Now ());
+  for (uint32_t i = 0; i < expired.size (); i++)
     {
-      Ptr<PingRequest> pingRequest = iter->second;
-      if (pingRequest->GetTimestamp().GetMilliSeconds() + m_pingTimeout.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
+      std::map<uint32_t, Ptr<PingRequest> >::iterator iter = m_pingTracker.find (expired[i]);
+      if (iter == m_pingTracker.end ())
         {
-          DEBUG_LOG ("Ping expired. Message: " << pingRequest->GetPingMessage () << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
-          // Remove stale entries
-          m_pingTracker.erase (iter++);
-        }
-      else
-        {
-          ++iter;
+          continue;
         }
+      Ptr<PingRequest> pingRequest = iter->second;
+      DEBUG_LOG ("Ping expired. Message: " << pingRequest->GetPingMessage () << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
+      // Remove stale entries
+      m_pingTracker.erase (iter);
     }
   // Rechedule timer
   m_auditPingsTimer.Schedule (m_pingTimeout); 
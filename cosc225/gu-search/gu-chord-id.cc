@@ -0,0 +1,136 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/gu-chord-id.h"
+
+#include <openssl/sha.h>
+#include <sstream>
+
+using namespace ns3;
+
+ChordId::ChordId (const uint8_t *digest)
+{
+  for (uint32_t i = 0; i < CHORD_ID_WORDS; i++)
+    {
+      m_words[i] = ((uint32_t) digest[4*i] << 24)
+                   | ((uint32_t) digest[4*i + 1] << 16)
+                   | ((uint32_t) digest[4*i + 2] << 8)
+                   | (uint32_t) digest[4*i + 3];
+    }
+}
+
+ChordId
+ChordId::Hash (std::string value)
+{
+  uint8_t digest[CHORD_ID_SIZE];
+  SHA1 ((const unsigned char *) value.c_str (), value.length (), digest);
+  return ChordId (digest);
+}
+
+ChordId
+ChordId::Hash (Ipv4Address address)
+{
+  std::ostringstream strs;
+  strs << address;
+  return Hash (strs.str ());
+}
+
+ChordId
+ChordId::Hash (Ipv4Address address, uint32_t vnode)
+{
+  if (vnode == 0)
+    {
+      return Hash (address);
+    }
+  std::ostringstream strs;
+  strs << address << "#" << vnode;
+  return Hash (strs.str ());
+}
+
+ChordId
+ChordId::FromHex (std::string hex)
+{
+  ChordId id;
+  uint32_t bit = 0;
+  // walk from the least significant digit so short strings are zero padded
+  for (int32_t i = hex.length () - 1; i >= 0 && bit < CHORD_ID_BITS; i--, bit += 4)
+    {
+      char c = hex[i];
+      uint32_t nibble;
+      if (c >= '0' && c <= '9')
+        nibble = c - '0';
+      else if (c >= 'a' && c <= 'f')
+        nibble = c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        nibble = c - 'A' + 10;
+      else
+        nibble = 0;
+      id.m_words[CHORD_ID_WORDS - 1 - bit / 32] |= nibble << (bit % 32);
+    }
+  return id;
+}
+
+std::string
+ChordId::ToHex () const
+{
+  static const char digits[] = "0123456789abcdef";
+  char hex[2 * CHORD_ID_SIZE];
+  for (uint32_t i = 0; i < CHORD_ID_WORDS; i++)
+    {
+      for (uint32_t j = 0; j < 8; j++)
+        {
+          hex[8*i + j] = digits[(m_words[i] >> (28 - 4*j)) & 0xf];
+        }
+    }
+  return std::string (hex, 2 * CHORD_ID_SIZE);
+}
+
+void
+ChordId::GetBytes (uint8_t *digest) const
+{
+  for (uint32_t i = 0; i < CHORD_ID_WORDS; i++)
+    {
+      digest[4*i] = (uint8_t) (m_words[i] >> 24);
+      digest[4*i + 1] = (uint8_t) (m_words[i] >> 16);
+      digest[4*i + 2] = (uint8_t) (m_words[i] >> 8);
+      digest[4*i + 3] = (uint8_t) m_words[i];
+    }
+}
+
+void
+ChordId::Serialize (Buffer::Iterator &start) const
+{
+  for (uint32_t i = 0; i < CHORD_ID_WORDS; i++)
+    {
+      start.WriteHtonU32 (m_words[i]);
+    }
+}
+
+void
+ChordId::Deserialize (Buffer::Iterator &start)
+{
+  for (uint32_t i = 0; i < CHORD_ID_WORDS; i++)
+    {
+      m_words[i] = start.ReadNtohU32 ();
+    }
+}
+
+std::ostream&
+operator<< (std::ostream &os, const ChordId &id)
+{
+  os << id.ToHex ();
+  return os;
+}
@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef GU_CHORD_ID_H
+#define GU_CHORD_ID_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/buffer.h"
+
+#include <stdint.h>
+#include <string>
+#include <iostream>
+
+using namespace ns3;
+
+#define CHORD_ID_BITS 160
+#define CHORD_ID_WORDS 5
+#define CHORD_ID_SIZE 20
+
+/**
+ * \brief 160-bit identifier on the Chord ring
+ *
+ * Value type holding a SHA-1 sized key as five 32-bit words, most
+ * significant word first. All arithmetic is modulo 2^160 and never
+ * allocates, so identifiers can be copied and compared freely on the
+ * message handling path.
+ */
+class ChordId
+{
+  public:
+    ChordId ();
+    /**
+     *  \brief Builds an identifier from a 20 byte big-endian digest
+     */
+    ChordId (const uint8_t *digest);
+
+    /**
+     *  \returns SHA-1 of the given string
+     */
+    static ChordId Hash (std::string value);
+
+    /**
+     *  \returns Identifier of a node, i.e. SHA-1 of its dotted address
+     */
+    static ChordId Hash (Ipv4Address address);
+
+    /**
+     *  \returns Identifier of one virtual node of a node; virtual node 0
+     *  is the node's own identifier, the others hash "address#index"
+     */
+    static ChordId Hash (Ipv4Address address, uint32_t vnode);
+
+    /**
+     *  \brief Parses a hex string (leading zeros optional)
+     */
+    static ChordId FromHex (std::string hex);
+
+    /**
+     *  \returns 40 character lower-case hex representation
+     */
+    std::string ToHex () const;
+
+    /**
+     *  \brief Writes the identifier as 20 big-endian bytes
+     */
+    void GetBytes (uint8_t *digest) const;
+
+    /**
+     *  \brief Writes the identifier as CHORD_ID_SIZE network order bytes
+     */
+    void Serialize (Buffer::Iterator &start) const;
+
+    /**
+     *  \brief Reads CHORD_ID_SIZE network order bytes into this identifier
+     */
+    void Deserialize (Buffer::Iterator &start);
+
+    uint32_t GetWord (uint32_t index) const;
+    void SetWord (uint32_t index, uint32_t word);
+
+    /**
+     *  \returns this / 2^160, e.g. the share of the ring an arc covers
+     */
+    double GetRingFraction () const;
+
+    /**
+     *  \returns (this + 2^exponent) mod 2^160
+     */
+    ChordId AddPowerOfTwo (uint32_t exponent) const;
+
+    /**
+     *  \returns (this - other) mod 2^160, i.e. the clockwise distance
+     *  from other to this
+     */
+    ChordId Subtract (const ChordId &other) const;
+
+    /**
+     *  \returns <0, 0 or >0 like strcmp
+     */
+    int Compare (const ChordId &other) const;
+
+    /**
+     *  \returns true if id lies in the ring interval (from, to]
+     */
+    static bool IsInBetween (const ChordId &from, const ChordId &id, const ChordId &to);
+
+    /**
+     *  \returns true if "to" is responsible for id when its predecessor
+     *  is "from"; a single node ring (from == to) owns every id
+     */
+    static bool IsSuccessor (const ChordId &from, const ChordId &id, const ChordId &to);
+
+  private:
+    uint32_t m_words[CHORD_ID_WORDS];
+};
+
+inline
+ChordId::ChordId ()
+{
+  for (uint32_t i = 0; i < CHORD_ID_WORDS; i++)
+    {
+      m_words[i] = 0;
+    }
+}
+
+inline uint32_t
+ChordId::GetWord (uint32_t index) const
+{
+  return m_words[index];
+}
+
+inline void
+ChordId::SetWord (uint32_t index, uint32_t word)
+{
+  m_words[index] = word;
+}
+
+inline double
+ChordId::GetRingFraction () const
+{
+  // the two top words carry more precision than a double holds
+  return (m_words[0] * 4294967296.0 + m_words[1]) / 18446744073709551616.0;
+}
+
+inline int
+ChordId::Compare (const ChordId &other) const
+{
+  for (uint32_t i = 0; i < CHORD_ID_WORDS; i++)
+    {
+      if (m_words[i] != other.m_words[i])
+        {
+          return m_words[i] < other.m_words[i] ? -1 : 1;
+        }
+    }
+  return 0;
+}
+
+inline ChordId
+ChordId::AddPowerOfTwo (uint32_t exponent) const
+{
+  ChordId result = *this;
+  if (exponent >= CHORD_ID_BITS)
+    {
+      return result;
+    }
+  int32_t word = CHORD_ID_WORDS - 1 - exponent / 32;
+  uint64_t carry = (uint64_t) 1 << (exponent % 32);
+  for (; word >= 0 && carry != 0; word--)
+    {
+      uint64_t sum = (uint64_t) result.m_words[word] + carry;
+      result.m_words[word] = (uint32_t) sum;
+      carry = sum >> 32;
+    }
+  return result;
+}
+
+inline ChordId
+ChordId::Subtract (const ChordId &other) const
+{
+  ChordId result;
+  uint64_t borrow = 0;
+  for (int32_t word = CHORD_ID_WORDS - 1; word >= 0; word--)
+    {
+      uint64_t diff = (uint64_t) m_words[word] - other.m_words[word] - borrow;
+      result.m_words[word] = (uint32_t) diff;
+      borrow = (diff >> 32) & 1;
+    }
+  return result;
+}
+
+inline bool operator== (const ChordId &a, const ChordId &b) { return a.Compare (b) == 0; }
+inline bool operator!= (const ChordId &a, const ChordId &b) { return a.Compare (b) != 0; }
+inline bool operator< (const ChordId &a, const ChordId &b) { return a.Compare (b) < 0; }
+inline bool operator<= (const ChordId &a, const ChordId &b) { return a.Compare (b) <= 0; }
+inline bool operator> (const ChordId &a, const ChordId &b) { return a.Compare (b) > 0; }
+inline bool operator>= (const ChordId &a, const ChordId &b) { return a.Compare (b) >= 0; }
+
+inline bool
+ChordId::IsInBetween (const ChordId &from, const ChordId &id, const ChordId &to)
+{
+  int order = from.Compare (to);
+  if (order < 0)
+    {
+      return id > from && id <= to;
+    }
+  if (order > 0)
+    {
+      // interval wraps past zero
+      return id > from || id <= to;
+    }
+  return false;
+}
+
+inline bool
+ChordId::IsSuccessor (const ChordId &from, const ChordId &id, const ChordId &to)
+{
+  return from == to || IsInBetween (from, id, to);
+}
+
+std::ostream& operator<< (std::ostream &os, const ChordId &id);
+
+#endif
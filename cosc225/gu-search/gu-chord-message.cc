@@ -23,6 +23,7 @@ NS_LOG_COMPONENT_DEFINE ("GUChordMessage");
 NS_OBJECT_ENSURE_REGISTERED (GUChordMessage);
 
 GUChordMessage::GUChordMessage ()
+  : m_virtualNode (0)
 {
 }
 
@@ -34,6 +35,7 @@ GUChordMessage::GUChordMessage (GUChordMessage::MessageType messageType, uint32_
 {
   m_messageType = messageType;
   m_transactionId = transactionId;
+  m_virtualNode = 0;
 }
 
 TypeId 
@@ -56,8 +58,8 @@ GUChordMessage::GetInstanceTypeId (void) const
 uint32_t
 GUChordMessage::GetSerializedSize (void) const
 {
-  // size of messageType, transaction id
-  uint32_t size = sizeof (uint8_t) + sizeof (uint32_t);
+  // size of messageType, transaction id, virtual node
+  uint32_t size = sizeof (uint8_t) + sizeof (uint32_t) + sizeof (uint8_t);
   switch (m_messageType)
     {
       case PING_REQ:
@@ -96,6 +98,33 @@ GUChordMessage::GetSerializedSize (void) const
       case LOOKUP_RSP:
         size += m_message.lookupRsp.GetSerializedSize ();
         break;
+      case FINGER_TABLE_REQ:
+        size += m_message.fingerTableReq.GetSerializedSize ();
+        break;
+      case FINGER_TABLE_RSP:
+        size += m_message.fingerTableRsp.GetSerializedSize ();
+        break;
+      case ITERATIVE_LOOKUP_REQ:
+        size += m_message.iterativeLookupReq.GetSerializedSize ();
+        break;
+      case ITERATIVE_LOOKUP_RSP:
+        size += m_message.iterativeLookupRsp.GetSerializedSize ();
+        break;
+      case LOOKUP_BATCH_REQ:
+        size += m_message.lookupBatchReq.GetSerializedSize ();
+        break;
+      case LOOKUP_BATCH_RSP:
+        size += m_message.lookupBatchRsp.GetSerializedSize ();
+        break;
+      case RING_SNAPSHOT:
+        size += m_message.ringSnapshot.GetSerializedSize ();
+        break;
+      case STABILIZE_NOTIFY:
+        size += m_message.stabilizeNotify.GetSerializedSize ();
+        break;
+      case RING_SNAPSHOT_RECORD:
+        size += m_message.ringSnapshotRecord.GetSerializedSize ();
+        break;
       default:
         NS_ASSERT (false);
     }
@@ -148,6 +177,33 @@ GUChordMessage::Print (std::ostream &os) const
       case LOOKUP_RSP:
         m_message.lookupRsp.Print (os);
         break;
+      case FINGER_TABLE_REQ:
+        m_message.fingerTableReq.Print (os);
+        break;
+      case FINGER_TABLE_RSP:
+        m_message.fingerTableRsp.Print (os);
+        break;
+      case ITERATIVE_LOOKUP_REQ:
+        m_message.iterativeLookupReq.Print (os);
+        break;
+      case ITERATIVE_LOOKUP_RSP:
+        m_message.iterativeLookupRsp.Print (os);
+        break;
+      case LOOKUP_BATCH_REQ:
+        m_message.lookupBatchReq.Print (os);
+        break;
+      case LOOKUP_BATCH_RSP:
+        m_message.lookupBatchRsp.Print (os);
+        break;
+      case RING_SNAPSHOT:
+        m_message.ringSnapshot.Print (os);
+        break;
+      case STABILIZE_NOTIFY:
+        m_message.stabilizeNotify.Print (os);
+        break;
+      case RING_SNAPSHOT_RECORD:
+        m_message.ringSnapshotRecord.Print (os);
+        break;
       default:
         break;  
     }
@@ -160,6 +216,7 @@ GUChordMessage::Serialize (Buffer::Iterator start) const
   Buffer::Iterator i = start;
   i.WriteU8 (m_messageType);
   i.WriteHtonU32 (m_transactionId);
+  i.WriteU8 (m_virtualNode);
 
   switch (m_messageType)
     {
@@ -199,6 +256,33 @@ GUChordMessage::Serialize (Buffer::Iterator start) const
       case LOOKUP_RSP:
         m_message.lookupRsp.Serialize (i);
         break;
+      case FINGER_TABLE_REQ:
+        m_message.fingerTableReq.Serialize (i);
+        break;
+      case FINGER_TABLE_RSP:
+        m_message.fingerTableRsp.Serialize (i);
+        break;
+      case ITERATIVE_LOOKUP_REQ:
+        m_message.iterativeLookupReq.Serialize (i);
+        break;
+      case ITERATIVE_LOOKUP_RSP:
+        m_message.iterativeLookupRsp.Serialize (i);
+        break;
+      case LOOKUP_BATCH_REQ:
+        m_message.lookupBatchReq.Serialize (i);
+        break;
+      case LOOKUP_BATCH_RSP:
+        m_message.lookupBatchRsp.Serialize (i);
+        break;
+      case RING_SNAPSHOT:
+        m_message.ringSnapshot.Serialize (i);
+        break;
+      case STABILIZE_NOTIFY:
+        m_message.stabilizeNotify.Serialize (i);
+        break;
+      case RING_SNAPSHOT_RECORD:
+        m_message.ringSnapshotRecord.Serialize (i);
+        break;
       default:
         NS_ASSERT (false);   
     }
@@ -211,8 +295,9 @@ GUChordMessage::Deserialize (Buffer::Iterator start)
   Buffer::Iterator i = start;
   m_messageType = (MessageType) i.ReadU8 ();
   m_transactionId = i.ReadNtohU32 ();
+  m_virtualNode = i.ReadU8 ();
 
-  size = sizeof (uint8_t) + sizeof (uint32_t);
+  size = sizeof (uint8_t) + sizeof (uint32_t) + sizeof (uint8_t);
 
   switch (m_messageType)
     {
@@ -241,16 +326,43 @@ GUChordMessage::Deserialize (Buffer::Iterator start)
         size += m_message.ringStatePing.Deserialize (i);
         break;
       case FIND_SUCCESSOR_REQ:
-        m_message.findSuccessorReq.Deserialize (i);
+        size += m_message.findSuccessorReq.Deserialize (i);
         break;
       case FIND_SUCCESSOR_RSP:
-        m_message.findSuccessorRsp.Deserialize (i);
+        size += m_message.findSuccessorRsp.Deserialize (i);
         break;
       case LOOKUP_REQ:
-        m_message.lookupReq.Deserialize (i);
+        size += m_message.lookupReq.Deserialize (i);
         break;
       case LOOKUP_RSP:
-        m_message.lookupRsp.Deserialize (i);
+        size += m_message.lookupRsp.Deserialize (i);
+        break;
+      case FINGER_TABLE_REQ:
+        size += m_message.fingerTableReq.Deserialize (i);
+        break;
+      case FINGER_TABLE_RSP:
+        size += m_message.fingerTableRsp.Deserialize (i);
+        break;
+      case ITERATIVE_LOOKUP_REQ:
+        size += m_message.iterativeLookupReq.Deserialize (i);
+        break;
+      case ITERATIVE_LOOKUP_RSP:
+        size += m_message.iterativeLookupRsp.Deserialize (i);
+        break;
+      case LOOKUP_BATCH_REQ:
+        size += m_message.lookupBatchReq.Deserialize (i);
+        break;
+      case LOOKUP_BATCH_RSP:
+        size += m_message.lookupBatchRsp.Deserialize (i);
+        break;
+      case RING_SNAPSHOT:
+        size += m_message.ringSnapshot.Deserialize (i);
+        break;
+      case STABILIZE_NOTIFY:
+        size += m_message.stabilizeNotify.Deserialize (i);
+        break;
+      case RING_SNAPSHOT_RECORD:
+        size += m_message.ringSnapshotRecord.Deserialize (i);
         break;
       default:
         NS_ASSERT (false);
@@ -373,7 +485,7 @@ uint32_t
 GUChordMessage::JoinReq::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = 2*IPV4_ADDRESS_SIZE + 2*sizeof(uint32_t);
+  size = 2*IPV4_ADDRESS_SIZE + 2*sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t);
   return size;
 }
 
@@ -390,6 +502,8 @@ GUChordMessage::JoinReq::Serialize (Buffer::Iterator &start) const
   start.WriteHtonU32(landmark_ip_address.Get());
   start.WriteU32 (request_id);
   start.WriteHtonU32(request_ip_address.Get());
+  start.WriteU8 (request_vnode);
+  start.WriteU16 (hops);
 }
 
 uint32_t
@@ -399,6 +513,8 @@ GUChordMessage::JoinReq::Deserialize (Buffer::Iterator &start)
   landmark_ip_address = Ipv4Address (start.ReadNtohU32 ());
   request_id = start.ReadU32();
   request_ip_address = Ipv4Address (start.ReadNtohU32 ());
+  request_vnode = start.ReadU8();
+  hops = start.ReadU16();
   return JoinReq::GetSerializedSize ();
 }
 
@@ -416,12 +532,14 @@ GUChordMessage::SetJoinReq (JoinReq joinRequest)
 
     m_message.joinReq.request_id = joinRequest.request_id;
     m_message.joinReq.request_ip_address = joinRequest.request_ip_address;
+    m_message.joinReq.request_vnode = joinRequest.request_vnode;
     m_message.joinReq.landmark_id = joinRequest.landmark_id;
     m_message.joinReq.landmark_ip_address = joinRequest.landmark_ip_address;
+    m_message.joinReq.hops = joinRequest.hops;
 }
 
 void
-GUChordMessage::SetJoinReq (uint32_t sender_node_number, Ipv4Address sender_ip_address, uint32_t receiving_node_number, Ipv4Address receiving_ip_address)
+GUChordMessage::SetJoinReq (uint32_t sender_node_number, Ipv4Address sender_ip_address, uint8_t sender_vnode, uint32_t receiving_node_number, Ipv4Address receiving_ip_address)
 {
 
         if (m_messageType == 0)
@@ -435,8 +553,10 @@ GUChordMessage::SetJoinReq (uint32_t sender_node_number, Ipv4Address sender_ip_a
           
         m_message.joinReq.request_id = sender_node_number;
         m_message.joinReq.request_ip_address = sender_ip_address;
+        m_message.joinReq.request_vnode = sender_vnode;
         m_message.joinReq.landmark_id = receiving_node_number;
         m_message.joinReq.landmark_ip_address = receiving_ip_address;
+        m_message.joinReq.hops = 0;
 
 }
           
@@ -453,7 +573,7 @@ uint32_t
 GUChordMessage::JoinRsp::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = 3*IPV4_ADDRESS_SIZE + 3*sizeof(uint32_t);
+    size = 3*IPV4_ADDRESS_SIZE + 3*sizeof(uint32_t) + 2*sizeof(uint8_t) + sizeof(uint16_t);
     return size;
 }
 
@@ -470,8 +590,11 @@ GUChordMessage::JoinRsp::Serialize (Buffer::Iterator &start) const
     start.WriteHtonU32(landmark_ip_address.Get());
     start.WriteU32 (request_id);
     start.WriteHtonU32(request_ip_address.Get());
+    start.WriteU8 (request_vnode);
     start.WriteU32 (successor_id);
     start.WriteHtonU32(successor_ip_address.Get());
+    start.WriteU8 (successor_vnode);
+    start.WriteU16 (hops);
 }
 
 uint32_t
@@ -481,8 +604,11 @@ GUChordMessage::JoinRsp::Deserialize (Buffer::Iterator &start)
     landmark_ip_address = Ipv4Address (start.ReadNtohU32 ());
     request_id = start.ReadU32();
     request_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    request_vnode = start.ReadU8();
     successor_id = start.ReadU32();
     successor_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    successor_vnode = start.ReadU8();
+    hops = start.ReadU16();
     return JoinRsp::GetSerializedSize ();
 }
 
@@ -499,14 +625,17 @@ GUChordMessage::SetJoinRsp (JoinRsp joinResponse)
     }
     m_message.joinRsp.request_id = joinResponse.request_id;
     m_message.joinRsp.request_ip_address = joinResponse.request_ip_address;
+    m_message.joinRsp.request_vnode = joinResponse.request_vnode;
     m_message.joinRsp.successor_id = joinResponse.successor_id;
     m_message.joinRsp.successor_ip_address = joinResponse.successor_ip_address;
+    m_message.joinRsp.successor_vnode = joinResponse.successor_vnode;
     m_message.joinRsp.landmark_id = joinResponse.landmark_id;
     m_message.joinRsp.landmark_ip_address = joinResponse.landmark_ip_address;
+    m_message.joinRsp.hops = joinResponse.hops;
 }
 
 void
-GUChordMessage::SetJoinRsp (JoinReq joinRequest, uint32_t succ_id, Ipv4Address succ_ip)
+GUChordMessage::SetJoinRsp (JoinReq joinRequest, uint32_t succ_id, Ipv4Address succ_ip, uint8_t succ_vnode)
 {
     if (m_messageType == 0)
     {
@@ -518,10 +647,13 @@ GUChordMessage::SetJoinRsp (JoinReq joinRequest, uint32_t succ_id, Ipv4Address s
     }
     m_message.joinRsp.successor_ip_address = succ_ip;
     m_message.joinRsp.successor_id = succ_id;
+    m_message.joinRsp.successor_vnode = succ_vnode;
     m_message.joinRsp.request_id = joinRequest.request_id;
     m_message.joinRsp.request_ip_address = joinRequest.request_ip_address;
+    m_message.joinRsp.request_vnode = joinRequest.request_vnode;
     m_message.joinRsp.landmark_id = joinRequest.landmark_id;
     m_message.joinRsp.landmark_ip_address = joinRequest.landmark_ip_address;
+    m_message.joinRsp.hops = joinRequest.hops;
 }
 
 GUChordMessage::JoinRsp
@@ -536,7 +668,7 @@ uint32_t
 GUChordMessage::DepartureReq::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = 2*IPV4_ADDRESS_SIZE + 2*sizeof(uint32_t);
+    size = 2*IPV4_ADDRESS_SIZE + 2*sizeof(uint32_t) + 2*sizeof(uint8_t);
     return size;
 }
 
@@ -551,8 +683,10 @@ GUChordMessage::DepartureReq::Serialize (Buffer::Iterator &start) const
 {
     start.WriteU32 (sender_node_id);
     start.WriteHtonU32(sender_node_ip_address.Get());
+    start.WriteU8 (sender_vnode);
     start.WriteU32 (conn_node_id);
     start.WriteHtonU32(conn_node_ip_address.Get());
+    start.WriteU8 (conn_vnode);
 }
 
 uint32_t
@@ -560,13 +694,15 @@ GUChordMessage::DepartureReq::Deserialize (Buffer::Iterator &start)
 {  
     sender_node_id = start.ReadU32();
     sender_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    sender_vnode = start.ReadU8();
     conn_node_id = start.ReadU32();
     conn_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    conn_vnode = start.ReadU8();
     return DepartureReq::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetDepartureReq (uint32_t sender_node_number, Ipv4Address sender_ip_address, uint32_t conn_node_number, Ipv4Address conn_ip_address)
+GUChordMessage::SetDepartureReq (uint32_t sender_node_number, Ipv4Address sender_ip_address, uint8_t sender_vnode, uint32_t conn_node_number, Ipv4Address conn_ip_address, uint8_t conn_vnode)
 {
 
         if (m_messageType == 0)
@@ -580,8 +716,10 @@ GUChordMessage::SetDepartureReq (uint32_t sender_node_number, Ipv4Address sender
           
         m_message.departureReq.sender_node_id = sender_node_number;
         m_message.departureReq.sender_node_ip_address = sender_ip_address;
+        m_message.departureReq.sender_vnode = sender_vnode;
         m_message.departureReq.conn_node_id = conn_node_number;
         m_message.departureReq.conn_node_ip_address = conn_ip_address;
+        m_message.departureReq.conn_vnode = conn_vnode;
 
 }
 
@@ -598,7 +736,7 @@ uint32_t
 GUChordMessage::StabilizeReq::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t);
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint8_t);
     return size;
 }
 
@@ -613,6 +751,7 @@ GUChordMessage::StabilizeReq::Serialize (Buffer::Iterator &start) const
 {
     start.WriteU32 (sender_node_id);
     start.WriteHtonU32(sender_node_ip_address.Get());
+    start.WriteU8 (sender_vnode);
 }
 
 uint32_t
@@ -620,11 +759,12 @@ GUChordMessage::StabilizeReq::Deserialize (Buffer::Iterator &start)
 {  
     sender_node_id = start.ReadU32();
     sender_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    sender_vnode = start.ReadU8();
   return StabilizeReq::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetStabilizeReq (uint32_t node_id, Ipv4Address ip_address)
+GUChordMessage::SetStabilizeReq (uint32_t node_id, Ipv4Address ip_address, uint8_t vnode)
 {
   if (m_messageType == 0)
     {
@@ -636,6 +776,7 @@ GUChordMessage::SetStabilizeReq (uint32_t node_id, Ipv4Address ip_address)
     }
     m_message.stabilizeReq.sender_node_id = node_id;
     m_message.stabilizeReq.sender_node_ip_address = ip_address;
+    m_message.stabilizeReq.sender_vnode = vnode;
 }
 
 GUChordMessage::StabilizeReq
@@ -650,7 +791,7 @@ uint32_t
 GUChordMessage::StabilizeRsp::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t);
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint16_t) + successor_list.size() * (IPV4_ADDRESS_SIZE + sizeof(uint8_t));
     return size;
 }
 
@@ -665,6 +806,14 @@ GUChordMessage::StabilizeRsp::Serialize (Buffer::Iterator &start) const
 {
     start.WriteU32 (predecessor_node_id);
     start.WriteHtonU32(predecessor_node_ip_address.Get());
+    start.WriteU8 (predecessor_vnode);
+
+    start.WriteU16 (successor_list.size ());
+    for (uint32_t i = 0; i < successor_list.size (); i++)
+      {
+        start.WriteHtonU32 (successor_list[i].Get());
+        start.WriteU8 (successor_vnodes[i]);
+      }
 }
 
 uint32_t
@@ -672,11 +821,21 @@ GUChordMessage::StabilizeRsp::Deserialize (Buffer::Iterator &start)
 {  
   predecessor_node_id = start.ReadU32();
   predecessor_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+  predecessor_vnode = start.ReadU8();
+
+  uint16_t count = start.ReadU16 ();
+  successor_list.resize (count);
+  successor_vnodes.resize (count);
+  for (uint16_t i = 0; i < count; i++)
+    {
+      successor_list[i] = Ipv4Address (start.ReadNtohU32 ());
+      successor_vnodes[i] = start.ReadU8 ();
+    }
   return StabilizeRsp::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetStabilizeRsp (uint32_t node_id, Ipv4Address ip_address)
+GUChordMessage::SetStabilizeRsp (uint32_t node_id, Ipv4Address ip_address, uint8_t vnode, std::vector<Ipv4Address> successors, std::vector<uint8_t> successorVnodes)
 {
   if (m_messageType == 0)
     {
@@ -687,7 +846,11 @@ GUChordMessage::SetStabilizeRsp (uint32_t node_id, Ipv4Address ip_address)
       NS_ASSERT (m_messageType == STABILIZE_RSP);
     }
     m_message.stabilizeRsp.predecessor_node_id = node_id;
+    NS_ASSERT (successors.size () == successorVnodes.size ());
     m_message.stabilizeRsp.predecessor_node_ip_address = ip_address;
+    m_message.stabilizeRsp.predecessor_vnode = vnode;
+    m_message.stabilizeRsp.successor_list = successors;
+    m_message.stabilizeRsp.successor_vnodes = successorVnodes;
 }
 
 GUChordMessage::StabilizeRsp
@@ -702,7 +865,7 @@ uint32_t
 GUChordMessage::RingStatePing::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t);
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint8_t);
     return size;
 }
 
@@ -717,6 +880,7 @@ GUChordMessage::RingStatePing::Serialize (Buffer::Iterator &start) const
 {
     start.WriteU32 (originator_node_id);
     start.WriteHtonU32(originator_node_ip_address.Get());
+    start.WriteU8 (originator_vnode);
 }
 
 uint32_t
@@ -724,11 +888,12 @@ GUChordMessage::RingStatePing::Deserialize (Buffer::Iterator &start)
 {  
   originator_node_id = start.ReadU32();
   originator_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+  originator_vnode = start.ReadU8();
   return RingStatePing::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetRingStatePing (uint32_t originator_id, Ipv4Address originator_ip)
+GUChordMessage::SetRingStatePing (uint32_t originator_id, Ipv4Address originator_ip, uint8_t originator_vnode)
 {
   if (m_messageType == 0)
     {
@@ -741,6 +906,7 @@ GUChordMessage::SetRingStatePing (uint32_t originator_id, Ipv4Address originator
   
   m_message.ringStatePing.originator_node_id = originator_id;
   m_message.ringStatePing.originator_node_ip_address = originator_ip;
+  m_message.ringStatePing.originator_vnode = originator_vnode;
 
 }
 
@@ -757,7 +923,7 @@ uint32_t
 GUChordMessage::FindSuccessorReq::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + start_value.length();
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + CHORD_ID_SIZE;
     return size;
 }
 
@@ -772,10 +938,9 @@ GUChordMessage::FindSuccessorReq::Serialize (Buffer::Iterator &start) const
 {
     start.WriteU32 (originator_node_id);
     start.WriteHtonU32(originator_node_ip_address.Get());
+    start.WriteU8 (originator_vnode);
 
-    start.WriteU16 (start_value.length ());
-    
-    start.Write ((uint8_t *) (const_cast<char*> (start_value.c_str())), start_value.length());
+    start_value.Serialize (start);
 
     start.WriteU32 (start_value_index);
 }
@@ -785,12 +950,9 @@ GUChordMessage::FindSuccessorReq::Deserialize (Buffer::Iterator &start)
 {  
     originator_node_id = start.ReadU32();
     originator_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    originator_vnode = start.ReadU8();
     
-    uint16_t length = start.ReadU16 ();
-    char* str = (char*) malloc (length);
-    start.Read ((uint8_t*)str, length);
-    start_value = std::string (str, length);
-    free (str);
+    start_value.Deserialize (start);
 
     start_value_index = start.ReadU32();
 
@@ -798,7 +960,7 @@ GUChordMessage::FindSuccessorReq::Deserialize (Buffer::Iterator &start)
 }
 
 void
-GUChordMessage::SetFindSuccessorReq (uint32_t node_id, Ipv4Address ip_address, std::string start_value, uint32_t index)
+GUChordMessage::SetFindSuccessorReq (uint32_t node_id, Ipv4Address ip_address, uint8_t vnode, ChordId start_value, uint32_t index)
 {
   if (m_messageType == 0)
     {
@@ -810,6 +972,7 @@ GUChordMessage::SetFindSuccessorReq (uint32_t node_id, Ipv4Address ip_address, s
     }
     m_message.findSuccessorReq.originator_node_id = node_id;
     m_message.findSuccessorReq.originator_node_ip_address = ip_address;
+    m_message.findSuccessorReq.originator_vnode = vnode;
     m_message.findSuccessorReq.start_value = start_value;
     m_message.findSuccessorReq.start_value_index = index;
 }
@@ -826,7 +989,7 @@ uint32_t
 GUChordMessage::FindSuccessorRsp::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + start_value.length();
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint32_t) + CHORD_ID_SIZE;
     return size;
 }
 
@@ -841,10 +1004,9 @@ GUChordMessage::FindSuccessorRsp::Serialize (Buffer::Iterator &start) const
 {
     start.WriteU32 (successor_node_id);
     start.WriteHtonU32(successor_node_ip_address.Get());
+    start.WriteU8 (successor_vnode);
 
-    start.WriteU16 (start_value.length ());
-
-    start.Write ((uint8_t *) (const_cast<char*> (start_value.c_str())), start_value.length());
+    start_value.Serialize (start);
 
     start.WriteU32 (start_value_index);
 }
@@ -854,12 +1016,9 @@ GUChordMessage::FindSuccessorRsp::Deserialize (Buffer::Iterator &start)
 {  
     successor_node_id = start.ReadU32();
     successor_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    successor_vnode = start.ReadU8();
     
-    uint16_t length = start.ReadU16 ();
-    char* str = (char*) malloc (length);
-    start.Read ((uint8_t*)str, length);
-    start_value = std::string (str, length);
-    free (str);
+    start_value.Deserialize (start);
 
     start_value_index = start.ReadU32();
   
@@ -867,7 +1026,7 @@ GUChordMessage::FindSuccessorRsp::Deserialize (Buffer::Iterator &start)
 }
 
 void
-GUChordMessage::SetFindSuccessorRsp (uint32_t node_id, Ipv4Address ip_address, std::string start_value, uint32_t index)
+GUChordMessage::SetFindSuccessorRsp (uint32_t node_id, Ipv4Address ip_address, uint8_t vnode, ChordId start_value, uint32_t index)
 {
   if (m_messageType == 0)
     {
@@ -879,6 +1038,7 @@ GUChordMessage::SetFindSuccessorRsp (uint32_t node_id, Ipv4Address ip_address, s
     }
     m_message.findSuccessorRsp.successor_node_id = node_id;
     m_message.findSuccessorRsp.successor_node_ip_address = ip_address;
+    m_message.findSuccessorRsp.successor_vnode = vnode;
     m_message.findSuccessorRsp.start_value = start_value;
     m_message.findSuccessorRsp.start_value_index = index;
 }
@@ -895,7 +1055,7 @@ uint32_t
 GUChordMessage::LookupReq::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint16_t) + target_key.length();
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + CHORD_ID_SIZE;
     return size;
 }
 
@@ -911,9 +1071,7 @@ GUChordMessage::LookupReq::Serialize (Buffer::Iterator &start) const
     start.WriteU32 (originator_node_id);
     start.WriteHtonU32(originator_node_ip_address.Get());
 
-    start.WriteU16 (target_key.length ());
-    
-    start.Write ((uint8_t *) (const_cast<char*> (target_key.c_str())), target_key.length());
+    target_key.Serialize (start);
 }
 
 uint32_t
@@ -922,17 +1080,13 @@ GUChordMessage::LookupReq::Deserialize (Buffer::Iterator &start)
     originator_node_id = start.ReadU32();
     originator_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
     
-    uint16_t length = start.ReadU16 ();
-    char* str = (char*) malloc (length);
-    start.Read ((uint8_t*)str, length);
-    target_key = std::string (str, length);
-    free (str);
+    target_key.Deserialize (start);
 
     return LookupReq::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetLookupReq (uint32_t node_id, Ipv4Address ip_address, std::string key)
+GUChordMessage::SetLookupReq (uint32_t node_id, Ipv4Address ip_address, ChordId key)
 {
   if (m_messageType == 0)
     {
@@ -959,7 +1113,7 @@ uint32_t
 GUChordMessage::LookupRsp::GetSerializedSize (void) const
 {
     uint32_t size;
-    size = IPV4_ADDRESS_SIZE*2 + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t) + target_key.length();
+    size = IPV4_ADDRESS_SIZE*2 + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint8_t) + CHORD_ID_SIZE;
     return size;
 }
 
@@ -978,10 +1132,9 @@ GUChordMessage::LookupRsp::Serialize (Buffer::Iterator &start) const
 
     start.WriteU32 (successor_node_id);
     start.WriteHtonU32(successor_node_ip_address.Get());
+    start.WriteU8 (successor_vnode);
 
-    start.WriteU16 (target_key.length ());
-
-    start.Write ((uint8_t *) (const_cast<char*> (target_key.c_str())), target_key.length());
+    target_key.Serialize (start);
 
 }
 
@@ -994,18 +1147,15 @@ GUChordMessage::LookupRsp::Deserialize (Buffer::Iterator &start)
 
     successor_node_id = start.ReadU32();
     successor_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    successor_vnode = start.ReadU8();
     
-    uint16_t length = start.ReadU16 ();
-    char* str = (char*) malloc (length);
-    start.Read ((uint8_t*)str, length);
-    target_key = std::string (str, length);
-    free (str);
+    target_key.Deserialize (start);
   
     return LookupRsp::GetSerializedSize ();
 }
 
 void
-GUChordMessage::SetLookupRsp (uint32_t orig_node_id, Ipv4Address orig_ip_address, uint32_t succ_node_id, Ipv4Address succ_ip_address, std::string key)
+GUChordMessage::SetLookupRsp (uint32_t orig_node_id, Ipv4Address orig_ip_address, uint32_t succ_node_id, Ipv4Address succ_ip_address, uint8_t succ_vnode, ChordId key)
 {
   if (m_messageType == 0)
     {
@@ -1020,6 +1170,7 @@ GUChordMessage::SetLookupRsp (uint32_t orig_node_id, Ipv4Address orig_ip_address
     m_message.lookupRsp.originator_node_ip_address = orig_ip_address;
     m_message.lookupRsp.successor_node_id = succ_node_id;
     m_message.lookupRsp.successor_node_ip_address = succ_ip_address;
+    m_message.lookupRsp.successor_vnode = succ_vnode;
     m_message.lookupRsp.target_key = key;
 }
 
@@ -1029,6 +1180,490 @@ GUChordMessage::GetLookupRsp ()
   return m_message.lookupRsp;
 }
 
+/* FINGER_TABLE_REQ */
+
+uint32_t 
+GUChordMessage::FingerTableReq::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint8_t);
+    return size;
+}
+
+void
+GUChordMessage::FingerTableReq::Print (std::ostream &os) const
+{
+  os << "FingerTableReq:: Sender: " << sender_node_id << "\n";
+}
+
+void
+GUChordMessage::FingerTableReq::Serialize (Buffer::Iterator &start) const
+{
+    start.WriteU32 (sender_node_id);
+    start.WriteHtonU32(sender_node_ip_address.Get());
+    start.WriteU8 (sender_vnode);
+}
+
+uint32_t
+GUChordMessage::FingerTableReq::Deserialize (Buffer::Iterator &start)
+{  
+    sender_node_id = start.ReadU32();
+    sender_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    sender_vnode = start.ReadU8();
+    return FingerTableReq::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetFingerTableReq (uint32_t node_id, Ipv4Address ip_address, uint8_t vnode)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = FINGER_TABLE_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == FINGER_TABLE_REQ);
+    }
+    m_message.fingerTableReq.sender_node_id = node_id;
+    m_message.fingerTableReq.sender_node_ip_address = ip_address;
+    m_message.fingerTableReq.sender_vnode = vnode;
+}
+
+GUChordMessage::FingerTableReq
+GUChordMessage::GetFingerTableReq ()
+{
+  return m_message.fingerTableReq;
+}
+
+/* FINGER_TABLE_RSP */
+
+uint32_t 
+GUChordMessage::FingerTableRsp::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = sizeof(uint16_t) + finger_ip_addresses.size() * (IPV4_ADDRESS_SIZE + sizeof(uint8_t));
+    return size;
+}
+
+void
+GUChordMessage::FingerTableRsp::Print (std::ostream &os) const
+{
+  os << "FingerTableRsp:: Fingers: " << finger_ip_addresses.size() << "\n";
+}
+
+void
+GUChordMessage::FingerTableRsp::Serialize (Buffer::Iterator &start) const
+{
+    start.WriteU16 (finger_ip_addresses.size ());
+    for (uint32_t i = 0; i < finger_ip_addresses.size (); i++)
+      {
+        start.WriteHtonU32 (finger_ip_addresses[i].Get());
+        start.WriteU8 (finger_vnodes[i]);
+      }
+}
+
+uint32_t
+GUChordMessage::FingerTableRsp::Deserialize (Buffer::Iterator &start)
+{  
+    uint16_t count = start.ReadU16 ();
+    finger_ip_addresses.resize (count);
+    finger_vnodes.resize (count);
+    for (uint16_t i = 0; i < count; i++)
+      {
+        finger_ip_addresses[i] = Ipv4Address (start.ReadNtohU32 ());
+        finger_vnodes[i] = start.ReadU8 ();
+      }
+    return FingerTableRsp::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetFingerTableRsp (std::vector<Ipv4Address> fingers, std::vector<uint8_t> fingerVnodes)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = FINGER_TABLE_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == FINGER_TABLE_RSP);
+    }
+    NS_ASSERT (fingers.size () == fingerVnodes.size ());
+    m_message.fingerTableRsp.finger_ip_addresses = fingers;
+    m_message.fingerTableRsp.finger_vnodes = fingerVnodes;
+}
+
+GUChordMessage::FingerTableRsp
+GUChordMessage::GetFingerTableRsp ()
+{
+  return m_message.fingerTableRsp;
+}
+
+/* ITERATIVE_LOOKUP_REQ */
+
+uint32_t 
+GUChordMessage::IterativeLookupReq::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + CHORD_ID_SIZE;
+    return size;
+}
+
+void
+GUChordMessage::IterativeLookupReq::Print (std::ostream &os) const
+{
+  os << "IterativeLookupReq:: Originator: " << originator_node_id << " Target: " << target_key << "\n";
+}
+
+void
+GUChordMessage::IterativeLookupReq::Serialize (Buffer::Iterator &start) const
+{
+    start.WriteU32 (originator_node_id);
+    start.WriteHtonU32(originator_node_ip_address.Get());
+
+    target_key.Serialize (start);
+}
+
+uint32_t
+GUChordMessage::IterativeLookupReq::Deserialize (Buffer::Iterator &start)
+{  
+    originator_node_id = start.ReadU32();
+    originator_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+
+    target_key.Deserialize (start);
+
+    return IterativeLookupReq::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetIterativeLookupReq (uint32_t node_id, Ipv4Address ip_address, ChordId key)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = ITERATIVE_LOOKUP_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == ITERATIVE_LOOKUP_REQ);
+    }
+    m_message.iterativeLookupReq.originator_node_id = node_id;
+    m_message.iterativeLookupReq.originator_node_ip_address = ip_address;
+    m_message.iterativeLookupReq.target_key = key;
+}
+
+GUChordMessage::IterativeLookupReq
+GUChordMessage::GetIterativeLookupReq ()
+{
+  return m_message.iterativeLookupReq;
+}
+
+/* ITERATIVE_LOOKUP_RSP */
+
+uint32_t 
+GUChordMessage::IterativeLookupRsp::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = CHORD_ID_SIZE + sizeof(uint8_t) + sizeof(uint32_t) + IPV4_ADDRESS_SIZE + sizeof(uint8_t) + sizeof(uint16_t) + next_hops.size() * (IPV4_ADDRESS_SIZE + sizeof(uint8_t));
+    return size;
+}
+
+void
+GUChordMessage::IterativeLookupRsp::Print (std::ostream &os) const
+{
+  os << "IterativeLookupRsp:: Target: " << target_key << " OwnerFound: " << (uint32_t) owner_found << " NextHops: " << next_hops.size() << "\n";
+}
+
+void
+GUChordMessage::IterativeLookupRsp::Serialize (Buffer::Iterator &start) const
+{
+    target_key.Serialize (start);
+
+    start.WriteU8 (owner_found);
+    start.WriteU32 (owner_node_id);
+    start.WriteHtonU32 (owner_ip_address.Get());
+    start.WriteU8 (owner_vnode);
+
+    start.WriteU16 (next_hops.size ());
+    for (uint32_t i = 0; i < next_hops.size (); i++)
+      {
+        start.WriteHtonU32 (next_hops[i].Get());
+        start.WriteU8 (next_hop_vnodes[i]);
+      }
+}
+
+uint32_t
+GUChordMessage::IterativeLookupRsp::Deserialize (Buffer::Iterator &start)
+{  
+    target_key.Deserialize (start);
+
+    owner_found = start.ReadU8 ();
+    owner_node_id = start.ReadU32 ();
+    owner_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    owner_vnode = start.ReadU8 ();
+
+    uint16_t count = start.ReadU16 ();
+    next_hops.resize (count);
+    next_hop_vnodes.resize (count);
+    for (uint16_t i = 0; i < count; i++)
+      {
+        next_hops[i] = Ipv4Address (start.ReadNtohU32 ());
+        next_hop_vnodes[i] = start.ReadU8 ();
+      }
+    return IterativeLookupRsp::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetIterativeLookupRsp (ChordId key, uint32_t node_id, Ipv4Address ip_address, uint8_t vnode)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = ITERATIVE_LOOKUP_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == ITERATIVE_LOOKUP_RSP);
+    }
+    m_message.iterativeLookupRsp.target_key = key;
+    m_message.iterativeLookupRsp.owner_found = 1;
+    m_message.iterativeLookupRsp.owner_node_id = node_id;
+    m_message.iterativeLookupRsp.owner_ip_address = ip_address;
+    m_message.iterativeLookupRsp.owner_vnode = vnode;
+    m_message.iterativeLookupRsp.next_hops.clear ();
+    m_message.iterativeLookupRsp.next_hop_vnodes.clear ();
+}
+
+void
+GUChordMessage::SetIterativeLookupRsp (ChordId key, std::vector<Ipv4Address> nextHops, std::vector<uint8_t> nextHopVnodes)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = ITERATIVE_LOOKUP_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == ITERATIVE_LOOKUP_RSP);
+    }
+    m_message.iterativeLookupRsp.target_key = key;
+    m_message.iterativeLookupRsp.owner_found = 0;
+    m_message.iterativeLookupRsp.owner_node_id = 0;
+    NS_ASSERT (nextHops.size () == nextHopVnodes.size ());
+    m_message.iterativeLookupRsp.owner_ip_address = Ipv4Address ();
+    m_message.iterativeLookupRsp.owner_vnode = 0;
+    m_message.iterativeLookupRsp.next_hops = nextHops;
+    m_message.iterativeLookupRsp.next_hop_vnodes = nextHopVnodes;
+}
+
+GUChordMessage::IterativeLookupRsp
+GUChordMessage::GetIterativeLookupRsp ()
+{
+  return m_message.iterativeLookupRsp;
+}
+
+/* LOOKUP_BATCH_REQ */
+
+uint32_t 
+GUChordMessage::LookupBatchReq::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = sizeof(uint32_t) + IPV4_ADDRESS_SIZE + sizeof(uint16_t) + target_keys.size() * (CHORD_ID_SIZE + sizeof(uint32_t));
+    return size;
+}
+
+void
+GUChordMessage::LookupBatchReq::Print (std::ostream &os) const
+{
+  os << "LookupBatchReq:: Originator: " << originator_node_id << " Keys: " << target_keys.size() << "\n";
+}
+
+void
+GUChordMessage::LookupBatchReq::Serialize (Buffer::Iterator &start) const
+{
+    start.WriteU32 (originator_node_id);
+    start.WriteHtonU32 (originator_node_ip_address.Get());
+
+    start.WriteU16 (target_keys.size ());
+    for (uint32_t i = 0; i < target_keys.size (); i++)
+      {
+        target_keys[i].Serialize (start);
+        start.WriteHtonU32 (transaction_ids[i]);
+      }
+}
+
+uint32_t
+GUChordMessage::LookupBatchReq::Deserialize (Buffer::Iterator &start)
+{  
+    originator_node_id = start.ReadU32 ();
+    originator_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+
+    uint16_t count = start.ReadU16 ();
+    target_keys.resize (count);
+    transaction_ids.resize (count);
+    for (uint16_t i = 0; i < count; i++)
+      {
+        target_keys[i].Deserialize (start);
+        transaction_ids[i] = start.ReadNtohU32 ();
+      }
+    return LookupBatchReq::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetLookupBatchReq (uint32_t node_id, Ipv4Address ip_address, std::vector<ChordId> keys, std::vector<uint32_t> transactionIds)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = LOOKUP_BATCH_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == LOOKUP_BATCH_REQ);
+    }
+    NS_ASSERT (keys.size () == transactionIds.size ());
+    m_message.lookupBatchReq.originator_node_id = node_id;
+    m_message.lookupBatchReq.originator_node_ip_address = ip_address;
+    m_message.lookupBatchReq.target_keys = keys;
+    m_message.lookupBatchReq.transaction_ids = transactionIds;
+}
+
+GUChordMessage::LookupBatchReq
+GUChordMessage::GetLookupBatchReq ()
+{
+  return m_message.lookupBatchReq;
+}
+
+/* LOOKUP_BATCH_RSP */
+
+uint32_t 
+GUChordMessage::LookupBatchRsp::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = sizeof(uint32_t) + IPV4_ADDRESS_SIZE + sizeof(uint8_t) + sizeof(uint16_t) + target_keys.size() * (CHORD_ID_SIZE + sizeof(uint32_t));
+    return size;
+}
+
+void
+GUChordMessage::LookupBatchRsp::Print (std::ostream &os) const
+{
+  os << "LookupBatchRsp:: Owner: " << owner_node_id << " Keys: " << target_keys.size() << "\n";
+}
+
+void
+GUChordMessage::LookupBatchRsp::Serialize (Buffer::Iterator &start) const
+{
+    start.WriteU32 (owner_node_id);
+    start.WriteHtonU32 (owner_ip_address.Get());
+    start.WriteU8 (owner_vnode);
+
+    start.WriteU16 (target_keys.size ());
+    for (uint32_t i = 0; i < target_keys.size (); i++)
+      {
+        target_keys[i].Serialize (start);
+        start.WriteHtonU32 (transaction_ids[i]);
+      }
+}
+
+uint32_t
+GUChordMessage::LookupBatchRsp::Deserialize (Buffer::Iterator &start)
+{  
+    owner_node_id = start.ReadU32 ();
+    owner_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    owner_vnode = start.ReadU8 ();
+
+    uint16_t count = start.ReadU16 ();
+    target_keys.resize (count);
+    transaction_ids.resize (count);
+    for (uint16_t i = 0; i < count; i++)
+      {
+        target_keys[i].Deserialize (start);
+        transaction_ids[i] = start.ReadNtohU32 ();
+      }
+    return LookupBatchRsp::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetLookupBatchRsp (uint32_t node_id, Ipv4Address ip_address, uint8_t vnode, std::vector<ChordId> keys, std::vector<uint32_t> transactionIds)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = LOOKUP_BATCH_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == LOOKUP_BATCH_RSP);
+    }
+    NS_ASSERT (keys.size () == transactionIds.size ());
+    m_message.lookupBatchRsp.owner_node_id = node_id;
+    m_message.lookupBatchRsp.owner_ip_address = ip_address;
+    m_message.lookupBatchRsp.owner_vnode = vnode;
+    m_message.lookupBatchRsp.target_keys = keys;
+    m_message.lookupBatchRsp.transaction_ids = transactionIds;
+}
+
+GUChordMessage::LookupBatchRsp
+GUChordMessage::GetLookupBatchRsp ()
+{
+  return m_message.lookupBatchRsp;
+}
+
+/* RING_SNAPSHOT */
+
+uint32_t 
+GUChordMessage::RingSnapshot::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = 2 * sizeof(uint32_t) + IPV4_ADDRESS_SIZE + 2 * sizeof(uint8_t);
+    return size;
+}
+
+void
+GUChordMessage::RingSnapshot::Print (std::ostream &os) const
+{
+  os << "RingSnapshot:: Originator: " << originator_node_id << " Position: " << position << " Broken: " << (uint32_t) broken << "\n";
+}
+
+void
+GUChordMessage::RingSnapshot::Serialize (Buffer::Iterator &start) const
+{
+    start.WriteU32 (originator_node_id);
+    start.WriteHtonU32 (originator_node_ip_address.Get());
+    start.WriteU8 (originator_vnode);
+    start.WriteU8 (broken);
+    start.WriteU32 (position);
+}
+
+uint32_t
+GUChordMessage::RingSnapshot::Deserialize (Buffer::Iterator &start)
+{  
+    originator_node_id = start.ReadU32 ();
+    originator_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    originator_vnode = start.ReadU8 ();
+    broken = start.ReadU8 ();
+    position = start.ReadU32 ();
+    return RingSnapshot::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetRingSnapshot (uint32_t originator_id, Ipv4Address originator_ip, uint8_t originator_vnode, bool broken, uint32_t position)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = RING_SNAPSHOT;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == RING_SNAPSHOT);
+    }
+    m_message.ringSnapshot.originator_node_id = originator_id;
+    m_message.ringSnapshot.originator_node_ip_address = originator_ip;
+    m_message.ringSnapshot.originator_vnode = originator_vnode;
+    m_message.ringSnapshot.broken = broken;
+    m_message.ringSnapshot.position = position;
+}
+
+GUChordMessage::RingSnapshot
+GUChordMessage::GetRingSnapshot ()
+{
+  return m_message.ringSnapshot;
+}
+
 //
 //
 //
@@ -1057,3 +1692,140 @@ GUChordMessage::GetTransactionId (void) const
   return m_transactionId;
 }
 
+void
+GUChordMessage::SetVirtualNode (uint8_t virtualNode)
+{
+  m_virtualNode = virtualNode;
+}
+
+uint8_t
+GUChordMessage::GetVirtualNode (void) const
+{
+  return m_virtualNode;
+}
+
+/* STABILIZE_NOTIFY */
+
+uint32_t 
+GUChordMessage::StabilizeNotify::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = IPV4_ADDRESS_SIZE + sizeof(uint32_t) + sizeof(uint8_t);
+    return size;
+}
+
+void
+GUChordMessage::StabilizeNotify::Print (std::ostream &os) const
+{
+  os << "StabilizeNotify:: Sender: " << sender_node_id << "\n";
+}
+
+void
+GUChordMessage::StabilizeNotify::Serialize (Buffer::Iterator &start) const
+{
+    start.WriteU32 (sender_node_id);
+    start.WriteHtonU32 (sender_node_ip_address.Get());
+    start.WriteU8 (sender_vnode);
+}
+
+uint32_t
+GUChordMessage::StabilizeNotify::Deserialize (Buffer::Iterator &start)
+{  
+    sender_node_id = start.ReadU32 ();
+    sender_node_ip_address = Ipv4Address (start.ReadNtohU32 ());
+    sender_vnode = start.ReadU8 ();
+    return StabilizeNotify::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetStabilizeNotify (uint32_t node_id, Ipv4Address ip_address, uint8_t vnode)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = STABILIZE_NOTIFY;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == STABILIZE_NOTIFY);
+    }
+    m_message.stabilizeNotify.sender_node_id = node_id;
+    m_message.stabilizeNotify.sender_node_ip_address = ip_address;
+    m_message.stabilizeNotify.sender_vnode = vnode;
+}
+
+GUChordMessage::StabilizeNotify
+GUChordMessage::GetStabilizeNotify ()
+{
+  return m_message.stabilizeNotify;
+}
+
+/* RING_SNAPSHOT_RECORD */
+
+uint32_t 
+GUChordMessage::RingSnapshotRecord::GetSerializedSize (void) const
+{
+    uint32_t size;
+    size = sizeof(uint32_t);
+    size += 3 * sizeof(uint32_t) + 3 * sizeof(uint8_t) + CHORD_ID_SIZE + 2 * sizeof(uint16_t) + sizeof(uint32_t);
+    return size;
+}
+
+void
+GUChordMessage::RingSnapshotRecord::Print (std::ostream &os) const
+{
+  os << "RingSnapshotRecord:: Position: " << position << " Node: " << record.node_id << "#" << (uint32_t) record.vnode << "\n";
+}
+
+void
+GUChordMessage::RingSnapshotRecord::Serialize (Buffer::Iterator &start) const
+{
+    start.WriteU32 (position);
+    start.WriteU32 (record.node_id);
+    start.WriteU8 (record.vnode);
+    record.node_key.Serialize (start);
+    start.WriteU32 (record.predecessor_id);
+    start.WriteU8 (record.predecessor_vnode);
+    start.WriteU32 (record.successor_id);
+    start.WriteU8 (record.successor_vnode);
+    start.WriteU16 (record.finger_nodes);
+    start.WriteU16 (record.stable_fingers);
+    start.WriteU32 (record.key_count);
+}
+
+uint32_t
+GUChordMessage::RingSnapshotRecord::Deserialize (Buffer::Iterator &start)
+{  
+    position = start.ReadU32 ();
+    record.node_id = start.ReadU32 ();
+    record.vnode = start.ReadU8 ();
+    record.node_key.Deserialize (start);
+    record.predecessor_id = start.ReadU32 ();
+    record.predecessor_vnode = start.ReadU8 ();
+    record.successor_id = start.ReadU32 ();
+    record.successor_vnode = start.ReadU8 ();
+    record.finger_nodes = start.ReadU16 ();
+    record.stable_fingers = start.ReadU16 ();
+    record.key_count = start.ReadU32 ();
+    return RingSnapshotRecord::GetSerializedSize ();
+}
+
+void
+GUChordMessage::SetRingSnapshotRecord (uint32_t position, RingRecord record)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = RING_SNAPSHOT_RECORD;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == RING_SNAPSHOT_RECORD);
+    }
+    m_message.ringSnapshotRecord.position = position;
+    m_message.ringSnapshotRecord.record = record;
+}
+
+GUChordMessage::RingSnapshotRecord
+GUChordMessage::GetRingSnapshotRecord ()
+{
+  return m_message.ringSnapshotRecord;
+}
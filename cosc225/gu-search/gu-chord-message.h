@@ -21,8 +21,10 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/packet.h"
 #include "ns3/object.h"
+#include "ns3/gu-chord-id.h"
 
 #include <sstream>
+#include <vector>
 
 using namespace ns3;
 
@@ -48,7 +50,16 @@ class GUChordMessage : public Header
         FIND_SUCCESSOR_REQ = 9,
         FIND_SUCCESSOR_RSP = 10,
         LOOKUP_REQ = 11,
-        LOOKUP_RSP = 12      
+        LOOKUP_RSP = 12,
+        FINGER_TABLE_REQ = 13,
+        FINGER_TABLE_RSP = 14,
+        ITERATIVE_LOOKUP_REQ = 15,
+        ITERATIVE_LOOKUP_RSP = 16,
+        LOOKUP_BATCH_REQ = 17,
+        LOOKUP_BATCH_RSP = 18,
+        RING_SNAPSHOT = 19,
+        STABILIZE_NOTIFY = 20,
+        RING_SNAPSHOT_RECORD = 21
       };
 
     GUChordMessage (GUChordMessage::MessageType messageType, uint32_t transactionId);
@@ -75,12 +86,24 @@ class GUChordMessage : public Header
      */
     uint32_t GetTransactionId () const;
 
+    /**
+     *  \brief Sets the virtual node of the receiver that handles the message
+     *  \param virtualNode Index of the virtual node, 0 for the node itself
+     */
+    void SetVirtualNode (uint8_t virtualNode);
+
+    /**
+     *  \returns Virtual node of the receiver that handles the message
+     */
+    uint8_t GetVirtualNode () const;
+
   private:
     /**
      *  \cond
      */
     MessageType m_messageType;
     uint32_t m_transactionId;
+    uint8_t m_virtualNode;
     /**
      *  \endcond
      */
@@ -126,6 +149,9 @@ class GUChordMessage : public Header
         Ipv4Address landmark_ip_address;
         uint32_t request_id;
         Ipv4Address request_ip_address;
+        uint8_t request_vnode;
+        // nodes the request was forwarded through
+        uint16_t hops;
     };
     
     struct JoinRsp
@@ -139,10 +165,13 @@ class GUChordMessage : public Header
         
         uint32_t request_id;
         Ipv4Address request_ip_address;
+        uint8_t request_vnode;
         uint32_t landmark_id;
         Ipv4Address landmark_ip_address;
         uint32_t successor_id;
         Ipv4Address successor_ip_address;
+        uint8_t successor_vnode;
+        uint16_t hops;
     };
     
     struct DepartureReq
@@ -156,8 +185,10 @@ class GUChordMessage : public Header
         // Payload
         uint32_t sender_node_id;
         Ipv4Address sender_node_ip_address;
+        uint8_t sender_vnode;
         uint32_t conn_node_id;
         Ipv4Address conn_node_ip_address;
+        uint8_t conn_vnode;
     };
     
     struct StabilizeReq
@@ -171,6 +202,7 @@ class GUChordMessage : public Header
 
         uint32_t sender_node_id;
         Ipv4Address sender_node_ip_address;
+        uint8_t sender_vnode;
     };
     
     struct StabilizeRsp
@@ -185,6 +217,10 @@ class GUChordMessage : public Header
 
         uint32_t predecessor_node_id;
         Ipv4Address predecessor_node_ip_address;
+        uint8_t predecessor_vnode;
+        // sender's successor list, nearest first
+        std::vector<Ipv4Address> successor_list;
+        std::vector<uint8_t> successor_vnodes;
     };
 
     struct RingStatePing
@@ -199,6 +235,7 @@ class GUChordMessage : public Header
 
         uint32_t originator_node_id;
         Ipv4Address originator_node_ip_address;
+        uint8_t originator_vnode;
     };
 
     struct FindSuccessorReq
@@ -213,7 +250,8 @@ class GUChordMessage : public Header
 
         uint32_t originator_node_id;
         Ipv4Address originator_node_ip_address;
-        std::string start_value;
+        uint8_t originator_vnode;
+        ChordId start_value;
         uint32_t start_value_index;
 
     };
@@ -230,7 +268,8 @@ class GUChordMessage : public Header
 
         uint32_t successor_node_id;
         Ipv4Address successor_node_ip_address;
-        std::string start_value;
+        uint8_t successor_vnode;
+        ChordId start_value;
         uint32_t start_value_index;
 
     };
@@ -247,7 +286,7 @@ class GUChordMessage : public Header
 
         uint32_t originator_node_id;
         Ipv4Address originator_node_ip_address;
-        std::string target_key;
+        ChordId target_key;
 
     };
 
@@ -265,10 +304,181 @@ class GUChordMessage : public Header
         Ipv4Address originator_node_ip_address;
         uint32_t successor_node_id;
         Ipv4Address successor_node_ip_address;
-        std::string target_key;
+        uint8_t successor_vnode;
+        ChordId target_key;
 
     };
 
+    struct FingerTableReq
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        uint32_t sender_node_id;
+        Ipv4Address sender_node_ip_address;
+        uint8_t sender_vnode;
+    };
+
+    struct FingerTableRsp
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        // distinct nodes in the sender's finger table
+        std::vector<Ipv4Address> finger_ip_addresses;
+        std::vector<uint8_t> finger_vnodes;
+    };
+
+    struct IterativeLookupReq
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        uint32_t originator_node_id;
+        Ipv4Address originator_node_ip_address;
+        ChordId target_key;
+    };
+
+    struct IterativeLookupRsp
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        ChordId target_key;
+        // set when the responder knows who owns target_key
+        uint8_t owner_found;
+        uint32_t owner_node_id;
+        Ipv4Address owner_ip_address;
+        uint8_t owner_vnode;
+        // otherwise nodes closer to target_key, closest first
+        std::vector<Ipv4Address> next_hops;
+        std::vector<uint8_t> next_hop_vnodes;
+    };
+
+    struct LookupBatchReq
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        uint32_t originator_node_id;
+        Ipv4Address originator_node_ip_address;
+        // sorted by key; transaction_ids[i] belongs to target_keys[i]
+        std::vector<ChordId> target_keys;
+        std::vector<uint32_t> transaction_ids;
+    };
+
+    struct LookupBatchRsp
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        uint32_t owner_node_id;
+        Ipv4Address owner_ip_address;
+        uint8_t owner_vnode;
+        // keys owned by owner_ip_address and the originator's transaction ids
+        std::vector<ChordId> target_keys;
+        std::vector<uint32_t> transaction_ids;
+    };
+
+    // one ring position as seen by the node holding it
+    struct RingRecord
+    {
+        uint32_t node_id;
+        uint8_t vnode;
+        ChordId node_key;
+        uint32_t predecessor_id;
+        uint8_t predecessor_vnode;
+        uint32_t successor_id;
+        uint8_t successor_vnode;
+        // distinct nodes in the finger table and fingers stable since the last fix
+        uint16_t finger_nodes;
+        uint16_t stable_fingers;
+        uint32_t key_count;
+    };
+
+    // tells a neighbour the ring changed next to it, so it stabilizes at
+    // the shortest period again
+    struct StabilizeNotify
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        uint32_t sender_node_id;
+        Ipv4Address sender_node_ip_address;
+        uint8_t sender_vnode;
+    };
+
+    struct RingSnapshot
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        uint32_t originator_node_id;
+        Ipv4Address originator_node_ip_address;
+        uint8_t originator_vnode;
+        // set when a node found itself already on the path, the ring
+        // loops back before reaching the originator
+        uint8_t broken;
+        // ring position of the node the snapshot is sent to, the
+        // originator is 0
+        uint32_t position;
+    };
+
+    // one position's record, sent straight to the snapshot's originator
+    struct RingSnapshotRecord
+    {
+
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+
+        // Payload
+
+        uint32_t position;
+        RingRecord record;
+    };
+
   private:
     struct
       {
@@ -284,6 +494,15 @@ class GUChordMessage : public Header
         FindSuccessorRsp findSuccessorRsp;
         LookupReq lookupReq;
         LookupRsp lookupRsp;
+        FingerTableReq fingerTableReq;
+        FingerTableRsp fingerTableRsp;
+        IterativeLookupReq iterativeLookupReq;
+        IterativeLookupRsp iterativeLookupRsp;
+        LookupBatchReq lookupBatchReq;
+        LookupBatchRsp lookupBatchRsp;
+        RingSnapshot ringSnapshot;
+        RingSnapshotRecord ringSnapshotRecord;
+        StabilizeNotify stabilizeNotify;
 
       } m_message;
     
@@ -312,36 +531,65 @@ class GUChordMessage : public Header
 
     JoinReq GetJoinReq ();
     void SetJoinReq (JoinReq);
-    void SetJoinReq (uint32_t, Ipv4Address, uint32_t, Ipv4Address); 
+    void SetJoinReq (uint32_t, Ipv4Address, uint8_t, uint32_t, Ipv4Address);
 
     JoinRsp GetJoinRsp ();
     void SetJoinRsp (JoinRsp);
-    void SetJoinRsp (JoinReq, uint32_t, Ipv4Address);
+    void SetJoinRsp (JoinReq, uint32_t, Ipv4Address, uint8_t);
 
     DepartureReq GetDepartureReq ();
-    void SetDepartureReq (uint32_t, Ipv4Address, uint32_t, Ipv4Address);
+    void SetDepartureReq (uint32_t, Ipv4Address, uint8_t, uint32_t, Ipv4Address, uint8_t);
     void SetDepartureReq ();
 
     StabilizeReq GetStabilizeReq ();
-    void SetStabilizeReq (uint32_t, Ipv4Address);
+    void SetStabilizeReq (uint32_t, Ipv4Address, uint8_t);
 
     StabilizeRsp GetStabilizeRsp ();
-    void SetStabilizeRsp (uint32_t, Ipv4Address);
+    void SetStabilizeRsp (uint32_t, Ipv4Address, uint8_t, std::vector<Ipv4Address>, std::vector<uint8_t>);
 
     RingStatePing GetRingStatePing ();
-    void SetRingStatePing (uint32_t, Ipv4Address);
+    void SetRingStatePing (uint32_t, Ipv4Address, uint8_t);
 
     FindSuccessorReq GetFindSuccessorReq ();
-    void SetFindSuccessorReq (uint32_t, Ipv4Address, std::string, uint32_t);
+    void SetFindSuccessorReq (uint32_t, Ipv4Address, uint8_t, ChordId, uint32_t);
    
     FindSuccessorRsp GetFindSuccessorRsp ();
-    void SetFindSuccessorRsp (uint32_t, Ipv4Address, std::string, uint32_t);
+    void SetFindSuccessorRsp (uint32_t, Ipv4Address, uint8_t, ChordId, uint32_t);
    
     LookupReq GetLookupReq ();
-    void SetLookupReq (uint32_t, Ipv4Address, std::string);
+    void SetLookupReq (uint32_t, Ipv4Address, ChordId);
    
     LookupRsp GetLookupRsp ();
-    void SetLookupRsp (uint32_t, Ipv4Address, uint32_t, Ipv4Address, std::string);
+    void SetLookupRsp (uint32_t, Ipv4Address, uint32_t, Ipv4Address, uint8_t, ChordId);
+
+    FingerTableReq GetFingerTableReq ();
+    void SetFingerTableReq (uint32_t, Ipv4Address, uint8_t);
+
+    FingerTableRsp GetFingerTableRsp ();
+    void SetFingerTableRsp (std::vector<Ipv4Address>, std::vector<uint8_t>);
+
+    IterativeLookupReq GetIterativeLookupReq ();
+    void SetIterativeLookupReq (uint32_t, Ipv4Address, ChordId);
+
+    IterativeLookupRsp GetIterativeLookupRsp ();
+    void SetIterativeLookupRsp (ChordId, uint32_t, Ipv4Address, uint8_t);
+    void SetIterativeLookupRsp (ChordId, std::vector<Ipv4Address>, std::vector<uint8_t>);
+
+    LookupBatchReq GetLookupBatchReq ();
+    void SetLookupBatchReq (uint32_t, Ipv4Address, std::vector<ChordId>, std::vector<uint32_t>);
+
+    LookupBatchRsp GetLookupBatchRsp ();
+    void SetLookupBatchRsp (uint32_t, Ipv4Address, uint8_t, std::vector<ChordId>, std::vector<uint32_t>);
+
+
+    RingSnapshot GetRingSnapshot ();
+    void SetRingSnapshot (uint32_t, Ipv4Address, uint8_t, bool, uint32_t);
+
+    RingSnapshotRecord GetRingSnapshotRecord ();
+    void SetRingSnapshotRecord (uint32_t, RingRecord);
+
+    StabilizeNotify GetStabilizeNotify ();
+    void SetStabilizeNotify (uint32_t, Ipv4Address, uint8_t);
 
 }; // class GUChordMessage
 
@@ -23,6 +23,7 @@
 #include "ns3/inet-socket-address.h"
 
 #include <vector>
+#include <algorithm>
 
 #include <sstream>
 
@@ -30,6 +31,9 @@
 
 using namespace ns3;
 
+// PING_REQ payload of RTT probes, not reported to the application
+#define PROXIMITY_PING_MESSAGE "proximity"
+
 TypeId
 GUChord::GetTypeId ()
 {
@@ -46,12 +50,123 @@ GUChord::GetTypeId ()
                    TimeValue (MilliSeconds (2000)),
                    MakeTimeAccessor (&GUChord::m_pingTimeout),
                    MakeTimeChecker ())
+    .AddAttribute ("ParallelFingerInit",
+                   "Resolve all fingers in one pipelined batch after join instead of one at a time",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&GUChord::m_parallelFingerInit),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SuccessorListSize",
+                   "Number of successors kept for failover",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&GUChord::m_successorListSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("LookupTimeout",
+                   "Time to wait for a lookup result before retrying, doubled on every retry",
+                   TimeValue (MilliSeconds (1000)),
+                   MakeTimeAccessor (&GUChord::m_lookupTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("LookupRetries",
+                   "Retries of a lookup before it is reported as failed",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&GUChord::m_lookupRetries),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxPendingLookups",
+                   "Most lookups outstanding at once, further lookups fail right away",
+                   UintegerValue (4096),
+                   MakeUintegerAccessor (&GUChord::m_maxPendingLookups),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("IterativeLookup",
+                   "Let the originator drive lookups with parallel probes instead of forwarding them hop by hop",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&GUChord::m_iterativeLookup),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LookupAlpha",
+                   "Concurrent probes per iterative lookup",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&GUChord::m_lookupAlpha),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ProbeTimeout",
+                   "Timeout value for one iterative lookup probe in milliseconds",
+                   TimeValue (MilliSeconds (500)),
+                   MakeTimeAccessor (&GUChord::m_probeTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("LookupBatchSize",
+                   "Payload bytes per LOOKUP_BATCH_REQ, kept within one unfragmented datagram",
+                   UintegerValue (1400),
+                   MakeUintegerAccessor (&GUChord::m_lookupBatchSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("LookupCacheSize",
+                   "Number of owner ranges remembered from earlier lookups, 0 disables the cache",
+                   UintegerValue (128),
+                   MakeUintegerAccessor (&GUChord::m_lookupCacheSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("LookupCacheLifetime",
+                   "Time an owner range learned from a lookup is used, in milliseconds",
+                   TimeValue (MilliSeconds (30000)),
+                   MakeTimeAccessor (&GUChord::m_lookupCacheLifetime),
+                   MakeTimeChecker ())
+    .AddAttribute ("ProximityCandidates",
+                   "Nodes kept per finger interval to pick the lowest RTT finger from, 0 disables proximity selection",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&GUChord::m_proximityCandidates),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("VirtualNodes",
+                   "Ring positions taken by every node, more spread the keys more evenly (at most 255)",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&GUChord::m_virtualNodeCount),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FingerFixCount",
+                   "Fingers refreshed per stabilize round",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&GUChord::m_fingerFixCount),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FingerStableRounds",
+                   "Consecutive unchanged lookups after which a finger is refreshed only every FingerStableRounds+1 visits",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&GUChord::m_fingerStableRounds),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("StabilizeMinInterval",
+                   "Stabilize period used after churn, in milliseconds",
+                   TimeValue (MilliSeconds (2000)),
+                   MakeTimeAccessor (&GUChord::m_stabilizeMinInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("StabilizeMaxInterval",
+                   "Upper bound the stabilize period backs off to while the ring is unchanged, in milliseconds; "
+                   "a silent predecessor is dropped after twice this",
+                   TimeValue (MilliSeconds (8000)),
+                   MakeTimeAccessor (&GUChord::m_stabilizeMaxInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("RingSnapshotTimeout",
+                   "Time without a new record after which a ring snapshot is reported as it is, in milliseconds",
+                   TimeValue (MilliSeconds (5000)),
+                   MakeTimeAccessor (&GUChord::m_ringSnapshotTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("JoinTimeout",
+                   "Time after which an unanswered JOIN_REQ is sent again, in milliseconds",
+                   TimeValue (MilliSeconds (3000)),
+                   MakeTimeAccessor (&GUChord::m_joinTimeout),
+                   MakeTimeChecker ())
     ;
   return tid;
 }
 
 GUChord::GUChord ()
-  : m_auditPingsTimer (Timer::CANCEL_ON_DESTROY)
+  : m_auditPingsTimer (Timer::CANCEL_ON_DESTROY),
+    m_auditProbesTimer (Timer::CANCEL_ON_DESTROY),
+    m_auditLookupsTimer (Timer::CANCEL_ON_DESTROY),
+    m_fingerFixCursor (1),
+    m_lookupsIssued (0),
+    m_lookupsSucceeded (0),
+    m_lookupsFailed (0),
+    m_lookupsRetried (0),
+    m_ringSnapshotPending (false),
+    m_fingerBootstrapping (false),
+    m_fingerSeedPending (false),
+    m_fingerBootstrapLookups (0),
+    m_joinHops (0),
+    m_joinPending (false),
+    m_joinLandmarkId (0),
+    m_currentVirtualNode (0)
 {
   RandomVariable random;
   SeedManager::SetSeed (time (NULL));
@@ -72,38 +187,185 @@ GUChord::DoDispose ()
   GUApplication::DoDispose ();
 }
 
-std::string
+ChordId
 GUChord::ipHash(Ipv4Address ip_address) 
 {
+    return NodeKey (ip_address, 0);
+}
+
+ChordId
+GUChord::NodeKey(Ipv4Address ip_address, uint8_t vnode)
+{
+    std::pair<Ipv4Address, uint8_t> node = std::make_pair (ip_address, vnode);
+    std::map<std::pair<Ipv4Address, uint8_t>, ChordId>::iterator it = m_nodeKeyCache.find (node);
+    if (it != m_nodeKeyCache.end ())
+      {
+        return it->second;
+      }
+    ChordId key = ChordId::Hash(ip_address, vnode);
+    m_nodeKeyCache.insert (std::make_pair (node, key));
+    return key;
+}
 
-    std::stringstream strs;
-    strs << ip_address;
-    std::string ip_string = strs.str();
-    char const* ip_char_star = ip_string.c_str();
+void
+GUChord::SwapVirtualNode(VirtualNode &node)
+{
+    std::swap (successor_id, node.successor_id);
+    std::swap (predecessor_id, node.predecessor_id);
+    std::swap (successor_ip_address, node.successor_ip_address);
+    std::swap (predecessor_ip_address, node.predecessor_ip_address);
+    std::swap (successor_node_key, node.successor_node_key);
+    std::swap (predecessor_node_key, node.predecessor_node_key);
+    std::swap (successor_vnode, node.successor_vnode);
+    std::swap (predecessor_vnode, node.predecessor_vnode);
+    successor_list.swap (node.successor_list);
+    std::swap (stabilize_timeout, node.stabilize_timeout);
+    std::swap (in_ring, node.in_ring);
+    std::swap (my_node_key, node.my_node_key);
+    m_stabilizeTracker.swap (node.stabilize_tracker);
+    std::swap (m_fingerFixCursor, node.finger_fix_cursor);
+    std::swap (m_lastStabilizeSuccessor, node.last_stabilize_successor);
+    std::swap (m_lastStabilizePredecessor, node.last_stabilize_predecessor);
+    std::swap (m_predecessorLastSeen, node.predecessor_last_seen);
+    std::swap (m_nextStabilize, node.next_stabilize);
+    finger_table.swap (node.finger_table);
+    m_fingerNodes.swap (node.finger_nodes);
+    m_proximityNodes.swap (node.proximity_nodes);
+    std::swap (m_fingerBootstrapping, node.finger_bootstrapping);
+    std::swap (m_fingerSeedPending, node.finger_seed_pending);
+    m_fingerBootstrapPending.swap (node.finger_bootstrap_pending);
+    std::swap (m_fingerBootstrapLookups, node.finger_bootstrap_lookups);
+    std::swap (m_joinStart, node.join_start);
+    std::swap (m_joinRoutedTime, node.join_routed_time);
+    std::swap (m_joinTime, node.join_time);
+    std::swap (m_joinHops, node.join_hops);
+    std::swap (m_joinPending, node.join_pending);
+    std::swap (m_joinSent, node.join_sent);
+}
 
-    unsigned char const* ip_char_star_2 = NULL;
+// The slot of the selected virtual node holds no state, its state is in
+// the members; selecting another one parks it there and loads the other
+void
+GUChord::SelectVirtualNode(uint8_t vnode)
+{
+    if (vnode == m_currentVirtualNode || vnode >= m_virtualNodes.size())
+        return;
+    SwapVirtualNode (m_virtualNodes[m_currentVirtualNode]);
+    SwapVirtualNode (m_virtualNodes[vnode]);
+    m_currentVirtualNode = vnode;
+}
 
-    ip_char_star_2 = reinterpret_cast<unsigned char const *>(ip_char_star);
+GUChord::VirtualNodeScope::VirtualNodeScope (GUChord &chord)
+  : m_chord (chord),
+    m_vnode (chord.m_currentVirtualNode)
+{
+}
 
-    unsigned char sha_input[20];
-  
-    SHA1(ip_char_star_2, strlen(ip_char_star), sha_input);
+GUChord::VirtualNodeScope::~VirtualNodeScope ()
+{
+  m_chord.SelectVirtualNode (m_vnode);
+}
 
-    std::string node_key_hex = "";
+void
+GUChord::SelectVirtualNodeFor(const ChordId &key)
+{
+    uint8_t best = m_currentVirtualNode;
+    ChordId bestDistance;
+    bool found = false;
+    for (uint32_t v = 0; v < m_virtualNodes.size(); v++)
+    {
+        SelectVirtualNode (v);
+        if (!in_ring)
+            continue;
+        if (OwnsKey (key))
+            return;
+        ChordId distance = key.Subtract (my_node_key);
+        if (!found || distance < bestDistance)
+        {
+            best = v;
+            bestDistance = distance;
+            found = true;
+        }
+    }
+    SelectVirtualNode (best);
+}
 
-    for (int i = 0; i < 20; i++) {
+uint8_t
+GUChord::GetVirtualNodeCount() const
+{
+    return m_virtualNodes.size();
+}
 
-        std::ostringstream strys;
-        strys << std::hex << std::setfill('0') << std::setw(2)
-              << static_cast<int>(sha_input[i]);
-        std::string temp = strys.str();
+bool
+GUChord::OwnsKey(const ChordId &key) const
+{
+    // a lost predecessor leaves the lower bound unknown, (0, me] would claim
+    // keys that belong to the nodes behind us
+    if (predecessor_node_key == ChordId ())
+        return successor_node_key == my_node_key;
+    return ChordId::IsSuccessor (predecessor_node_key, key, my_node_key);
+}
 
-        node_key_hex.append(temp);    
+bool
+GUChord::IsInRing()
+{
+    VirtualNodeScope scope (*this);
+    bool joined = false;
+    for (uint32_t v = 0; v < m_virtualNodes.size() && !joined; v++)
+    {
+        SelectVirtualNode (v);
+        joined = in_ring;
     }
+    return joined;
+}
 
-    return node_key_hex;
+bool
+GUChord::IsLocalKey(const ChordId &key)
+{
+    VirtualNodeScope scope (*this);
+    bool local = false;
+    for (uint32_t v = 0; v < m_virtualNodes.size() && !local; v++)
+    {
+        SelectVirtualNode (v);
+        local = OwnsKey (key);
+    }
+    return local;
+}
 
+std::vector<Ipv4Address>
+GUChord::GetReplicaSet(const ChordId &key, uint32_t count)
+{
+    VirtualNodeScope scope (*this);
+    SelectVirtualNodeFor (key);
+    // our own other virtual nodes and repeated nodes add no copy
+    std::vector<Ipv4Address> replicas;
+    for (uint32_t i = 0; i < successor_list.size() && replicas.size() < count; i++)
+    {
+        Ipv4Address address = successor_list[i].ip_address;
+        if (address == GetLocalAddress() || std::find(replicas.begin(), replicas.end(), address) != replicas.end())
+            continue;
+        replicas.push_back(address);
+    }
+    return replicas;
+}
 
+double
+GUChord::GetKeySpaceShare()
+{
+    VirtualNodeScope scope (*this);
+    double share = 0;
+    for (uint32_t v = 0; v < m_virtualNodes.size(); v++)
+    {
+        SelectVirtualNode (v);
+        if (!in_ring || predecessor_node_key == ChordId ())
+            continue;
+        // alone on the ring, everything is ours
+        if (predecessor_node_key == my_node_key)
+            share += 1.0;
+        else
+            share += my_node_key.Subtract (predecessor_node_key).GetRingFraction ();
+    }
+    return share;
 }
 
 void
@@ -114,10 +376,27 @@ GUChord::StartApplication (void)
   stabilization_messages = false;
   show_next_stabilize = false;
 
-  my_node_key_hex = "";
-
-  my_node_key_hex = ipHash(GetLocalAddress());
-  std::cout << "Node: " << atoi(ReverseLookup(GetLocalAddress()).c_str()) <<  " " << my_node_key_hex << std::endl;
+  // fresh state for every virtual node, parked in its slot except for
+  // virtual node 0 which stays selected
+  m_virtualNodes.clear ();
+  m_virtualNodes.resize (std::max (std::min (m_virtualNodeCount, (uint32_t) 255), (uint32_t) 1));
+  m_currentVirtualNode = 0;
+  for (int32_t v = m_virtualNodes.size () - 1; v >= 0; v--)
+    {
+      my_node_key = NodeKey(GetLocalAddress(), v);
+      in_ring = false;
+      successor_vnode = 0;
+      predecessor_vnode = 0;
+      stabilize_timeout = m_stabilizeMinInterval;
+      m_nextStabilize = Simulator::Now () + stabilize_timeout;
+      m_fingerFixCursor = 1;
+      m_fingerBootstrapping = false;
+      m_fingerSeedPending = false;
+      m_fingerBootstrapLookups = 0;
+      if (v > 0)
+        SwapVirtualNode (m_virtualNodes[v]);
+    }
+  std::cout << "Node: " << atoi(ReverseLookup(GetLocalAddress()).c_str()) <<  " " << my_node_key << std::endl;
 
   if (m_socket == 0)
     { 
@@ -131,9 +410,11 @@ GUChord::StartApplication (void)
 
   // Configure timers
   m_auditPingsTimer.SetFunction (&GUChord::AuditPings, this);
+  m_auditProbesTimer.SetFunction (&GUChord::AuditProbes, this);
+  m_auditLookupsTimer.SetFunction (&GUChord::AuditLookups, this);
   // Start timers
   m_auditPingsTimer.Schedule (m_pingTimeout);
-    stabilize_timeout = MilliSeconds (2000);
+    stabilize_timeout = m_stabilizeMinInterval;
     stabilize_timer.SetFunction (&GUChord::RunStabilize, this);
     stabilize_timer.Schedule(stabilize_timeout);
 
@@ -152,122 +433,354 @@ GUChord::StopApplication (void)
 
   // Cancel timers
   m_auditPingsTimer.Cancel ();
+  m_auditProbesTimer.Cancel ();
+  m_auditLookupsTimer.Cancel ();
     stabilize_timer.Cancel();
 
   m_pingTracker.clear ();
+  m_stabilizeTracker.clear ();
+  for (uint32_t v = 0; v < m_virtualNodes.size (); v++)
+    {
+      m_virtualNodes[v].stabilize_tracker.clear ();
+      m_virtualNodes[v].finger_bootstrap_pending.clear ();
+    }
+  m_proximityPingTracker.clear ();
+  m_pingDeadlines.Clear ();
+  m_probeTracker.clear ();
+  m_probeDeadlines.Clear ();
+  m_iterativeLookups.clear ();
+  m_lookupTransactions.clear ();
+  m_lookupDeadlines.Clear ();
+  LookupCacheClear ();
+  m_fingerBootstrapPending.clear ();
+  m_ringSnapshotPending = false;
+  m_ringSnapshotsSeen.clear ();
 }
 
 void
-GUChord::SendChordLookup(std::string target_key, uint32_t transId)
+GUChord::SendChordLookup(ChordId target_key, uint32_t transId)
 {
     //uint32_t transactionId = GetNextTransactionId ();
     uint32_t transactionId = transId;
     
 
-    CHORD_LOG ("\nLookupIssue<CurrentNodeKey: " << my_node_key_hex << ", TargetKey: " << target_key << ">");
+    CHORD_LOG ("\nLookupIssue<CurrentNodeKey: " << my_node_key << ", TargetKey: " << target_key << ">");
+
+    uint32_t owner_node_id;
+    Ipv4Address owner_ip_address;
+    ChordId owner_node_key;
+    if (LookupCacheFind(target_key, owner_node_id, owner_ip_address, owner_node_key))
+    {
+        CHORD_LOG ("\nLookupCacheHit<CurrentNodeKey: " << my_node_key << ", TargetKey: " << target_key << ", OwnerNode: " << owner_node_id << ">");
+        // callers register the transaction after this returns
+        Simulator::ScheduleNow (&GUChord::DeliverChordLookup, this, owner_ip_address, owner_node_id, owner_node_key.ToHex(), transactionId);
+        return;
+    }
+
+    if (TrackChordLookup(target_key, transactionId))
+        IssueChordLookup(target_key, transactionId);
+}
+
+// Sends one attempt of a tracked lookup
+void
+GUChord::IssueChordLookup(ChordId target_key, uint32_t transactionId)
+{
+    // start from our virtual node closest to the target
+    VirtualNodeScope scope (*this);
+    SelectVirtualNodeFor(target_key);
+
+    if (m_iterativeLookup)
+    {
+        // we are the first node asked, so the lookup also works alone
+        IterativeLookupCancel(transactionId);
+        IterativeLookup lookup;
+        lookup.target = target_key;
+        lookup.in_flight = 0;
+        m_iterativeLookups[transactionId] = lookup;
+        IterativeLookupAddCandidate(transactionId, GetLocalAddress(), m_currentVirtualNode);
+        IterativeLookupStep(transactionId);
+        return;
+    }
 
     Ptr<Packet> packet = Create<Packet> ();
     GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::LOOKUP_REQ, transactionId );
 
     guChordMessage.SetLookupReq (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), target_key);
+    guChordMessage.SetVirtualNode (m_currentVirtualNode);
     packet->AddHeader (guChordMessage);
     m_socket->SendTo (packet, 0 , InetSocketAddress (GetLocalAddress(), m_appPort));
 
 }
 
-// i = 1 means manipulating index 0
 void
-GUChord::FingerFix(uint32_t i)
+GUChord::SendChordLookupBatch(std::vector<ChordId> target_keys, std::vector<uint32_t> transIds)
+{
+    // sorted keys let every hop split the batch into contiguous runs
+    std::vector<std::pair<ChordId, uint32_t> > pending;
+    for (uint32_t i = 0; i < target_keys.size(); i++)
+    {
+        uint32_t owner_node_id;
+        Ipv4Address owner_ip_address;
+        ChordId owner_node_key;
+        if (LookupCacheFind(target_keys[i], owner_node_id, owner_ip_address, owner_node_key))
+        {
+            Simulator::ScheduleNow (&GUChord::DeliverChordLookup, this, owner_ip_address, owner_node_id, owner_node_key.ToHex(), transIds[i]);
+            continue;
+        }
+        if (TrackChordLookup(target_keys[i], transIds[i]))
+            pending.push_back(std::make_pair(target_keys[i], transIds[i]));
+    }
+    std::sort(pending.begin(), pending.end());
+
+    CHORD_LOG ("\nLookupBatchIssue<CurrentNodeKey: " << my_node_key << ", Keys: " << pending.size() << ", Answered: " << target_keys.size() - pending.size() << ">");
+
+    // Every message a batch turns into along the ring carries a subset of
+    // its keys, and answers are the largest of them, so a batch is sized
+    // by its answer. ns-3 does not fragment, a larger datagram is lost
+    GUChordMessage empty = GUChordMessage (GUChordMessage::LOOKUP_BATCH_RSP, 0);
+    empty.SetLookupBatchRsp (0, Ipv4Address (), 0, std::vector<ChordId> (), std::vector<uint32_t> ());
+    uint32_t fixed = empty.GetSerializedSize ();
+    uint32_t perKey = CHORD_ID_SIZE + sizeof (uint32_t);
+    uint32_t batchSize = m_lookupBatchSize > fixed + perKey ? (m_lookupBatchSize - fixed) / perKey : 1;
+    for (uint32_t first = 0; first < pending.size(); first += batchSize)
+    {
+        std::vector<ChordId> keys;
+        std::vector<uint32_t> ids;
+        for (uint32_t i = first; i < pending.size() && i < first + batchSize; i++)
+        {
+            keys.push_back(pending[i].first);
+            ids.push_back(pending[i].second);
+        }
+
+        Ptr<Packet> packet = Create<Packet> ();
+        GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::LOOKUP_BATCH_REQ, GetNextTransactionId ());
+        guChordMessage.SetLookupBatchReq (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), keys, ids);
+        packet->AddHeader (guChordMessage);
+        m_socket->SendTo (packet, 0 , InetSocketAddress (GetLocalAddress(), m_appPort));
+    }
+}
+
+// Refreshes the next m_fingerFixCount fingers after the cursor. Index 0
+// is the successor and is kept current by stabilize itself. Waits for the
+// bootstrap to finish, whose answers are matched to its runs by finger
+// index alone.
+void
+GUChord::FingerFix()
 {
-  if (finger_table.size() != 160)
+  if (finger_table.size() != 160 || m_fingerBootstrapping)
     return;
-  mpz_t prev_finger_start;
-  mpz_t prev_finger_node;
-  mpz_t curr_finger_start;
-  for (;i <= 160; i++)
+
+  uint32_t sent = 0;
+  uint32_t budget = std::min ((uint32_t) finger_table.size() - 1, 4 * m_fingerFixCount);
+  for (uint32_t visited = 0; visited < budget && sent < m_fingerFixCount; visited++)
   {
-    mpz_init_set_str(prev_finger_start, finger_table[i-2].start_value.c_str(), 16);
-    mpz_init_set_str(prev_finger_node, finger_table[i-2].finger_key_hash.c_str(), 16);
-    mpz_init_set_str(curr_finger_start, finger_table[i-1].start_value.c_str(), 16);
-    if (isInBetween(prev_finger_start, curr_finger_start, prev_finger_node))
-    {
-      uint32_t transactionId = GetNextTransactionId ();
+    uint32_t i = m_fingerFixCursor;
+    m_fingerFixCursor = m_fingerFixCursor % (finger_table.size() - 1) + 1;
+    FingerTableEntry &entry = finger_table[i];
 
-      Ptr<Packet> packet = Create<Packet> ();
-      GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::FIND_SUCCESSOR_REQ, transactionId );
+    // proven fingers are only rechecked every few visits
+    if (entry.stable_rounds >= m_fingerStableRounds && entry.skip_rounds < m_fingerStableRounds)
+    {
+      entry.skip_rounds++;
+      continue;
+    }
+    entry.skip_rounds = 0;
 
-      guChordMessage.SetFindSuccessorReq (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), finger_table[i-1].start_value, i-1);
-      packet->AddHeader (guChordMessage);
-      m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
-      break;
+    // starts up to our successor need no lookup
+    if (ChordId::IsInBetween(my_node_key, entry.start_value, successor_node_key))
+    {
+      if (entry.finger_key_hash == successor_node_key)
+        entry.stable_rounds++;
+      else
+        entry.stable_rounds = 0;
+      entry.finger_ip_address = successor_ip_address;
+      entry.finger_vnode = successor_vnode;
+      entry.finger_node_id = ReverseLookup(successor_ip_address);
+      entry.finger_key_hash = successor_node_key;
+      continue;
     }
+
+    int32_t finger = ClosestPrecedingFinger (entry.start_value);
+    RingNode via = finger < 0 ? RingNode (successor_ip_address, successor_vnode) : RingNode (m_fingerNodes[finger].ip_address, m_fingerNodes[finger].vnode);
+
+    Ptr<Packet> packet = Create<Packet> ();
+    GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::FIND_SUCCESSOR_REQ, GetNextTransactionId ());
+
+    guChordMessage.SetFindSuccessorReq (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), m_currentVirtualNode, entry.start_value, i);
+    guChordMessage.SetVirtualNode (via.vnode);
+    packet->AddHeader (guChordMessage);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (via.ip_address, m_appPort));
+    sent++;
   }
+  UpdateFingerNodes();
 }
 
-bool GUChord::isInBetween(mpz_t my_key_gmp, mpz_t lookup_key_gmp, mpz_t successor_key_gmp)
+// i = 1 when manipulating index 0
+void
+GUChord::FingerInit(int i)
+{
+
+        FingerTableEntry entry;
+        entry.start_value = my_node_key.AddPowerOfTwo(i-1);
+        
+        finger_table.push_back(entry);
+
+        uint32_t index = i - 1;
+
+        // a run of one finger, so a lost answer is resent like a batch one
+        SendFingerBootstrapReq(index, index, successor_ip_address, successor_vnode);
+
+} 
+
+// Fills the whole table with the successor and asks it for its fingers
+void
+GUChord::FingerBootstrap()
 {
-  if(mpz_cmp(lookup_key_gmp, successor_key_gmp) <= 0 && mpz_cmp(lookup_key_gmp, my_key_gmp) > 0)
-        return true;
-  if (mpz_cmp(my_key_gmp, successor_key_gmp) > 0 && mpz_cmp(lookup_key_gmp, my_key_gmp) > 0)
-        return true;
-  if (mpz_cmp(my_key_gmp, successor_key_gmp) > 0 && mpz_cmp(lookup_key_gmp, successor_key_gmp) < 0)
-        return true;
-  return false;
+    finger_table.clear();
+    m_fingerBootstrapPending.clear();
+    m_fingerBootstrapLookups = 0;
+
+    for (uint32_t i = 1; i <= 160; i++)
+    {
+        FingerTableEntry entry;
+        entry.start_value = my_node_key.AddPowerOfTwo(i-1);
+        entry.finger_ip_address = successor_ip_address;
+        entry.finger_vnode = successor_vnode;
+        entry.finger_node_id = ReverseLookup(successor_ip_address);
+        entry.finger_key_hash = successor_node_key;
+        finger_table.push_back(entry);
+    }
+    UpdateFingerNodes();
+
+    m_fingerSeedPending = true;
+
+    Ptr<Packet> packet = Create<Packet> ();
+    GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::FINGER_TABLE_REQ, GetNextTransactionId ());
+
+    guChordMessage.SetFingerTableReq (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), m_currentVirtualNode);
+    guChordMessage.SetVirtualNode (successor_vnode);
+    packet->AddHeader (guChordMessage);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
 }
 
-// i = 1 when manipulating index 0
+// Issues one FIND_SUCCESSOR_REQ per run of fingers seeded with the same node
 void
-GUChord::FingerInit(int i)
+GUChord::FingerBootstrapLookups()
 {
+    m_fingerSeedPending = false;
+
+    // starts in (me, successor] already point at the right node
+    uint32_t i = 0;
+    while (i < finger_table.size() && ChordId::IsInBetween(my_node_key, finger_table[i].start_value, successor_node_key))
+        i++;
+
+    while (i < finger_table.size())
+    {
+        uint32_t last = i;
+        while (last + 1 < finger_table.size() && finger_table[last+1].finger_key_hash == finger_table[i].finger_key_hash)
+            last++;
+
+        // the previous finger's node precedes this start
+        if (i == 0)
+            SendFingerBootstrapReq(i, last, successor_ip_address, successor_vnode);
+        else
+            SendFingerBootstrapReq(i, last, finger_table[i-1].finger_ip_address, finger_table[i-1].finger_vnode);
+        i = last + 1;
+    }
+
+    if (m_fingerBootstrapPending.empty())
+        FingerBootstrapDone();
+}
 
-    mpz_t my_key_gmp;
-    mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
+void
+GUChord::SendFingerBootstrapReq(uint32_t first, uint32_t last, Ipv4Address via, uint8_t viaVnode)
+{
+    FingerBootstrapRun &run = m_fingerBootstrapPending[first];
+    if (run.attempts > 0)
+        m_pingDeadlines.Remove (run.transactionId);
+    run.last = last;
+    run.transactionId = GetNextTransactionId ();
+    run.attempts++;
+    m_pingDeadlines.Insert (run.transactionId, Simulator::Now () + m_pingTimeout);
+    m_fingerBootstrapLookups++;
 
-    mpz_t mod_value;
-    mpz_init_set_ui(mod_value, 0);
-    mpz_ui_pow_ui(mod_value, 2, 160);
+    Ptr<Packet> packet = Create<Packet> ();
+    GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::FIND_SUCCESSOR_REQ, run.transactionId);
 
-    //for (unsigned int i = 1; i <= 160; i++)
-    //{
+    guChordMessage.SetFindSuccessorReq (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), m_currentVirtualNode, finger_table[first].start_value, first);
+    guChordMessage.SetVirtualNode (viaVnode);
+    packet->AddHeader (guChordMessage);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (via, m_appPort));
+}
 
-        mpz_t add_value;
-        mpz_init(add_value);
-        mpz_ui_pow_ui(add_value, 2, i-1);
+void
+GUChord::FingerBootstrapDone()
+{
+    m_fingerBootstrapping = false;
+    m_joinRoutedTime = Simulator::Now () - m_joinStart;
 
-        mpz_t start_value;
-        mpz_init_set(start_value, add_value); 
+    CHORD_LOG ("\nFingerBootstrap<" << ReverseLookup(GetLocalAddress()) << ">: JoinToRouted: " << m_joinRoutedTime.GetMilliSeconds () << "ms, Lookups: " << m_fingerBootstrapLookups);
+}
 
-        mpz_add(start_value, start_value, my_key_gmp);
-        mpz_mod(start_value, start_value, mod_value);
+// A bootstrap lookup went unanswered. It is resent through the successor
+// up to LookupRetries times; after that its fingers keep their seed and
+// FingerFix, which waits for the bootstrap to end, repairs them.
+void
+GUChord::ExpireFingerBootstrapReq(uint32_t first)
+{
+    FingerBootstrapRun run = m_fingerBootstrapPending[first];
+    if (run.attempts <= m_lookupRetries)
+    {
+        DEBUG_LOG ("FingerBootstrap lookup expired. Index: " << first << " Attempt: " << run.attempts);
+        SendFingerBootstrapReq(first, run.last, successor_ip_address, successor_vnode);
+        return;
+    }
 
-        char* temp = NULL;
-        temp = mpz_get_str(temp, 16, start_value);
-        std::string start_value_string(temp);
+    DEBUG_LOG ("FingerBootstrap lookup failed. Index: " << first << " Last: " << run.last);
+    m_fingerBootstrapPending.erase (first);
 
+    // the one-at-a-time chain stops here, the rest starts at the successor
+    for (uint32_t i = finger_table.size() + 1; i <= 160; i++)
+    {
         FingerTableEntry entry;
-        entry.start_value = start_value_string;
-        
+        entry.start_value = my_node_key.AddPowerOfTwo(i-1);
+        entry.finger_ip_address = successor_ip_address;
+        entry.finger_vnode = successor_vnode;
+        entry.finger_node_id = ReverseLookup(successor_ip_address);
+        entry.finger_key_hash = successor_node_key;
         finger_table.push_back(entry);
+    }
+    UpdateFingerNodes();
 
-        uint32_t transactionId = GetNextTransactionId ();
-        uint32_t index = i - 1;
-
-        //CHORD_LOG ("Sending FIND_SUCCESSOR_REQ to Node: " << ReverseLookup(successor_ip_address) << " IP: " << successor_ip_address << " transactionId: " << transactionId); 
+    if (m_fingerBootstrapping && m_fingerBootstrapPending.empty() && !m_fingerSeedPending)
+        FingerBootstrapDone();
+}
 
-         Ptr<Packet> packet = Create<Packet> ();
-         GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::FIND_SUCCESSOR_REQ, transactionId );
+Time
+GUChord::GetJoinRoutedTime () const
+{
+    return m_joinRoutedTime;
+}
 
-         guChordMessage.SetFindSuccessorReq (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), start_value_string, index );
-         packet->AddHeader (guChordMessage);
-         m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
+Time
+GUChord::GetJoinTime () const
+{
+    return m_joinTime;
+}
 
-} 
+uint32_t
+GUChord::GetJoinHops () const
+{
+    return m_joinHops;
+}
 
 void
 GUChord::ProcessCommand (std::vector<std::string> tokens)
 {
   std::vector<std::string>::iterator iterator = tokens.begin();
   std::string command = *iterator;
+  // commands walk the virtual nodes, leave the selection as it was
+  VirtualNodeScope scope (*this);
 
   Ipv4Address my_ip = GetLocalAddress();
   uint32_t my_id = atoi(ReverseLookup(my_ip).c_str());
@@ -287,59 +800,44 @@ GUChord::ProcessCommand (std::vector<std::string> tokens)
           std::cout << "\n**************************************************************************";
 
           Ipv4Address destAddress = ResolveNodeIpAddress (nodeNumber);
-          uint32_t transactionId = GetNextTransactionId ();
 
           Ipv4Address my_ip = GetLocalAddress();
           uint32_t my_id = atoi(ReverseLookup(my_ip).c_str());
           uint32_t recipient_id = atoi(nodeNumber.c_str());
-          std::string recipient_node_key_hex = ipHash(destAddress);
+          ChordId recipient_node_key = ipHash(destAddress);
 
+          // every virtual node joins on its own through the landmark's first one
+          for (uint32_t v = 0; v < m_virtualNodes.size(); v++) {
 
-          mpz_t recipient_key_gmp;
-          mpz_init_set_str(recipient_key_gmp, recipient_node_key_hex.c_str() , 16);
-  
-          mpz_t my_key_gmp;
-          mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
+          SelectVirtualNode (v);
+          uint32_t transactionId = GetNextTransactionId ();
 
-          if(mpz_cmp(recipient_key_gmp, my_key_gmp) == 0) {
+          if(recipient_node_key == my_node_key) {
 
               successor_id = my_id;
               successor_ip_address = my_ip;
-              successor_node_key_hex = my_node_key_hex;
+              successor_node_key = my_node_key;
+              successor_vnode = m_currentVirtualNode;
               predecessor_id = my_id;
               predecessor_ip_address = my_ip;
-              predecessor_node_key_hex = my_node_key_hex;
-                
-              mpz_t mod_value;
-              mpz_init_set_ui(mod_value, 0);
-              mpz_ui_pow_ui(mod_value, 2, 160);
+              predecessor_node_key = my_node_key;
+              predecessor_vnode = m_currentVirtualNode;
+              ResetSuccessorList();
               
               for (unsigned int i = 1; i <= 160; i++)
               {
 
-                  mpz_t add_value;
-                  mpz_init(add_value);
-                  mpz_ui_pow_ui(add_value, 2, i-1);
-             
-                  mpz_t start_value;
-                  mpz_init_set(start_value, add_value);
-             
-                  mpz_add(start_value, start_value, my_key_gmp);
-                  mpz_mod(start_value, start_value, mod_value);
-             
-                  char* temp = NULL;
-                  temp = mpz_get_str(temp, 16, start_value);
-                  std::string start_value_string(temp);
-
                   FingerTableEntry entry;
-                  entry.start_value = start_value_string;
+                  entry.start_value = my_node_key.AddPowerOfTwo(i-1);
                   entry.finger_node_id = ReverseLookup(GetLocalAddress());
                   entry.finger_ip_address = GetLocalAddress();
-                  entry.finger_key_hash = my_node_key_hex;
+                  entry.finger_vnode = m_currentVirtualNode;
+                  entry.finger_key_hash = my_node_key;
                   //std::cout << "HI HATERZ" << GetLocalAddress() << std::endl;
                   
                   finger_table.push_back(entry);
               }
+              UpdateFingerNodes();
 
                 in_ring = true;
 
@@ -347,16 +845,15 @@ GUChord::ProcessCommand (std::vector<std::string> tokens)
 
           else {
 
-          //CHORD_LOG ("Sending JOIN_REQ to Node: " << ReverseLookup(destAddress) << " IP: " << destAddress << " transactionId: " << transactionId);
-
-          Ptr<Packet> packet = Create<Packet> ();
-          GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::JOIN_REQ, transactionId );
-
-          guChordMessage.SetJoinReq (my_id, my_ip, recipient_id, destAddress);
-          packet->AddHeader (guChordMessage);
-          m_socket->SendTo (packet, 0 , InetSocketAddress (destAddress, m_appPort)); 
+          m_joinStart = Simulator::Now ();
+          m_joinPending = true;
+          m_joinLandmarkId = recipient_id;
+          m_joinLandmark = destAddress;
+          SendJoinReq ();
           
           }
+
+          }
         
     }
   else if (command == "leave" || command == "LEAVE")
@@ -368,14 +865,32 @@ GUChord::ProcessCommand (std::vector<std::string> tokens)
           Ipv4Address my_ip = GetLocalAddress();
           uint32_t my_id = atoi(ReverseLookup(my_ip).c_str());
 
-          in_ring = false;
+          // adjacent virtual nodes of ours leave as one run, only the
+          // outside nodes around each run are told
+          for (uint32_t v = 0; v < m_virtualNodes.size(); v++) {
+
+          SelectVirtualNode (v);
+          if (!in_ring || predecessor_ip_address == my_ip)
+              continue;
+
+          uint32_t run_predecessor_id = predecessor_id;
+          Ipv4Address run_predecessor_ip_address = predecessor_ip_address;
+          uint8_t run_predecessor_vnode = predecessor_vnode;
+          std::vector<uint8_t> run;
+          run.push_back (v);
+          while (successor_ip_address == my_ip && run.size() < m_virtualNodes.size())
+          {
+              SelectVirtualNode (successor_vnode);
+              run.push_back (m_currentVirtualNode);
+          }
 
           //CHORD_LOG ("Sending DEPARTURE_REQ to Node: " << ReverseLookup(successor_ip_address) << " IP: " << successor_ip_address << " transactionId: " << transactionId);
 
           Ptr<Packet> packet = Create<Packet> ();
           GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::DEPARTURE_REQ, transactionId );
 
-          guChordMessage.SetDepartureReq (my_id, my_ip, predecessor_id, predecessor_ip_address);
+          guChordMessage.SetDepartureReq (my_id, my_ip, m_currentVirtualNode, run_predecessor_id, run_predecessor_ip_address, run_predecessor_vnode);
+          guChordMessage.SetVirtualNode (successor_vnode);
           packet->AddHeader (guChordMessage);
           m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
 
@@ -384,11 +899,25 @@ GUChord::ProcessCommand (std::vector<std::string> tokens)
           Ptr<Packet> packet2 = Create<Packet> ();
           GUChordMessage guChordMessage2 = GUChordMessage        (GUChordMessage::DEPARTURE_REQ, transactionId );
 
-          guChordMessage2.SetDepartureReq (my_id, my_ip, successor_id, successor_ip_address);
+          guChordMessage2.SetDepartureReq (my_id, my_ip, v, successor_id, successor_ip_address, successor_vnode);
+          guChordMessage2.SetVirtualNode (run_predecessor_vnode);
           packet2->AddHeader (guChordMessage2);
-          m_socket->SendTo (packet2, 0 , InetSocketAddress (predecessor_ip_address, m_appPort));
-          
-          m_chordLeave (successor_ip_address, successor_id);
+          m_socket->SendTo (packet2, 0 , InetSocketAddress (run_predecessor_ip_address, m_appPort));
+
+          uint32_t run_successor_id = successor_id;
+          Ipv4Address run_successor_ip_address = successor_ip_address;
+          for (uint32_t i = 0; i < run.size(); i++)
+          {
+              SelectVirtualNode (run[i]);
+              m_chordLeave (run_successor_ip_address, run_successor_id);
+          }
+
+          }
+
+          for (uint32_t v = 0; v < m_virtualNodes.size(); v++) {
+              SelectVirtualNode (v);
+              in_ring = false;
+          }
            
           //finger_table.clear();
     }
@@ -409,14 +938,58 @@ for(unsigned int i = 0; i < finger_table.size(); i++) {
 
         }
 
-          CHORD_LOG ("\nRingState<" << my_id << ">: Pred<" << predecessor_id << ", " << predecessor_node_key_hex << ">, Succ<" << successor_id << ", " << successor_node_key_hex << ">");
+          CHORD_LOG ("\nRingState<" << my_id << ">: Pred<" << predecessor_id << ", " << predecessor_node_key << ">, Succ<" << successor_id << ", " << successor_node_key << ">");
 
           //CHORD_LOG ("Sending RING_STATE_PING to Node: " << ReverseLookup(successor_ip_address) << " IP: " << successor_ip_address << " transactionId: " << transactionId);
 
           Ptr<Packet> packet = Create<Packet> ();
           GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::RING_STATE_PING, transactionId );
 
-          guChordMessage.SetRingStatePing (my_id, my_ip);
+          guChordMessage.SetRingStatePing (my_id, my_ip, m_currentVirtualNode);
+          guChordMessage.SetVirtualNode (successor_vnode);
+          packet->AddHeader (guChordMessage);
+          m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
+
+    }
+
+    else if (command == "ringsnapshot" || command == "RINGSNAPSHOT")
+    {
+
+          std::cout << std::endl;
+          std::cout << "\n**************************************************************************";
+
+          Ipv4Address my_ip = GetLocalAddress();
+          uint32_t my_id = atoi(ReverseLookup(my_ip).c_str());
+
+          if (!in_ring)
+            {
+              ERROR_LOG ("Ring snapshot needs this node in the ring");
+              return;
+            }
+
+          // a new snapshot ends the one still running
+          if (m_ringSnapshotPending)
+            FinishRingSnapshot ();
+
+          m_ringSnapshotRun = RingSnapshotRun ();
+          m_ringSnapshotRun.transactionId = GetNextTransactionId ();
+          m_ringSnapshotRun.vnode = m_currentVirtualNode;
+          m_ringSnapshotRun.records[0] = MakeRingRecord ();
+          m_ringSnapshotPending = true;
+          if (successor_ip_address == my_ip && successor_vnode == m_currentVirtualNode)
+            {
+              m_ringSnapshotRun.positions = 1;
+              m_ringSnapshotRun.returned = true;
+              FinishRingSnapshot ();
+              return;
+            }
+          m_pingDeadlines.Insert (m_ringSnapshotRun.transactionId, Simulator::Now () + m_ringSnapshotTimeout);
+
+          Ptr<Packet> packet = Create<Packet> ();
+          GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::RING_SNAPSHOT, m_ringSnapshotRun.transactionId);
+
+          guChordMessage.SetRingSnapshot (my_id, my_ip, m_currentVirtualNode, false, 1);
+          guChordMessage.SetVirtualNode (successor_vnode);
           packet->AddHeader (guChordMessage);
           m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
 
@@ -451,10 +1024,19 @@ for(unsigned int i = 0; i < finger_table.size(); i++) {
         std::cout << "\n**************************************************************************\n";
 
         uint32_t transactionId = GetNextTransactionId ();
-        SendChordLookup(key, transactionId );
+        SendChordLookup(ChordId::FromHex(key), transactionId );
         
       }
 
+    else if (command == "lookupstats" || command == "LOOKUPSTATS") {
+
+        std::cout << std::endl;
+        std::cout << "\n**************************************************************************\n";
+
+        CHORD_LOG ("\nLookupStats<" << my_id << ">: Issued<" << m_lookupsIssued << ">, Succeeded<" << m_lookupsSucceeded << ">, Failed<" << m_lookupsFailed << ">, Retried<" << m_lookupsRetried << ">, Pending<" << m_lookupTransactions.size() << ">");
+
+      }
+
         else
            std::cout << "Invalid Command" << std::endl;
                 
@@ -478,6 +1060,26 @@ GUChord::RunStabilize ()
 
     }
 
+    // one timer for all virtual nodes, each keeps its own period
+    VirtualNodeScope scope (*this);
+    Time next = Simulator::Now () + m_stabilizeMaxInterval;
+    for (uint32_t v = 0; v < m_virtualNodes.size(); v++)
+    {
+        SelectVirtualNode (v);
+        if (m_nextStabilize <= Simulator::Now ())
+            StabilizeVirtualNode ();
+        if (m_nextStabilize < next)
+            next = m_nextStabilize;
+    }
+
+    stabilize_timer.Schedule(next - Simulator::Now ());
+
+}
+
+void
+GUChord::StabilizeVirtualNode ()
+{
+
     // send stabilize to your successor
     if (in_ring == true)
     {
@@ -486,7 +1088,8 @@ GUChord::RunStabilize ()
        uint32_t my_id = atoi(ReverseLookup(my_ip).c_str());
        uint32_t transactionId = GetNextTransactionId ();
        GUChordMessage resp = GUChordMessage (GUChordMessage::STABILIZE_REQ, transactionId);
-       resp.SetStabilizeReq (my_id, my_ip);
+       resp.SetStabilizeReq (my_id, my_ip, m_currentVirtualNode);
+       resp.SetVirtualNode (successor_vnode);
 
        if (show_next_stabilize == true) {
 
@@ -498,17 +1101,99 @@ GUChord::RunStabilize ()
        packet->AddHeader (resp);
        m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
 
+       // a missing STABILIZE_RSP marks the successor as failed
+       Ptr<PingRequest> stabilizeRequest = Create<PingRequest> (transactionId, Simulator::Now(), successor_ip_address, "STABILIZE");
+       m_stabilizeTracker.insert (std::make_pair (transactionId, stabilizeRequest));
+       m_pingDeadlines.Insert (transactionId, stabilizeRequest->GetTimestamp () + m_pingTimeout);
+
        finger_table[0].finger_ip_address = successor_ip_address;
-       finger_table[0].finger_node_id = successor_id;
-       finger_table[0].finger_key_hash = successor_node_key_hex;
+       finger_table[0].finger_vnode = successor_vnode;
+       finger_table[0].finger_node_id = ReverseLookup(successor_ip_address);
+       finger_table[0].finger_key_hash = successor_node_key;
+       UpdateFingerNodes();
+
+       // successor never sent its fingers, bootstrap from the successor alone
+       if (m_fingerSeedPending)
+         FingerBootstrapLookups();
 
-       FingerFix(2);
+       FingerFix();
+
+     }
 
+     // double the period while successor and predecessor stay put
+     if (in_ring && !m_fingerBootstrapping &&
+         successor_node_key == m_lastStabilizeSuccessor && predecessor_node_key == m_lastStabilizePredecessor)
+     {
+         stabilize_timeout = MilliSeconds (std::min (2 * stabilize_timeout.GetMilliSeconds (), m_stabilizeMaxInterval.GetMilliSeconds ()));
      }
-     
+     else
+     {
+         stabilize_timeout = m_stabilizeMinInterval;
+     }
+     m_lastStabilizeSuccessor = successor_node_key;
+     m_lastStabilizePredecessor = predecessor_node_key;
+
+     m_nextStabilize = Simulator::Now () + stabilize_timeout;
+
+}
+
+// Called whenever our neighbours change; stabilize fast again right away
+void
+GUChord::StabilizeChurn ()
+{
+    // fingers may have moved too, stop trusting the stable ones
+    for (uint32_t i = 0; i < finger_table.size(); i++)
+        finger_table[i].stable_rounds = 0;
+
+    // ownership moved somewhere near us, cached ranges may be stale
+    LookupCacheClear();
+
+    stabilize_timeout = m_stabilizeMinInterval;
+    if (m_nextStabilize > Simulator::Now () + stabilize_timeout)
+        m_nextStabilize = Simulator::Now () + stabilize_timeout;
+    if (stabilize_timer.IsRunning () && stabilize_timer.GetDelayLeft ().GetMilliSeconds () > m_stabilizeMinInterval.GetMilliSeconds ())
+    {
+        stabilize_timer.Cancel ();
+        stabilize_timer.Schedule (stabilize_timeout);
+    }
+}
+
+// A neighbour that backed off only notices churn next to it on its next
+// stabilize, up to StabilizeMaxInterval away; this brings that forward
+void
+GUChord::SendStabilizeNotify (Ipv4Address destAddress, uint8_t vnode)
+{
+    if (destAddress == Ipv4Address () || (destAddress == GetLocalAddress () && vnode == m_currentVirtualNode))
+        return;
+
+    Ptr<Packet> packet = Create<Packet> ();
+    GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::STABILIZE_NOTIFY, GetNextTransactionId ());
+    guChordMessage.SetStabilizeNotify (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), m_currentVirtualNode);
+    guChordMessage.SetVirtualNode (vnode);
+    packet->AddHeader (guChordMessage);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (destAddress, m_appPort));
+}
 
-     stabilize_timer.Schedule(stabilize_timeout);
+void
+GUChord::ProcessStabilizeNotify (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+    DEBUG_LOG ("Received STABILIZE_NOTIFY, From Node: " << ReverseLookup (sourceAddress));
+    if (in_ring)
+        StabilizeChurn ();
+}
 
+void
+GUChord::SendProximityPing (Ipv4Address destAddress)
+{
+  uint32_t transactionId = GetNextTransactionId ();
+  Ptr<PingRequest> pingRequest = Create<PingRequest> (transactionId, Simulator::Now(), destAddress, PROXIMITY_PING_MESSAGE);
+  m_proximityPingTracker.insert (std::make_pair (transactionId, pingRequest));
+  m_pingDeadlines.Insert (transactionId, pingRequest->GetTimestamp () + m_pingTimeout);
+  Ptr<Packet> packet = Create<Packet> ();
+  GUChordMessage message = GUChordMessage (GUChordMessage::PING_REQ, transactionId);
+  message.SetPingReq (PROXIMITY_PING_MESSAGE);
+  packet->AddHeader (message);
+  m_socket->SendTo (packet, 0 , InetSocketAddress (destAddress, m_appPort));
 }
 
 void
@@ -521,6 +1206,7 @@ GUChord::SendPing (Ipv4Address destAddress, std::string pingMessage)
       Ptr<PingRequest> pingRequest = Create<PingRequest> (transactionId, Simulator::Now(), destAddress, pingMessage);
       // Add to ping-tracker
       m_pingTracker.insert (std::make_pair (transactionId, pingRequest));
+      m_pingDeadlines.Insert (transactionId, pingRequest->GetTimestamp () + m_pingTimeout);
       Ptr<Packet> packet = Create<Packet> ();
       GUChordMessage message = GUChordMessage (GUChordMessage::PING_REQ, transactionId);
       message.SetPingReq (pingMessage);
@@ -545,6 +1231,15 @@ GUChord::RecvMessage (Ptr<Socket> socket)
   GUChordMessage message;
   packet->RemoveHeader (message);
 
+  if (message.GetVirtualNode () >= m_virtualNodes.size ())
+    {
+      ERROR_LOG ("Message for unknown virtual node " << (uint32_t) message.GetVirtualNode () << " from Node: " << ReverseLookup (sourceAddress));
+      return;
+    }
+  // handlers below see the addressed virtual node's ring state
+  VirtualNodeScope scope (*this);
+  SelectVirtualNode (message.GetVirtualNode ());
+
   switch (message.GetMessageType ())
     {
       case GUChordMessage::PING_REQ:
@@ -568,9 +1263,18 @@ GUChord::RecvMessage (Ptr<Socket> socket)
       case GUChordMessage::STABILIZE_RSP:
         ProcessStabilizeRsp (message, sourceAddress, sourcePort);
         break;
+      case GUChordMessage::STABILIZE_NOTIFY:
+        ProcessStabilizeNotify (message, sourceAddress, sourcePort);
+        break;
       case GUChordMessage::RING_STATE_PING:
         ProcessRingStatePing (message, sourceAddress, sourcePort);
         break;
+      case GUChordMessage::RING_SNAPSHOT:
+        ProcessRingSnapshot (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::RING_SNAPSHOT_RECORD:
+        ProcessRingSnapshotRecord (message, sourceAddress, sourcePort);
+        break;
       case GUChordMessage::FIND_SUCCESSOR_REQ:
         ProcessFindSuccessorReq (message, sourceAddress, sourcePort);
         break;
@@ -583,6 +1287,24 @@ GUChord::RecvMessage (Ptr<Socket> socket)
       case GUChordMessage::LOOKUP_RSP:
         ProcessLookupRsp(message, sourceAddress, sourcePort);
         break;
+      case GUChordMessage::FINGER_TABLE_REQ:
+        ProcessFingerTableReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::FINGER_TABLE_RSP:
+        ProcessFingerTableRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::ITERATIVE_LOOKUP_REQ:
+        ProcessIterativeLookupReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::ITERATIVE_LOOKUP_RSP:
+        ProcessIterativeLookupRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::LOOKUP_BATCH_REQ:
+        ProcessLookupBatchReq (message, sourceAddress, sourcePort);
+        break;
+      case GUChordMessage::LOOKUP_BATCH_RSP:
+        ProcessLookupBatchRsp (message, sourceAddress, sourcePort);
+        break;
       default:
         ERROR_LOG ("Unknown Message Type!");
         break;
@@ -602,6 +1324,8 @@ GUChord::ProcessPingReq (GUChordMessage message, Ipv4Address sourceAddress, uint
     Ptr<Packet> packet = Create<Packet> ();
     packet->AddHeader (resp);
     m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
+    if (message.GetPingReq().pingMessage == PROXIMITY_PING_MESSAGE)
+      return;
     // Send indication to application layer okay
     m_pingRecvFn (sourceAddress, message.GetPingReq().pingMessage);
 }
@@ -609,14 +1333,31 @@ GUChord::ProcessPingReq (GUChordMessage message, Ipv4Address sourceAddress, uint
 void
 GUChord::ProcessPingRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
-  // Remove from pingTracker
   std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  iter = m_pingTracker.find (message.GetTransactionId ());
-  if (iter != m_pingTracker.end ())
+  iter = m_proximityPingTracker.find (message.GetTransactionId ());
+  if (iter != m_proximityPingTracker.end ())
     {
-      std::string fromNode = ReverseLookup (sourceAddress);
-      CHORD_LOG ("Received PING_RSP, From Node: " << fromNode << ", Message: " << message.GetPingRsp().pingMessage);
+      Time rtt = Simulator::Now () - iter->second->GetTimestamp ();
+      m_proximityPingTracker.erase (iter);
+      m_pingDeadlines.Remove (message.GetTransactionId ());
+      m_nodeRtt[sourceAddress] = rtt;
+      DEBUG_LOG ("Proximity RTT to Node: " << ReverseLookup (sourceAddress) << " is " << rtt.GetMilliSeconds () << "ms");
+      VirtualNodeScope scope (*this);
+      for (uint32_t v = 0; v < m_virtualNodes.size (); v++)
+        {
+          SelectVirtualNode (v);
+          UpdateFingerNodes ();
+        }
+      return;
+    }
+  // Remove from pingTracker
+  iter = m_pingTracker.find (message.GetTransactionId ());
+  if (iter != m_pingTracker.end ())
+    {
+      std::string fromNode = ReverseLookup (sourceAddress);
+      CHORD_LOG ("Received PING_RSP, From Node: " << fromNode << ", Message: " << message.GetPingRsp().pingMessage);
       m_pingTracker.erase (iter);
+      m_pingDeadlines.Remove (message.GetTransactionId ());
       // Send indication to application layer
       m_pingSuccessFn (sourceAddress, message.GetPingRsp().pingMessage);
     }
@@ -633,99 +1374,84 @@ GUChord::ProcessJoinReq (GUChordMessage message, Ipv4Address sourceAddress, uint
     std::string fromNode = ReverseLookup (sourceAddress);
     //CHORD_LOG ("Received JOIN_REQ, From Node: " << fromNode);
 
-    std::string request_node_key_hex = ipHash(message.GetJoinReq().request_ip_address);
-
-    mpz_t request_key_gmp;
-    mpz_init_set_str(request_key_gmp, request_node_key_hex.c_str() , 16);
-  
-    mpz_t my_key_gmp;
-    mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
+    ChordId request_node_key = NodeKey(message.GetJoinReq().request_ip_address, message.GetJoinReq().request_vnode);
 
-    mpz_t successor_key_gmp;
-    mpz_init_set_str(successor_key_gmp, successor_node_key_hex.c_str() , 16);
-
-    // request hash is greater than my hash but less than my successor's hash - obvious case
+    // a node that is joining itself has no arc to hand out, the requester
+    // sends again after JoinTimeout
+    if (!in_ring)
+    {
+        DEBUG_LOG ("Dropping JOIN_REQ from Node: " << ReverseLookup(message.GetJoinReq().request_ip_address) << ", not in the ring yet");
+        return;
+    }
 
-    if (mpz_cmp(my_key_gmp, request_key_gmp) < 0 && mpz_cmp(request_key_gmp, successor_key_gmp) < 0)
-    {     
+    // the requester lands between us and our successor (or we are alone);
+    // concurrent joiners into the same arc all get our successor and are
+    // put in order by stabilize
+    if (request_node_key != successor_node_key && ChordId::IsSuccessor(my_node_key, request_node_key, successor_node_key))
+    {
 
         uint32_t transactionId = GetNextTransactionId ();
 
-        //CHORD_LOG ("Sending JOIN_RSP to Node: " << ReverseLookup(successor_ip_address) << " IP: " << successor_ip_address << " transactionId: " << transactionId);
+        //CHORD_LOG ("Sending JOIN_RSP to Node: " << ReverseLookup(message.GetJoinReq().request_ip_address) << " IP: " << message.GetJoinReq().request_ip_address << " transactionId: " << transactionId);
 
         message.SetTransactionId(transactionId); 
   
         SendJoinRsp(message, sourcePort);
 
     }
-    // my hash is greater than my successor's hash AND request hash is greater my hash
-    // --> adding the biggest hash to the ring
-    else if (mpz_cmp(my_key_gmp, successor_key_gmp) > 0 && mpz_cmp(request_key_gmp, my_key_gmp) > 0)
-    {
-
-        uint32_t transactionId = GetNextTransactionId ();
-
-        //CHORD_LOG ("Sending JOIN_RSP to Node: " << ReverseLookup(successor_ip_address) << " IP: " << successor_ip_address << " transactionId: " << transactionId);
-
-        message.SetTransactionId(transactionId);       
-
-        SendJoinRsp(message, sourcePort);
-    }
-    // my hash is greater than my successor's hash AND request hash is less than successor's hash
-    // --> adding the smallest hash to the ring
-    else if (mpz_cmp(my_key_gmp, successor_key_gmp) > 0 && mpz_cmp(request_key_gmp, successor_key_gmp) < 0)
+    else
     {
+        // need to keep searching, route it like a lookup for the
+        // requester's key through the closest preceding finger
 
         uint32_t transactionId = GetNextTransactionId ();
 
-        //CHORD_LOG ("Sending JOIN_RSP to Node: " << ReverseLookup(successor_ip_address) << " IP: " << successor_ip_address << " transactionId: " << transactionId);
-
-        message.SetTransactionId(transactionId);       
-
-        SendJoinRsp(message, sourcePort);
-    }
-    // only one node in the ring - obvious
-    else if (mpz_cmp(successor_key_gmp, my_key_gmp) == 0)
-    {
-
-        uint32_t transactionId = GetNextTransactionId ();
+        int32_t finger = ClosestPrecedingFinger (request_node_key);
+        RingNode nextHop = finger < 0 ? RingNode (successor_ip_address, successor_vnode) : RingNode (m_fingerNodes[finger].ip_address, m_fingerNodes[finger].vnode);
 
-        //CHORD_LOG ("Sending JOIN_RSP to Node: " << ReverseLookup(sourceAddress) << " IP: " << sourceAddress << " transactionId: " << transactionId);
+        //CHORD_LOG ("Sending JOIN_REQ to Node: " << ReverseLookup(nextHop.ip_address) << " IP: " << nextHop.ip_address << " transactionId: " << transactionId);
 
-        GUChordMessage resp = GUChordMessage (GUChordMessage::JOIN_RSP, transactionId);
-        resp.SetJoinRsp (message.GetJoinReq(), successor_id, successor_ip_address);
+        GUChordMessage::JoinReq joinReq = message.GetJoinReq();
+        joinReq.hops++;
+        GUChordMessage resp = GUChordMessage (GUChordMessage::JOIN_REQ, transactionId);
+        resp.SetJoinReq (joinReq);
+        resp.SetVirtualNode (nextHop.vnode);
         Ptr<Packet> packet = Create<Packet> ();
         packet->AddHeader (resp);
-        m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
-
+        m_socket->SendTo (packet, 0 , InetSocketAddress (nextHop.ip_address, sourcePort));
     }
 
-    else
-    {
-        // need to keep searching so forward the message along
+}
 
-        uint32_t transactionId = GetNextTransactionId ();
+void
+GUChord::SendJoinReq()
+{
 
-        //CHORD_LOG ("Sending JOIN_REQ to Node: " << ReverseLookup(successor_ip_address) << " IP: " << successor_ip_address << " transactionId: " << transactionId);
+    uint32_t transactionId = GetNextTransactionId ();
 
-        GUChordMessage resp = GUChordMessage (GUChordMessage::JOIN_REQ, transactionId);
-        resp.SetJoinReq (message.GetJoinReq());
-        Ptr<Packet> packet = Create<Packet> ();
-        packet->AddHeader (resp);
-        m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, sourcePort));
-    }
+    //CHORD_LOG ("Sending JOIN_REQ to Node: " << ReverseLookup(m_joinLandmark) << " IP: " << m_joinLandmark << " transactionId: " << transactionId);
+
+    Ptr<Packet> packet = Create<Packet> ();
+    GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::JOIN_REQ, transactionId );
+
+    guChordMessage.SetJoinReq (atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), m_currentVirtualNode, m_joinLandmarkId, m_joinLandmark);
+    packet->AddHeader (guChordMessage);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (m_joinLandmark, m_appPort));
+    m_joinSent = Simulator::Now ();
 
 }
 
+// The node whose arc the requester falls into answers it directly
 void
 GUChord::SendJoinRsp(GUChordMessage message, uint16_t sourcePort)
 {
 
     GUChordMessage resp = GUChordMessage (GUChordMessage::JOIN_RSP, message.GetTransactionId());
-    resp.SetJoinRsp (message.GetJoinReq(), successor_id, successor_ip_address);
+    resp.SetJoinRsp (message.GetJoinReq(), successor_id, successor_ip_address, successor_vnode);
+    resp.SetVirtualNode (message.GetJoinReq().request_vnode);
     Ptr<Packet> packet = Create<Packet> ();
     packet->AddHeader (resp);
-    m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, sourcePort));
+    m_socket->SendTo (packet, 0 , InetSocketAddress (message.GetJoinReq().request_ip_address, sourcePort));
 
 }
 
@@ -736,59 +1462,37 @@ GUChord::ProcessJoinRsp (GUChordMessage message, Ipv4Address sourceAddress, uint
     std::string fromNode = ReverseLookup (sourceAddress);
     //CHORD_LOG ("Received JOIN_RSP, From Node: " << fromNode);    
 
-    std::string landmark_node_key_hex = ipHash(message.GetJoinRsp().landmark_ip_address);
-    std::string request_node_key_hex = ipHash(message.GetJoinRsp().request_ip_address);
-
-    mpz_t request_key_gmp;
-    mpz_init_set_str(request_key_gmp, request_node_key_hex.c_str() , 16);
-  
-    mpz_t my_key_gmp;
-    mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
-
-    mpz_t landmark_key_gmp;
-    mpz_init_set_str(landmark_key_gmp, landmark_node_key_hex.c_str() , 16);
+    ChordId request_node_key = NodeKey(message.GetJoinRsp().request_ip_address, message.GetJoinRsp().request_vnode);
 
-    
-    // if you are the landmark node, then send this information to the   request node
-    if (mpz_cmp(my_key_gmp, landmark_key_gmp) == 0)
+    if (my_node_key != request_node_key)
     {
-
-        uint32_t transactionId = GetNextTransactionId ();
-
-        //CHORD_LOG ("Sending JOIN_RSP to Node: " << ReverseLookup(message.GetJoinRsp().request_ip_address) << " IP: " << message.GetJoinRsp().request_ip_address << " transactionId: " << transactionId);        
-
-        GUChordMessage resp = GUChordMessage (GUChordMessage::JOIN_RSP, transactionId);
-        resp.SetJoinRsp (message.GetJoinRsp());
-        Ptr<Packet> packet = Create<Packet> ();
-        packet->AddHeader (resp);
-        m_socket->SendTo (packet, 0 , InetSocketAddress (message.GetJoinRsp().request_ip_address, sourcePort));
+        ERROR_LOG ("JOIN_RSP for Node: " << ReverseLookup(message.GetJoinRsp().request_ip_address) << " received by Node: " << ReverseLookup(GetLocalAddress()));
+        return;
     }
 
-    // if you are the original requester
-    else if (mpz_cmp(my_key_gmp, request_key_gmp) == 0)
-    { 
-
-        successor_ip_address = message.GetJoinRsp().successor_ip_address;
-        successor_id = message.GetJoinRsp().successor_id;
-        successor_node_key_hex = ipHash(message.GetJoinRsp().successor_ip_address);
-
-        FingerInit(1);
-
-        in_ring = true;
-    }
+    // a resent JOIN_REQ can be answered twice, the first answer wins
+    if (in_ring || !m_joinPending)
+        return;
+
+    m_joinPending = false;
+    m_joinHops = message.GetJoinRsp().hops;
+    m_joinTime = Simulator::Now () - m_joinStart;
+    CHORD_LOG ("\nJoin<" << ReverseLookup(GetLocalAddress()) << ">: Hops: " << m_joinHops << ", JoinTime: " << m_joinTime.GetMilliSeconds () << "ms");
+
+    successor_ip_address = message.GetJoinRsp().successor_ip_address;
+    successor_id = message.GetJoinRsp().successor_id;
+    successor_vnode = message.GetJoinRsp().successor_vnode;
+    successor_node_key = NodeKey(message.GetJoinRsp().successor_ip_address, successor_vnode);
+    ResetSuccessorList();
+    StabilizeChurn();
+
+    m_fingerBootstrapping = true;
+    if (m_parallelFingerInit)
+      FingerBootstrap();
     else
-    {
+      FingerInit(1);
 
-        uint32_t transactionId = GetNextTransactionId ();
-
-        //CHORD_LOG ("Sending JOIN_RSP to Node: " << ReverseLookup(successor_ip_address) << " IP: " << successor_ip_address << " transactionId: " << transactionId);        
-
-        GUChordMessage resp = GUChordMessage (GUChordMessage::JOIN_RSP, transactionId);
-        resp.SetJoinRsp (message.GetJoinRsp());
-        Ptr<Packet> packet = Create<Packet> ();
-        packet->AddHeader (resp);
-        m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, sourcePort));
-    }
+    in_ring = true;
 
 }
 
@@ -799,35 +1503,31 @@ GUChord::ProcessDepartureReq (GUChordMessage message, Ipv4Address sourceAddress,
         std::string fromNode = ReverseLookup (sourceAddress);
         //CHORD_LOG ("Received DEPARTURE_REQ, From Node: " << fromNode);
 
-        std::string sender_node_key_hex = ipHash(message.GetDepartureReq().sender_node_ip_address);
-
-        mpz_t sender_key_gmp;
-        mpz_init_set_str(sender_key_gmp, sender_node_key_hex.c_str() , 16);
-  
-        mpz_t my_key_gmp;
-        mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
+        ChordId sender_node_key = NodeKey(message.GetDepartureReq().sender_node_ip_address, message.GetDepartureReq().sender_vnode);
 
-        mpz_t predecessor_key_gmp;
-        mpz_init_set_str(predecessor_key_gmp, predecessor_node_key_hex.c_str() , 16);
-
-        mpz_t successor_key_gmp;        
-        mpz_init_set_str(successor_key_gmp, successor_node_key_hex.c_str() , 16);
-
-        if(mpz_cmp(predecessor_key_gmp, sender_key_gmp) == 0) {
+        if(predecessor_node_key == sender_node_key) {
 
           predecessor_id = message.GetDepartureReq ().conn_node_id;
           predecessor_ip_address = message.GetDepartureReq ().conn_node_ip_address;
-          predecessor_node_key_hex = ipHash(message.GetDepartureReq ().conn_node_ip_address);
+          predecessor_vnode = message.GetDepartureReq ().conn_vnode;
+          predecessor_node_key = NodeKey(predecessor_ip_address, predecessor_vnode);
+          // the new predecessor has not stabilized with us yet; without this
+          // AuditPings would expire it on the departed node's last contact
+          m_predecessorLastSeen = Simulator::Now ();
 
-          m_predChange (predecessor_ip_address, predecessor_node_key_hex);
+          m_predChange (predecessor_ip_address, predecessor_node_key.ToHex());
+          StabilizeChurn();
 
         }
 
-        else if (mpz_cmp(successor_key_gmp, sender_key_gmp) == 0) {
+        else if (successor_node_key == sender_node_key) {
 
           successor_id = message.GetDepartureReq ().conn_node_id;
           successor_ip_address = message.GetDepartureReq ().conn_node_ip_address;
-          successor_node_key_hex = ipHash(message.GetDepartureReq ().conn_node_ip_address); 
+          successor_vnode = message.GetDepartureReq ().conn_vnode;
+          successor_node_key = NodeKey(successor_ip_address, successor_vnode);
+          ResetSuccessorList();
+          StabilizeChurn();
 
         }
 
@@ -845,57 +1545,53 @@ GUChord::ProcessStabilizeReq (GUChordMessage message, Ipv4Address sourceAddress,
     
     }
 
-    std::string sender_node_key_hex = ipHash(message.GetStabilizeReq().sender_node_ip_address);
-
-    mpz_t sender_key_gmp;
-    mpz_init_set_str(sender_key_gmp, sender_node_key_hex.c_str() , 16);
-  
-    mpz_t my_key_gmp;
-    mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
-
-    mpz_t predecessor_key_gmp;
-    mpz_init_set_str(predecessor_key_gmp, predecessor_node_key_hex.c_str() , 16);
-
-    mpz_t successor_key_gmp;        
-    mpz_init_set_str(successor_key_gmp, successor_node_key_hex.c_str() , 16);
+    ChordId sender_node_key = NodeKey(message.GetStabilizeReq().sender_node_ip_address, message.GetStabilizeReq().sender_vnode);
+    ChordId old_predecessor = predecessor_node_key;
+    RingNode old_predecessor_node (predecessor_ip_address, predecessor_vnode);
 
     // obvious case
-    if (mpz_cmp(sender_key_gmp, my_key_gmp) < 0 && mpz_cmp(sender_key_gmp, predecessor_key_gmp) > 0)
+    if (sender_node_key < my_node_key && sender_node_key > predecessor_node_key)
     {
         predecessor_id = sender_id;
         predecessor_ip_address = message.GetStabilizeReq().sender_node_ip_address;
-        predecessor_node_key_hex = ipHash(message.GetStabilizeReq().sender_node_ip_address);
-       // m_predChange (predecessor_ip_address, predecessor_node_key_hex);
+        predecessor_node_key = sender_node_key;
+        predecessor_vnode = message.GetStabilizeReq().sender_vnode;
+       // m_predChange (predecessor_ip_address, predecessor_node_key.ToHex());
     }
     // only one node in the network case
-    else if (mpz_cmp(my_key_gmp, predecessor_key_gmp) == 0)
+    else if (my_node_key == predecessor_node_key)
     {
         predecessor_id = sender_id;
         predecessor_ip_address = message.GetStabilizeReq().sender_node_ip_address;
-        predecessor_node_key_hex = ipHash(message.GetStabilizeReq().sender_node_ip_address);
-        //m_predChange (predecessor_ip_address, predecessor_node_key_hex);
+        predecessor_node_key = sender_node_key;
+        predecessor_vnode = message.GetStabilizeReq().sender_vnode;
+        //m_predChange (predecessor_ip_address, predecessor_node_key.ToHex());
     }
 
-    else if (mpz_cmp(my_key_gmp, predecessor_key_gmp) < 0 && mpz_cmp(sender_key_gmp, predecessor_key_gmp) > 0 )
+    else if (my_node_key < predecessor_node_key && sender_node_key > predecessor_node_key)
     {
         predecessor_id = sender_id;
         predecessor_ip_address = message.GetStabilizeReq().sender_node_ip_address;
-        predecessor_node_key_hex = ipHash(message.GetStabilizeReq().sender_node_ip_address);
-        //m_predChange (predecessor_ip_address, predecessor_node_key_hex);
+        predecessor_node_key = sender_node_key;
+        predecessor_vnode = message.GetStabilizeReq().sender_vnode;
+        //m_predChange (predecessor_ip_address, predecessor_node_key.ToHex());
     }
-    else if (mpz_cmp(my_key_gmp, predecessor_key_gmp) < 0 && mpz_cmp(sender_key_gmp, my_key_gmp) < 0)
+    else if (my_node_key < predecessor_node_key && sender_node_key < my_node_key)
     {
         predecessor_id = sender_id;
         predecessor_ip_address = message.GetStabilizeReq().sender_node_ip_address;
-        predecessor_node_key_hex = ipHash(message.GetStabilizeReq().sender_node_ip_address);
-        //m_predChange (predecessor_ip_address, predecessor_node_key_hex);
+        predecessor_node_key = sender_node_key;
+        predecessor_vnode = message.GetStabilizeReq().sender_vnode;
+        //m_predChange (predecessor_ip_address, predecessor_node_key.ToHex());
     }
-    else if (predecessor_node_key_hex.compare(" ") == -1)
+    // no predecessor yet (freshly joined node)
+    else if (predecessor_node_key == ChordId ())
     { 
         predecessor_id = sender_id;
         predecessor_ip_address = message.GetStabilizeReq().sender_node_ip_address;
-        predecessor_node_key_hex = ipHash(message.GetStabilizeReq().sender_node_ip_address);
-        //m_predChange (predecessor_ip_address, predecessor_node_key_hex);
+        predecessor_node_key = sender_node_key;
+        predecessor_vnode = message.GetStabilizeReq().sender_vnode;
+        //m_predChange (predecessor_ip_address, predecessor_node_key.ToHex());
     }
 
     if (show_next_stabilize == true) {
@@ -906,7 +1602,27 @@ GUChord::ProcessStabilizeReq (GUChordMessage message, Ipv4Address sourceAddress,
     }
 
     GUChordMessage resp = GUChordMessage (GUChordMessage::STABILIZE_RSP, message.GetTransactionId());
-    resp.SetStabilizeRsp (predecessor_id, predecessor_ip_address);
+    if (predecessor_node_key != old_predecessor)
+    {
+        StabilizeChurn ();
+        // a node joined between us and the old predecessor, which still
+        // has us as successor until it stabilizes again
+        if (old_predecessor != ChordId () && old_predecessor != my_node_key)
+            SendStabilizeNotify (old_predecessor_node.ip_address, old_predecessor_node.vnode);
+    }
+
+    if (predecessor_node_key == sender_node_key)
+        m_predecessorLastSeen = Simulator::Now ();
+
+    std::vector<Ipv4Address> successors;
+    std::vector<uint8_t> successor_vnodes;
+    for (uint32_t i = 0; i < successor_list.size(); i++)
+    {
+        successors.push_back(successor_list[i].ip_address);
+        successor_vnodes.push_back(successor_list[i].vnode);
+    }
+    resp.SetStabilizeRsp (predecessor_id, predecessor_ip_address, predecessor_vnode, successors, successor_vnodes);
+    resp.SetVirtualNode (message.GetStabilizeReq().sender_vnode);
     Ptr<Packet> packet = Create<Packet> ();
     packet->AddHeader (resp);
     m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
@@ -926,22 +1642,58 @@ GUChord::ProcessStabilizeRsp (GUChordMessage message, Ipv4Address sourceAddress,
     
     }
 
-    std::string pred_node_key_hex = ipHash(message.GetStabilizeRsp().predecessor_node_ip_address);
+    m_stabilizeTracker.erase (message.GetTransactionId ());
+    m_pingDeadlines.Remove (message.GetTransactionId ());
 
-    mpz_t my_key_gmp;
-    mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
+    // replies from an old successor say nothing about the current one
+    if (sourceAddress != successor_ip_address)
+        return;
+    uint8_t source_vnode = successor_vnode;
 
-    mpz_t predecessor_key_gmp;
-    mpz_init_set_str(predecessor_key_gmp, pred_node_key_hex.c_str() , 16);
+    Ipv4Address pred_ip_address = message.GetStabilizeRsp().predecessor_node_ip_address;
+    uint8_t pred_vnode = message.GetStabilizeRsp().predecessor_vnode;
+    ChordId pred_node_key = NodeKey(pred_ip_address, pred_vnode);
+    bool adopted = false;
 
-    if (mpz_cmp(predecessor_key_gmp, my_key_gmp) != 0 ) {
+    // adopt the successor's predecessor only if it sits between us
+    if (pred_ip_address != Ipv4Address () && pred_node_key != my_node_key &&
+        (successor_node_key == my_node_key || ChordId::IsInBetween(my_node_key, pred_node_key, successor_node_key))) {
 
         successor_id = message.GetStabilizeRsp().predecessor_node_id;
-        successor_ip_address = message.GetStabilizeRsp().predecessor_node_ip_address;
-        successor_node_key_hex = pred_node_key_hex;
+        successor_ip_address = pred_ip_address;
+        successor_node_key = pred_node_key;
+        successor_vnode = pred_vnode;
+        adopted = true;
 
     }
-    
+
+    // our successor list is the successor followed by its own list
+    std::vector<RingNode> candidates;
+    candidates.push_back(RingNode(sourceAddress, source_vnode));
+    std::vector<Ipv4Address> remote = message.GetStabilizeRsp().successor_list;
+    std::vector<uint8_t> remote_vnodes = message.GetStabilizeRsp().successor_vnodes;
+    for (uint32_t i = 0; i < remote.size(); i++)
+    {
+        candidates.push_back(RingNode(remote[i], remote_vnodes[i]));
+        AddProximityCandidate(remote[i], remote_vnodes[i]);
+    }
+
+    successor_list.clear();
+    successor_list.push_back(RingNode(successor_ip_address, successor_vnode));
+    for (uint32_t i = 0; i < candidates.size() && successor_list.size() < m_successorListSize; i++)
+    {
+        if (candidates[i] == RingNode(GetLocalAddress(), m_currentVirtualNode) ||
+            std::find(successor_list.begin(), successor_list.end(), candidates[i]) != successor_list.end())
+            continue;
+        successor_list.push_back(candidates[i]);
+    }
+
+    if (adopted)
+    {
+        CHORD_LOG ("\nSuccessorChange<" << ReverseLookup(GetLocalAddress()) << ">: Succ<" << successor_id << ", " << successor_node_key << ">");
+        StabilizeChurn ();
+    }
+
 }
 
 void
@@ -955,22 +1707,17 @@ GUChord::ProcessRingStatePing (GUChordMessage message, Ipv4Address sourceAddress
         uint32_t my_id = atoi(ReverseLookup(my_ip).c_str());
         uint32_t transactionId = GetNextTransactionId ();
 
-        std::string originator_node_key_hex = ipHash(message.GetRingStatePing().originator_node_ip_address);
-
-        mpz_t my_key_gmp;
-        mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
+        ChordId originator_node_key = NodeKey(message.GetRingStatePing().originator_node_ip_address, message.GetRingStatePing().originator_vnode);
 
-        mpz_t originator_key_gmp;
-        mpz_init_set_str(originator_key_gmp, originator_node_key_hex.c_str() , 16);
+        if (my_node_key != originator_node_key) {
 
-        if (mpz_cmp(my_key_gmp, originator_key_gmp) != 0) {
-
-          CHORD_LOG ("\nRingState<" << my_id << ">: Pred<" << predecessor_id << ", " << predecessor_node_key_hex << ">, Succ<" << successor_id << ", " << successor_node_key_hex << ">");
+          CHORD_LOG ("\nRingState<" << my_id << ">: Pred<" << predecessor_id << ", " << predecessor_node_key << ">, Succ<" << successor_id << ", " << successor_node_key << ">");
 
           Ptr<Packet> packet = Create<Packet> ();
           GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::RING_STATE_PING, transactionId );
 
-          guChordMessage.SetRingStatePing (message.GetRingStatePing ().originator_node_id, message.GetRingStatePing ().originator_node_ip_address);
+          guChordMessage.SetRingStatePing (message.GetRingStatePing ().originator_node_id, message.GetRingStatePing ().originator_node_ip_address, message.GetRingStatePing ().originator_vnode);
+          guChordMessage.SetVirtualNode (successor_vnode);
           packet->AddHeader (guChordMessage);
           m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
 
@@ -978,25 +1725,156 @@ GUChord::ProcessRingStatePing (GUChordMessage message, Ipv4Address sourceAddress
 
 }
 
+// Each hop sends its record straight to the originator and passes the
+// snapshot on to its successor, so no message grows with the ring
 void
-GUChord::ProcessFindSuccessorReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+GUChord::ProcessRingSnapshot (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
+    GUChordMessage::RingSnapshot snapshot = message.GetRingSnapshot ();
+    Ipv4Address my_ip = GetLocalAddress();
+    uint32_t my_id = atoi(ReverseLookup(my_ip).c_str());
 
-        std::string fromNode = ReverseLookup (sourceAddress);
-        //CHORD_LOG ("Received FIND_SUCCESSOR_REQ, From Node: " << fromNode);
+    if (my_ip == snapshot.originator_node_ip_address && m_currentVirtualNode == snapshot.originator_vnode)
+      {
+        if (!m_ringSnapshotPending || message.GetTransactionId () != m_ringSnapshotRun.transactionId)
+            return;
+        m_ringSnapshotRun.positions = snapshot.position;
+        m_ringSnapshotRun.returned = true;
+        m_ringSnapshotRun.broken = m_ringSnapshotRun.broken || snapshot.broken;
+        if (m_ringSnapshotRun.records.size () >= m_ringSnapshotRun.positions)
+            FinishRingSnapshot ();
+        return;
+      }
 
-        std::string originator_node_key_hex = ipHash(message.GetFindSuccessorReq().originator_node_ip_address);
+    Ptr<Packet> packet = Create<Packet> ();
+    GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::RING_SNAPSHOT, message.GetTransactionId ());
 
-        mpz_t my_key_gmp;
-        mpz_init_set_str(my_key_gmp, my_node_key_hex.c_str() , 16);
+    // been here before without passing the originator, the ring loops
+    // short of it; tell the originator where it ends
+    std::stringstream seen;
+    seen << snapshot.originator_node_id << "#" << (uint32_t) snapshot.originator_vnode << ":" << message.GetTransactionId () << "@" << (uint32_t) m_currentVirtualNode;
+    bool broken = snapshot.broken || std::find (m_ringSnapshotsSeen.begin (), m_ringSnapshotsSeen.end (), seen.str ()) != m_ringSnapshotsSeen.end ();
 
-        mpz_t lookup_key_gmp;
-        mpz_init_set_str(lookup_key_gmp, message.GetFindSuccessorReq().start_value.c_str() , 16);
+    if (broken || !in_ring)
+      {
+        guChordMessage.SetRingSnapshot (snapshot.originator_node_id, snapshot.originator_node_ip_address, snapshot.originator_vnode, true, snapshot.position);
+        guChordMessage.SetVirtualNode (snapshot.originator_vnode);
+        packet->AddHeader (guChordMessage);
+        m_socket->SendTo (packet, 0 , InetSocketAddress (snapshot.originator_node_ip_address, m_appPort));
+        return;
+      }
 
-        mpz_t successor_key_gmp;
-        mpz_init_set_str(successor_key_gmp, successor_node_key_hex.c_str() , 16);
+    // a loop passes a node once per round, a few snapshots are enough to
+    // remember
+    m_ringSnapshotsSeen.push_back (seen.str ());
+    if (m_ringSnapshotsSeen.size () > 16)
+        m_ringSnapshotsSeen.pop_front ();
+
+    Ptr<Packet> recordPacket = Create<Packet> ();
+    GUChordMessage recordMessage = GUChordMessage (GUChordMessage::RING_SNAPSHOT_RECORD, message.GetTransactionId ());
+    recordMessage.SetRingSnapshotRecord (snapshot.position, MakeRingRecord ());
+    recordMessage.SetVirtualNode (snapshot.originator_vnode);
+    recordPacket->AddHeader (recordMessage);
+    m_socket->SendTo (recordPacket, 0 , InetSocketAddress (snapshot.originator_node_ip_address, m_appPort));
+
+    guChordMessage.SetRingSnapshot (snapshot.originator_node_id, snapshot.originator_node_ip_address, snapshot.originator_vnode, false, snapshot.position + 1);
+    guChordMessage.SetVirtualNode (successor_vnode);
+    packet->AddHeader (guChordMessage);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
+}
+
+void
+GUChord::ProcessRingSnapshotRecord (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+    if (!m_ringSnapshotPending || message.GetTransactionId () != m_ringSnapshotRun.transactionId ||
+        m_currentVirtualNode != m_ringSnapshotRun.vnode)
+        return;
+
+    GUChordMessage::RingSnapshotRecord record = message.GetRingSnapshotRecord ();
+    m_ringSnapshotRun.records[record.position] = record.record;
+    m_pingDeadlines.Insert (m_ringSnapshotRun.transactionId, Simulator::Now () + m_ringSnapshotTimeout);
+    if (m_ringSnapshotRun.returned && m_ringSnapshotRun.records.size () >= m_ringSnapshotRun.positions)
+        FinishRingSnapshot ();
+}
 
-        if(isSuccessor(my_key_gmp, lookup_key_gmp, successor_key_gmp)) {
+GUChordMessage::RingRecord
+GUChord::MakeRingRecord ()
+{
+    GUChordMessage::RingRecord record;
+    record.node_id = atoi(ReverseLookup(GetLocalAddress()).c_str());
+    record.vnode = m_currentVirtualNode;
+    record.node_key = my_node_key;
+    record.predecessor_id = predecessor_id;
+    record.predecessor_vnode = predecessor_vnode;
+    record.successor_id = successor_id;
+    record.successor_vnode = successor_vnode;
+    record.finger_nodes = m_fingerNodes.size();
+    record.stable_fingers = 0;
+    for (uint32_t i = 0; i < finger_table.size(); i++)
+      {
+        if (finger_table[i].stable_rounds > 0)
+          record.stable_fingers++;
+      }
+    record.key_count = m_keyCount.IsNull() ? 0 : m_keyCount();
+    return record;
+}
+
+// Print the snapshot and check every link: each record's successor is the
+// next record, whose predecessor points back, and keys wrap around once.
+// Links to a position whose record never came are not checked.
+void
+GUChord::FinishRingSnapshot ()
+{
+    RingSnapshotRun run = m_ringSnapshotRun;
+    m_ringSnapshotPending = false;
+    m_pingDeadlines.Remove (run.transactionId);
+
+    // without the token back the wrap to the originator is unknown
+    uint32_t positions = run.returned ? run.positions : run.records.rbegin ()->first + 1;
+    m_ringSnapshot.clear ();
+    uint32_t inconsistent = 0, wraps = 0, keys = 0;
+    std::map<uint32_t, GUChordMessage::RingRecord>::const_iterator it;
+    for (it = run.records.begin (); it != run.records.end (); it++)
+      {
+        const GUChordMessage::RingRecord &record = it->second;
+        m_ringSnapshot.push_back (record);
+        keys += record.key_count;
+
+        bool consistent = true;
+        std::map<uint32_t, GUChordMessage::RingRecord>::const_iterator found = run.records.find ((it->first + 1) % positions);
+        if (found != run.records.end () && (run.returned || it->first + 1 < positions))
+          {
+            const GUChordMessage::RingRecord &next = found->second;
+            consistent = record.successor_id == next.node_id && record.successor_vnode == next.vnode &&
+                         next.predecessor_id == record.node_id && next.predecessor_vnode == record.vnode;
+            if (!(record.node_key < next.node_key))
+                wraps++;
+          }
+        if (!consistent)
+            inconsistent++;
+
+        CHORD_LOG ("\nRingSnapshot<" << record.node_id << "#" << (uint32_t) record.vnode << ", " << record.node_key << ">: Pred<" << record.predecessor_id << "#" << (uint32_t) record.predecessor_vnode << ">, Succ<" << record.successor_id << "#" << (uint32_t) record.successor_vnode << ">, Fingers<" << record.finger_nodes << ", Stable: " << record.stable_fingers << ">, Keys<" << record.key_count << ">" << (consistent ? "" : " INCONSISTENT"));
+      }
+
+    // a single position is its own successor and wraps once as well
+    CHORD_LOG ("\nRingSnapshotSummary<Positions: " << run.records.size() << ", Keys: " << keys << ", InconsistentLinks: " << inconsistent << ", Wraps: " << wraps << ", Broken: " << (run.broken ? "yes" : "no")
+               << ", Missing: " << positions - run.records.size() << (run.returned ? "" : ", Complete: no, the snapshot stalled") << ">");
+}
+
+std::vector<GUChordMessage::RingRecord>
+GUChord::GetRingSnapshot () const
+{
+    return m_ringSnapshot;
+}
+
+void
+GUChord::ProcessFindSuccessorReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+
+        std::string fromNode = ReverseLookup (sourceAddress);
+        //CHORD_LOG ("Received FIND_SUCCESSOR_REQ, From Node: " << fromNode);
+
+        if(ChordId::IsSuccessor(my_node_key, message.GetFindSuccessorReq().start_value, successor_node_key)) {
 
             uint32_t transactionId = GetNextTransactionId ();
 
@@ -1005,7 +1883,8 @@ GUChord::ProcessFindSuccessorReq (GUChordMessage message, Ipv4Address sourceAddr
             Ptr<Packet> packet = Create<Packet> ();
             GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::FIND_SUCCESSOR_RSP, transactionId );
 
-            guChordMessage.SetFindSuccessorRsp (successor_id, successor_ip_address, message.GetFindSuccessorReq().start_value, message.GetFindSuccessorReq().start_value_index);
+            guChordMessage.SetFindSuccessorRsp (successor_id, successor_ip_address, successor_vnode, message.GetFindSuccessorReq().start_value, message.GetFindSuccessorReq().start_value_index);
+            guChordMessage.SetVirtualNode (message.GetFindSuccessorReq().originator_vnode);
             packet->AddHeader (guChordMessage);
             m_socket->SendTo (packet, 0 , InetSocketAddress (message.GetFindSuccessorReq().originator_node_ip_address, m_appPort));
 
@@ -1021,9 +1900,13 @@ GUChord::ProcessFindSuccessorReq (GUChordMessage message, Ipv4Address sourceAddr
             Ptr<Packet> packet = Create<Packet> ();
             GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::FIND_SUCCESSOR_REQ, transactionId );
 
-            guChordMessage.SetFindSuccessorReq (message.GetFindSuccessorReq ().originator_node_id, message.GetFindSuccessorReq().originator_node_ip_address, message.GetFindSuccessorReq().start_value, message.GetFindSuccessorReq().start_value_index);
+            guChordMessage.SetFindSuccessorReq (message.GetFindSuccessorReq ().originator_node_id, message.GetFindSuccessorReq().originator_node_ip_address, message.GetFindSuccessorReq().originator_vnode, message.GetFindSuccessorReq().start_value, message.GetFindSuccessorReq().start_value_index);
+
+            int32_t finger = ClosestPrecedingFinger (message.GetFindSuccessorReq().start_value);
+            RingNode nextHop = finger < 0 ? RingNode (successor_ip_address, successor_vnode) : RingNode (m_fingerNodes[finger].ip_address, m_fingerNodes[finger].vnode);
+            guChordMessage.SetVirtualNode (nextHop.vnode);
             packet->AddHeader (guChordMessage);
-            m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
+            m_socket->SendTo (packet, 0 , InetSocketAddress (nextHop.ip_address, m_appPort));
 
         }
 
@@ -1036,50 +1919,364 @@ GUChord::ProcessFindSuccessorRsp (GUChordMessage message, Ipv4Address sourceAddr
     std::string fromNode = ReverseLookup (sourceAddress);
     //CHORD_LOG ("Received FIND_SUCCESSOR_RSP, From Node: " << fromNode);
 
-    std::string successor_node_key_hex = ipHash(message.GetFindSuccessorRsp().successor_node_ip_address);
+    ChordId finger_node_key = NodeKey(message.GetFindSuccessorRsp().successor_node_ip_address, message.GetFindSuccessorRsp().successor_vnode);
+    uint32_t index = message.GetFindSuccessorRsp().start_value_index;
+
+    // an answer for a table since rebuilt, e.g. to a fix sent before a rejoin
+    if (index >= finger_table.size() || finger_table[index].start_value != message.GetFindSuccessorRsp().start_value)
+    {
+        DEBUG_LOG ("Stale FIND_SUCCESSOR_RSP. Index: " << index << " From: " << fromNode);
+        return;
+    }
+
+    if (finger_table.at(index).finger_key_hash == finger_node_key)
+        finger_table.at(index).stable_rounds++;
+    else
+        finger_table.at(index).stable_rounds = 0;
     
     finger_table.at(message.GetFindSuccessorRsp().start_value_index).start_value = message.GetFindSuccessorRsp().start_value;
     finger_table.at(message.GetFindSuccessorRsp().start_value_index).finger_ip_address = message.GetFindSuccessorRsp().successor_node_ip_address;
+    finger_table.at(message.GetFindSuccessorRsp().start_value_index).finger_vnode = message.GetFindSuccessorRsp().successor_vnode;
     finger_table.at(message.GetFindSuccessorRsp().start_value_index).finger_node_id = ReverseLookup(message.GetFindSuccessorRsp().successor_node_ip_address);
-    finger_table.at(message.GetFindSuccessorRsp().start_value_index).finger_key_hash = successor_node_key_hex;
-    
-    if (finger_table.size() != 160) {
-        FingerInit(message.GetFindSuccessorRsp().start_value_index+2);
+    finger_table.at(message.GetFindSuccessorRsp().start_value_index).finger_key_hash = finger_node_key;
+    UpdateFingerNodes();
+
+    std::map<uint32_t, FingerBootstrapRun>::iterator pending = m_fingerBootstrapPending.find (index);
+    bool run = pending != m_fingerBootstrapPending.end ();
+    uint32_t last = index;
+    if (run)
+    {
+        last = pending->second.last;
+        m_pingDeadlines.Remove (pending->second.transactionId);
+        m_fingerBootstrapPending.erase (pending);
     }
-    else {        
-        // then call it with index+1
-        FingerFix(message.GetFindSuccessorRsp().start_value_index+2);
+    if (run && m_parallelFingerInit)
+    {
+        // every following start in (start, successor] shares this successor
+        uint32_t j = index + 1;
+        for (; j <= last && ChordId::IsInBetween(finger_table[index].start_value, finger_table[j].start_value, finger_node_key); j++)
+        {
+            finger_table[j].finger_ip_address = finger_table[index].finger_ip_address;
+            finger_table[j].finger_vnode = finger_table[index].finger_vnode;
+            finger_table[j].finger_node_id = finger_table[index].finger_node_id;
+            finger_table[j].finger_key_hash = finger_node_key;
+        }
+        UpdateFingerNodes();
+
+        // the answering node precedes the rest of the run, continue from there
+        if (j <= last)
+            SendFingerBootstrapReq(j, last, finger_table[index].finger_ip_address, finger_table[index].finger_vnode);
+        else if (m_fingerBootstrapPending.empty() && !m_fingerSeedPending)
+            FingerBootstrapDone();
+        return;
+    }
+
+    // the one-at-a-time chain, a resent request may be answered twice
+    if (!run || !m_fingerBootstrapping)
+        return;
+
+    if (finger_table.size() == 160) {
+        FingerBootstrapDone();
+    } else {
+        FingerInit(message.GetFindSuccessorRsp().start_value_index+2);
     }
     
 }
 
-bool GUChord::isSuccessor(mpz_t my_key_gmp, mpz_t lookup_key_gmp, mpz_t successor_key_gmp)
+void
+GUChord::ProcessFingerTableReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+    std::vector<Ipv4Address> fingers;
+    std::vector<uint8_t> finger_vnodes;
+    std::set<ChordId> seen;
+
+    for (uint32_t i = 0; i < finger_table.size(); i++)
+    {
+        if (seen.insert(finger_table[i].finger_key_hash).second)
+        {
+            fingers.push_back(finger_table[i].finger_ip_address);
+            finger_vnodes.push_back(finger_table[i].finger_vnode);
+        }
+    }
+
+    GUChordMessage resp = GUChordMessage (GUChordMessage::FINGER_TABLE_RSP, message.GetTransactionId());
+    resp.SetFingerTableRsp (fingers, finger_vnodes);
+    resp.SetVirtualNode (message.GetFingerTableReq().sender_vnode);
+    Ptr<Packet> packet = Create<Packet> ();
+    packet->AddHeader (resp);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
+}
+
+void
+GUChord::ProcessFingerTableRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+    if (!m_fingerSeedPending)
+        return;
+
+    // every node we know of, sorted around the ring
+    std::vector<std::pair<ChordId, RingNode> > known;
+    known.push_back(std::make_pair(my_node_key, RingNode(GetLocalAddress(), m_currentVirtualNode)));
+    known.push_back(std::make_pair(successor_node_key, RingNode(successor_ip_address, successor_vnode)));
+
+    std::vector<Ipv4Address> fingers = message.GetFingerTableRsp().finger_ip_addresses;
+    std::vector<uint8_t> finger_vnodes = message.GetFingerTableRsp().finger_vnodes;
+    for (uint32_t i = 0; i < fingers.size(); i++)
+    {
+        known.push_back(std::make_pair(NodeKey(fingers[i], finger_vnodes[i]), RingNode(fingers[i], finger_vnodes[i])));
+        AddProximityCandidate(fingers[i], finger_vnodes[i]);
+    }
+
+    std::sort(known.begin(), known.end());
+    known.erase(std::unique(known.begin(), known.end()), known.end());
+
+    // seed each finger with the first known node at or after its start
+    for (uint32_t i = 0; i < finger_table.size(); i++)
+    {
+        std::vector<std::pair<ChordId, RingNode> >::iterator it;
+        it = std::lower_bound(known.begin(), known.end(), std::make_pair(finger_table[i].start_value, RingNode (Ipv4Address ((uint32_t) 0), 0)));
+        if (it == known.end())
+            it = known.begin();
+
+        finger_table[i].finger_ip_address = it->second.ip_address;
+        finger_table[i].finger_vnode = it->second.vnode;
+        finger_table[i].finger_node_id = ReverseLookup(it->second.ip_address);
+        finger_table[i].finger_key_hash = it->first;
+    }
+    UpdateFingerNodes();
+
+    FingerBootstrapLookups();
+}
+
+static bool
+FingerNodeOffsetLess (const GUChord::FingerNode &node, const ChordId &offset)
+{
+  return node.offset < offset;
+}
+
+static bool
+FingerNodeLess (const GUChord::FingerNode &a, const GUChord::FingerNode &b)
+{
+  return a.offset < b.offset;
+}
+
+void
+GUChord::UpdateFingerNodes()
+{
+    m_fingerNodes.clear();
+    for (uint32_t i = 0; i < finger_table.size(); i++)
+    {
+        // unresolved entry or a finger pointing back at us
+        if (finger_table[i].finger_node_id.empty() || finger_table[i].finger_key_hash == my_node_key)
+            continue;
+
+        FingerNode node;
+        node.offset = finger_table[i].finger_key_hash.Subtract(my_node_key);
+        node.key = finger_table[i].finger_key_hash;
+        node.ip_address = finger_table[i].finger_ip_address;
+        node.vnode = finger_table[i].finger_vnode;
+
+        // any node in [2^i, 2^(i+1)) serves as finger i, take the closest
+        // one by RTT; finger 0 stays the successor
+        ChordId low = ChordId().AddPowerOfTwo(i);
+        ChordId high = ChordId().AddPowerOfTwo(i + 1);
+        if (i > 0 && m_proximityCandidates > 0 && node.offset >= low && (i == CHORD_ID_BITS - 1 || node.offset < high))
+        {
+            std::map<Ipv4Address, Time>::iterator rtt = m_nodeRtt.find(node.ip_address);
+            if (rtt == m_nodeRtt.end() && m_proximityNodes.find(node.offset) == m_proximityNodes.end())
+                AddProximityCandidate(node.ip_address, node.vnode);
+            bool measured = rtt != m_nodeRtt.end();
+            Time best = measured ? rtt->second : Time ();
+
+            std::map<ChordId, RingNode>::iterator it = m_proximityNodes.lower_bound(low);
+            for (; it != m_proximityNodes.end() && (i == CHORD_ID_BITS - 1 || it->first < high); it++)
+            {
+                std::map<Ipv4Address, Time>::iterator candidate = m_nodeRtt.find(it->second.ip_address);
+                if (candidate == m_nodeRtt.end() || (measured && candidate->second >= best))
+                    continue;
+                measured = true;
+                best = candidate->second;
+                node.offset = it->first;
+                node.key = NodeKey(it->second.ip_address, it->second.vnode);
+                node.ip_address = it->second.ip_address;
+                node.vnode = it->second.vnode;
+            }
+        }
+        m_fingerNodes.push_back(node);
+    }
+
+    std::sort(m_fingerNodes.begin(), m_fingerNodes.end(), FingerNodeLess);
+
+    // fingers share successors, keep one entry per node
+    uint32_t distinct = 0;
+    for (uint32_t i = 0; i < m_fingerNodes.size(); i++)
+    {
+        if (distinct == 0 || m_fingerNodes[distinct-1].key != m_fingerNodes[i].key)
+            m_fingerNodes[distinct++] = m_fingerNodes[i];
+    }
+    m_fingerNodes.resize(distinct);
+}
+
+void
+GUChord::AddProximityCandidate(Ipv4Address address, uint8_t vnode)
 {
-  if(mpz_cmp(lookup_key_gmp, successor_key_gmp) <= 0 && mpz_cmp(lookup_key_gmp, my_key_gmp) > 0)
-        return true;
-  if (mpz_cmp(my_key_gmp, successor_key_gmp) > 0 && mpz_cmp(lookup_key_gmp, my_key_gmp) > 0)
-        return true;
-  if (mpz_cmp(my_key_gmp, successor_key_gmp) > 0 && mpz_cmp(lookup_key_gmp, successor_key_gmp) < 0)
-        return true;
-  if (mpz_cmp(successor_key_gmp, my_key_gmp) == 0)
-        return true;
-  return false;
+    if (m_proximityCandidates == 0 || address == GetLocalAddress() || address == Ipv4Address ())
+        return;
+
+    ChordId offset = NodeKey(address, vnode).Subtract(my_node_key);
+    if (offset == ChordId () || m_proximityNodes.find(offset) != m_proximityNodes.end())
+        return;
+
+    // finger interval of this node: [2^b, 2^(b+1)) for its highest set bit b
+    uint32_t bit = CHORD_ID_BITS - 1;
+    for (uint32_t word = 0; word < CHORD_ID_WORDS; word++, bit -= 32)
+    {
+        uint32_t value = offset.GetWord(word);
+        if (value == 0)
+            continue;
+        while (!(value & 0x80000000))
+        {
+            value <<= 1;
+            bit--;
+        }
+        break;
+    }
+    ChordId low = ChordId().AddPowerOfTwo(bit);
+    ChordId high = ChordId().AddPowerOfTwo(bit + 1);
+
+    uint32_t count = 0;
+    std::map<ChordId, RingNode>::iterator it = m_proximityNodes.lower_bound(low);
+    for (; it != m_proximityNodes.end() && (bit == CHORD_ID_BITS - 1 || it->first < high); it++)
+        count++;
+    if (count >= m_proximityCandidates)
+        return;
+
+    m_proximityNodes.insert(std::make_pair(offset, RingNode(address, vnode)));
+    if (m_nodeRtt.find(address) == m_nodeRtt.end())
+        SendProximityPing(address);
+}
+
+void
+GUChord::RemoveProximityCandidate(Ipv4Address address)
+{
+    bool measured = m_nodeRtt.erase(address) > 0;
+
+    // the address may stand for several ring positions in every virtual node
+    VirtualNodeScope scope (*this);
+    for (uint32_t v = 0; v < m_virtualNodes.size(); v++)
+    {
+        SelectVirtualNode(v);
+        std::map<ChordId, RingNode>::iterator it = m_proximityNodes.begin();
+        while (it != m_proximityNodes.end())
+        {
+            if (it->second.ip_address == address)
+                m_proximityNodes.erase(it++);
+            else
+                it++;
+        }
+        if (measured)
+            UpdateFingerNodes();
+    }
+}
+
+int32_t
+GUChord::ClosestPrecedingFinger(const ChordId &target) const
+{
+    // last finger whose clockwise distance is below the target's
+    ChordId offset = target.Subtract(my_node_key);
+    std::vector<FingerNode>::const_iterator it = std::lower_bound(m_fingerNodes.begin(), m_fingerNodes.end(), offset, FingerNodeOffsetLess);
+    if (it == m_fingerNodes.begin())
+        return -1;
+    return (it - m_fingerNodes.begin()) - 1;
+}
+
+void
+GUChord::ProcessIterativeLookupReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  ChordId target_key = message.GetIterativeLookupReq().target_key;
+
+  GUChordMessage resp = GUChordMessage (GUChordMessage::ITERATIVE_LOOKUP_RSP, message.GetTransactionId());
+
+  if (OwnsKey (target_key))
+  {
+    resp.SetIterativeLookupRsp (target_key, atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), m_currentVirtualNode);
+  }
+  else if (ChordId::IsInBetween(my_node_key, target_key, successor_node_key))
+  {
+    resp.SetIterativeLookupRsp (target_key, successor_id, successor_ip_address, successor_vnode);
+  }
+  else
+  {
+    // hand back the closest fingers preceding the target
+    std::vector<Ipv4Address> nextHops;
+    std::vector<uint8_t> nextHopVnodes;
+    for (int32_t finger = ClosestPrecedingFinger (target_key); finger >= 0 && nextHops.size() < m_lookupAlpha; finger--)
+    {
+      nextHops.push_back (m_fingerNodes[finger].ip_address);
+      nextHopVnodes.push_back (m_fingerNodes[finger].vnode);
+    }
+    if (nextHops.empty())
+    {
+      nextHops.push_back (successor_ip_address);
+      nextHopVnodes.push_back (successor_vnode);
+    }
+    resp.SetIterativeLookupRsp (target_key, nextHops, nextHopVnodes);
+  }
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (resp);
+  m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
+}
+
+void
+GUChord::ProcessIterativeLookupRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  std::map<uint32_t, LookupProbe>::iterator probe = m_probeTracker.find (message.GetTransactionId ());
+  if (probe == m_probeTracker.end ())
+  {
+    DEBUG_LOG ("Received late or invalid ITERATIVE_LOOKUP_RSP!");
+    return;
+  }
+  uint32_t lookupId = probe->second.lookup_id;
+  m_probeTracker.erase (probe);
+  m_probeDeadlines.Remove (message.GetTransactionId ());
+
+  std::map<uint32_t, IterativeLookup>::iterator lookup = m_iterativeLookups.find (lookupId);
+  if (lookup == m_iterativeLookups.end ())
+    return;
+  lookup->second.in_flight--;
+  lookup->second.probes.erase (message.GetTransactionId ());
+
+  GUChordMessage::IterativeLookupRsp rsp = message.GetIterativeLookupRsp ();
+  if (rsp.owner_found)
+  {
+    // done, drop the probes still in flight for this lookup
+    IterativeLookupCancel (lookupId);
+    if (!CompleteChordLookup (lookupId))
+      return;
+
+    ChordId owner_node_key = NodeKey(rsp.owner_ip_address, rsp.owner_vnode);
+    CHORD_LOG ("\nLookupResult<CurrentNodeKey: " << owner_node_key << ", TargetKey: " << rsp.target_key << ", OrignatorNode: " << ReverseLookup(GetLocalAddress()) << ">");
+
+    LookupCacheInsert (rsp.target_key, rsp.owner_node_id, rsp.owner_ip_address, rsp.owner_vnode);
+    m_chordLookup (rsp.owner_ip_address, rsp.owner_node_id, owner_node_key.ToHex(), lookupId);
+    return;
+  }
+
+  for (uint32_t i = 0; i < rsp.next_hops.size(); i++)
+  {
+    IterativeLookupAddCandidate (lookupId, rsp.next_hops[i], rsp.next_hop_vnodes[i]);
+    AddProximityCandidate (rsp.next_hops[i], rsp.next_hop_vnodes[i]);
+  }
+  IterativeLookupStep (lookupId);
 }
 
 void
 GUChord::ProcessLookupReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
 {
 
-  mpz_t target_key_gmp;
-  mpz_t my_key_gmp;
-  mpz_t predecessor_key_gmp;
-  mpz_t successor_key_gmp;
-  mpz_init_set_str(target_key_gmp, message.GetLookupReq().target_key.c_str(), 16);
-  mpz_init_set_str(my_key_gmp, ipHash(GetLocalAddress()).c_str(), 16);
-  mpz_init_set_str(predecessor_key_gmp, ipHash(predecessor_ip_address).c_str(), 16);
-  mpz_init_set_str(successor_key_gmp, ipHash(successor_ip_address).c_str(), 16);
+  ChordId target_key = message.GetLookupReq().target_key;
   // first check if you are the right key
-  if(isInBetween(predecessor_key_gmp, target_key_gmp, my_key_gmp))
+  if(OwnsKey (target_key))
   {
 
     //uint32_t transactionId = GetNextTransactionId ();
@@ -1087,16 +2284,16 @@ GUChord::ProcessLookupReq (GUChordMessage message, Ipv4Address sourceAddress, ui
     Ptr<Packet> packet = Create<Packet> ();
     GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::LOOKUP_RSP, message.GetTransactionId() );
 
-    guChordMessage.SetLookupRsp (message.GetLookupReq ().originator_node_id, message.GetLookupReq ().originator_node_ip_address, atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), message.GetLookupReq().target_key);
+    guChordMessage.SetLookupRsp (message.GetLookupReq ().originator_node_id, message.GetLookupReq ().originator_node_ip_address, atoi(ReverseLookup(GetLocalAddress()).c_str()), GetLocalAddress(), m_currentVirtualNode, message.GetLookupReq().target_key);
     packet->AddHeader (guChordMessage);
     m_socket->SendTo (packet, 0 , InetSocketAddress (message.GetLookupReq ().originator_node_ip_address, m_appPort));
 
   }
 
-  else if(isInBetween(my_key_gmp, target_key_gmp, successor_key_gmp ))
+  else if(ChordId::IsInBetween(my_node_key, target_key, successor_node_key))
   {
 
-    CHORD_LOG ("\nLookupRequest<CurrentNodeKey: " << my_node_key_hex << ">: NextHop<NextAddr: " << successor_ip_address << ", NextKey: " << successor_node_key_hex << ", TargetKey: " << message.GetLookupReq().target_key << ">");
+    CHORD_LOG ("\nLookupRequest<CurrentNodeKey: " << my_node_key << ">: NextHop<NextAddr: " << successor_ip_address << ", NextKey: " << successor_node_key << ", TargetKey: " << message.GetLookupReq().target_key << ">");
 
     //uint32_t transactionId = GetNextTransactionId ();
 
@@ -1104,6 +2301,7 @@ GUChord::ProcessLookupReq (GUChordMessage message, Ipv4Address sourceAddress, ui
     GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::LOOKUP_REQ, message.GetTransactionId() );
 
     guChordMessage.SetLookupReq (message.GetLookupReq ().originator_node_id, message.GetLookupReq ().originator_node_ip_address, message.GetLookupReq().target_key);
+    guChordMessage.SetVirtualNode (successor_vnode);
     packet->AddHeader (guChordMessage);
     m_socket->SendTo (packet, 0 , InetSocketAddress (successor_ip_address, m_appPort));
 
@@ -1111,81 +2309,587 @@ GUChord::ProcessLookupReq (GUChordMessage message, Ipv4Address sourceAddress, ui
   else
   {
 
-    mpz_t curr_finger_key_gmp;
-    mpz_t prev_finger_key_gmp;
-    //mpz_t finger_key_gmp;
-    for (int i = 1; i < 160; i++)
+    // forward to the closest finger preceding the target
+    int32_t finger = ClosestPrecedingFinger (target_key);
+    Ipv4Address nextHop = finger < 0 ? successor_ip_address : m_fingerNodes[finger].ip_address;
+    uint8_t nextVnode = finger < 0 ? successor_vnode : m_fingerNodes[finger].vnode;
+    ChordId nextKey = finger < 0 ? successor_node_key : m_fingerNodes[finger].key;
+
+    Ptr<Packet> packet = Create<Packet> ();
+    GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::LOOKUP_REQ, message.GetTransactionId() );
+
+    guChordMessage.SetLookupReq (message.GetLookupReq ().originator_node_id, message.GetLookupReq ().originator_node_ip_address, message.GetLookupReq().target_key);
+    guChordMessage.SetVirtualNode (nextVnode);
+    packet->AddHeader (guChordMessage);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (nextHop, m_appPort));
+
+    CHORD_LOG ("\nLookupRequest<CurrentNodeKey: " << my_node_key << ">: NextHop<NextAddr: " << nextHop << ", NextKey: " << nextKey << ", TargetKey: " << message.GetLookupReq().target_key << ">");
+
+  }
+}
+
+void
+GUChord::ProcessLookupRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+
+    ChordId owner_node_key = NodeKey(message.GetLookupRsp().successor_node_ip_address, message.GetLookupRsp().successor_vnode);
+    CHORD_LOG ("\nLookupResult<CurrentNodeKey: " << owner_node_key << ", TargetKey: " << message.GetLookupRsp().target_key << ", OrignatorNode: " << message.GetLookupRsp().originator_node_id << ">");
+
+    LookupCacheInsert (message.GetLookupRsp().target_key, message.GetLookupRsp().successor_node_id, message.GetLookupRsp().successor_node_ip_address, message.GetLookupRsp().successor_vnode);
+    if (!CompleteChordLookup (message.GetTransactionId()))
+        return;
+    m_chordLookup (message.GetLookupRsp().successor_node_ip_address, message.GetLookupRsp().successor_node_id, owner_node_key.ToHex(), message.GetTransactionId());
+
+}
+
+void
+GUChord::ProcessLookupBatchReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::LookupBatchReq req = message.GetLookupBatchReq ();
+
+  // keys answered here, by owner, and keys passed on, by next hop
+  std::vector<ChordId> mineKeys, succKeys;
+  std::vector<uint32_t> mineIds, succIds;
+  std::map<RingNode, std::pair<std::vector<ChordId>, std::vector<uint32_t> > > forward;
+
+  for (uint32_t i = 0; i < req.target_keys.size (); i++)
     {
-      mpz_init_set_str(curr_finger_key_gmp, finger_table[i].finger_key_hash.c_str(), 16);
-      mpz_init_set_str(prev_finger_key_gmp, finger_table[i-1].finger_key_hash.c_str(), 16);
-      if (isInBetween(prev_finger_key_gmp, target_key_gmp, curr_finger_key_gmp))
-      {
-        
-        // you found the node to forward the message along to
+      const ChordId &key = req.target_keys[i];
+      if (OwnsKey (key))
+        {
+          mineKeys.push_back (key);
+          mineIds.push_back (req.transaction_ids[i]);
+        }
+      else if (ChordId::IsInBetween (my_node_key, key, successor_node_key))
+        {
+          succKeys.push_back (key);
+          succIds.push_back (req.transaction_ids[i]);
+        }
+      else
+        {
+          int32_t finger = ClosestPrecedingFinger (key);
+          RingNode nextHop = finger < 0 ? RingNode (successor_ip_address, successor_vnode) : RingNode (m_fingerNodes[finger].ip_address, m_fingerNodes[finger].vnode);
+          forward[nextHop].first.push_back (key);
+          forward[nextHop].second.push_back (req.transaction_ids[i]);
+        }
+    }
+
+  CHORD_LOG ("\nLookupBatchRequest<CurrentNodeKey: " << my_node_key << ">: Keys<Owned: " << mineKeys.size () << ", Successor: " << succKeys.size () << ", Forwarded: " << req.target_keys.size () - mineKeys.size () - succKeys.size () << ", NextHops: " << forward.size () << ">");
+
+  if (!mineKeys.empty ())
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      GUChordMessage resp = GUChordMessage (GUChordMessage::LOOKUP_BATCH_RSP, message.GetTransactionId ());
+      resp.SetLookupBatchRsp (atoi (ReverseLookup (GetLocalAddress ()).c_str ()), GetLocalAddress (), m_currentVirtualNode, mineKeys, mineIds);
+      packet->AddHeader (resp);
+      m_socket->SendTo (packet, 0 , InetSocketAddress (req.originator_node_ip_address, m_appPort));
+    }
+  if (!succKeys.empty ())
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      GUChordMessage resp = GUChordMessage (GUChordMessage::LOOKUP_BATCH_RSP, message.GetTransactionId ());
+      resp.SetLookupBatchRsp (successor_id, successor_ip_address, successor_vnode, succKeys, succIds);
+      packet->AddHeader (resp);
+      m_socket->SendTo (packet, 0 , InetSocketAddress (req.originator_node_ip_address, m_appPort));
+    }
+
+  std::map<RingNode, std::pair<std::vector<ChordId>, std::vector<uint32_t> > >::iterator it;
+  for (it = forward.begin (); it != forward.end (); it++)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::LOOKUP_BATCH_REQ, message.GetTransactionId ());
+      guChordMessage.SetLookupBatchReq (req.originator_node_id, req.originator_node_ip_address, it->second.first, it->second.second);
+      guChordMessage.SetVirtualNode (it->first.vnode);
+      packet->AddHeader (guChordMessage);
+      m_socket->SendTo (packet, 0 , InetSocketAddress (it->first.ip_address, m_appPort));
+    }
+}
 
-         //uint32_t transactionId = GetNextTransactionId ();
+void
+GUChord::ProcessLookupBatchRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUChordMessage::LookupBatchRsp rsp = message.GetLookupBatchRsp ();
+  ChordId owner_node_key = NodeKey (rsp.owner_ip_address, rsp.owner_vnode);
+  std::string ownerKey = owner_node_key.ToHex ();
 
-         Ptr<Packet> packet = Create<Packet> ();
-         GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::LOOKUP_REQ, message.GetTransactionId() );
+  CHORD_LOG ("\nLookupBatchResult<CurrentNodeKey: " << owner_node_key << ", Keys: " << rsp.target_keys.size () << ", OrignatorNode: " << ReverseLookup (GetLocalAddress ()) << ">");
 
-         guChordMessage.SetLookupReq (message.GetLookupReq ().originator_node_id, message.GetLookupReq ().originator_node_ip_address, message.GetLookupReq().target_key);
-         packet->AddHeader (guChordMessage);
-         m_socket->SendTo (packet, 0 , InetSocketAddress (finger_table[i-1].finger_ip_address, m_appPort));
+  for (uint32_t i = 0; i < rsp.target_keys.size (); i++)
+    {
+      LookupCacheInsert (rsp.target_keys[i], rsp.owner_node_id, rsp.owner_ip_address, rsp.owner_vnode);
+      if (!CompleteChordLookup (rsp.transaction_ids[i]))
+        continue;
+      m_chordLookup (rsp.owner_ip_address, rsp.owner_node_id, ownerKey, rsp.transaction_ids[i]);
+    }
+}
 
-        CHORD_LOG ("\nLookupRequest<CurrentNodeKey: " << my_node_key_hex << ">: NextHop<NextAddr: " << successor_ip_address << ", NextKey: " << successor_node_key_hex << ", TargetKey: " << message.GetLookupReq().target_key << ">");
-        
+bool
+GUChord::TrackChordLookup (ChordId target, uint32_t transactionId)
+{
+  m_lookupsIssued++;
+  if (m_lookupTransactions.size () >= m_maxPendingLookups && m_lookupTransactions.find (transactionId) == m_lookupTransactions.end ())
+    {
+      ERROR_LOG ("Too many pending lookups, dropping lookup for key: " << target);
+      m_lookupsFailed++;
+      // callers register the transaction after this returns
+      Simulator::ScheduleNow (&GUChord::DeliverChordLookupFailure, this, target.ToHex (), transactionId);
+      return false;
+    }
+
+  LookupTransaction transaction;
+  transaction.target = target;
+  transaction.attempts = 1;
+  m_lookupTransactions[transactionId] = transaction;
+  m_lookupDeadlines.Insert (transactionId, Simulator::Now () + m_lookupTimeout);
+  if (!m_auditLookupsTimer.IsRunning ())
+    {
+      m_auditLookupsTimer.Schedule (m_lookupDeadlines.GetTick ());
+    }
+  return true;
+}
+
+// Returns false for results of lookups that already completed or failed
+bool
+GUChord::CompleteChordLookup (uint32_t transactionId)
+{
+  if (m_lookupTransactions.erase (transactionId) == 0)
+    {
+      DEBUG_LOG ("Received late or duplicate lookup result, transactionId: " << transactionId);
+      return false;
+    }
+  m_lookupDeadlines.Remove (transactionId);
+  m_lookupsSucceeded++;
+  return true;
+}
+
+void
+GUChord::AuditLookups ()
+{
+  std::vector<uint32_t> expired = m_lookupDeadlines.Expire (Simulator::Now ());
+  for (uint32_t i = 0; i < expired.size (); i++)
+    {
+      std::map<uint32_t, LookupTransaction>::iterator it = m_lookupTransactions.find (expired[i]);
+      if (it == m_lookupTransactions.end ())
+        {
+          continue;
+        }
+      LookupTransaction &transaction = it->second;
+      if (transaction.attempts > m_lookupRetries)
+        {
+          CHORD_LOG ("\nLookupFailed<CurrentNodeKey: " << my_node_key << ", TargetKey: " << transaction.target << ", Attempts: " << transaction.attempts << ">");
+          std::string target = transaction.target.ToHex ();
+          IterativeLookupCancel (expired[i]);
+          m_lookupTransactions.erase (it);
+          m_lookupsFailed++;
+          m_chordLookupFailure (target, expired[i]);
+          continue;
+        }
+
+      // back off exponentially, the ring may still be settling
+      Time timeout = MilliSeconds (m_lookupTimeout.GetMilliSeconds () << transaction.attempts);
+      transaction.attempts++;
+      m_lookupsRetried++;
+      DEBUG_LOG ("Retrying lookup, transactionId: " << expired[i] << " attempt: " << transaction.attempts);
+      m_lookupDeadlines.Insert (expired[i], Simulator::Now () + timeout);
+      IssueChordLookup (transaction.target, expired[i]);
+    }
+  if (!m_lookupDeadlines.IsEmpty ())
+    {
+      m_auditLookupsTimer.Schedule (m_lookupDeadlines.GetTick ());
+    }
+}
+
+void
+GUChord::DeliverChordLookupFailure (std::string target, uint32_t transactionId)
+{
+  m_chordLookupFailure (target, transactionId);
+}
+
+bool
+GUChord::LookupCacheFind (const ChordId &target, uint32_t &ownerNodeId, Ipv4Address &ownerAddress, ChordId &ownerKey)
+{
+  if (m_lookupCache.empty ())
+    {
+      return false;
+    }
+
+  // first cached owner clockwise from the target
+  std::map<ChordId, LookupCacheEntry>::iterator it = m_lookupCache.lower_bound (target);
+  if (it == m_lookupCache.end ())
+    {
+      it = m_lookupCache.begin ();
+    }
+  const ChordId &owner = it->first;
+  if (owner.Subtract (target) > owner.Subtract (it->second.low))
+    {
+      return false;
+    }
+  // nodes join and leave under the range, an old answer is asked again
+  if (it->second.expires <= Simulator::Now ())
+    {
+      m_lookupCacheLru.erase (it->second.lru);
+      m_lookupCache.erase (it);
+      return false;
+    }
+
+  m_lookupCacheLru.splice (m_lookupCacheLru.begin (), m_lookupCacheLru, it->second.lru);
+  ownerNodeId = it->second.owner_node_id;
+  ownerAddress = it->second.owner_ip_address;
+  ownerKey = owner;
+  return true;
+}
+
+void
+GUChord::LookupCacheInsert (const ChordId &target, uint32_t ownerNodeId, Ipv4Address ownerAddress, uint8_t ownerVnode)
+{
+  if (m_lookupCacheSize == 0)
+    {
       return;
-      }
-    }// end of for
+    }
 
-         //uint32_t transactionId = GetNextTransactionId ();
+  ChordId owner = NodeKey (ownerAddress, ownerVnode);
+  std::map<ChordId, LookupCacheEntry>::iterator it = m_lookupCache.find (owner);
+  if (it != m_lookupCache.end ())
+    {
+      // ownership is one contiguous arc, widen it down to the new key
+      if (owner.Subtract (target) > owner.Subtract (it->second.low))
+        {
+          it->second.low = target;
+        }
+      it->second.owner_node_id = ownerNodeId;
+      it->second.owner_ip_address = ownerAddress;
+      it->second.expires = Simulator::Now () + m_lookupCacheLifetime;
+      m_lookupCacheLru.splice (m_lookupCacheLru.begin (), m_lookupCacheLru, it->second.lru);
+      return;
+    }
 
-         Ptr<Packet> packet = Create<Packet> ();
-         GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::LOOKUP_REQ, message.GetTransactionId() );
+  if (m_lookupCache.size () >= m_lookupCacheSize)
+    {
+      m_lookupCache.erase (m_lookupCacheLru.back ());
+      m_lookupCacheLru.pop_back ();
+    }
 
-         guChordMessage.SetLookupReq (message.GetLookupReq ().originator_node_id, message.GetLookupReq ().originator_node_ip_address, message.GetLookupReq().target_key);
-         packet->AddHeader (guChordMessage);
-         m_socket->SendTo (packet, 0 , InetSocketAddress (finger_table[159].finger_ip_address, m_appPort));
+  m_lookupCacheLru.push_front (owner);
+  LookupCacheEntry entry;
+  entry.low = target;
+  entry.owner_node_id = ownerNodeId;
+  entry.owner_ip_address = ownerAddress;
+  entry.expires = Simulator::Now () + m_lookupCacheLifetime;
+  entry.lru = m_lookupCacheLru.begin ();
+  m_lookupCache.insert (std::make_pair (owner, entry));
+}
 
-        CHORD_LOG ("\nLookupRequest<CurrentNodeKey: " << my_node_key_hex << ">: NextHop<NextAddr: " << finger_table[159].finger_ip_address << ", NextKey: " << finger_table[159].finger_key_hash << ", TargetKey: " << message.GetLookupReq().target_key << ">");
+void
+GUChord::LookupCacheClear ()
+{
+  m_lookupCache.clear ();
+  m_lookupCacheLru.clear ();
+}
 
-  }
+void
+GUChord::LookupCacheInvalidate (const ChordId &target)
+{
+  if (m_lookupCache.empty ())
+    {
+      return;
+    }
+
+  std::map<ChordId, LookupCacheEntry>::iterator it = m_lookupCache.lower_bound (target);
+  if (it == m_lookupCache.end ())
+    {
+      it = m_lookupCache.begin ();
+    }
+  if (it->first.Subtract (target) > it->first.Subtract (it->second.low))
+    {
+      return;
+    }
+
+  CHORD_LOG ("\nLookupCacheInvalidate<TargetKey: " << target << ", OwnerNode: " << it->second.owner_node_id << ">");
+  m_lookupCacheLru.erase (it->second.lru);
+  m_lookupCache.erase (it);
 }
 
 void
-GUChord::ProcessLookupRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+GUChord::DeliverChordLookup (Ipv4Address ownerAddress, uint32_t ownerNodeId, std::string ownerKey, uint32_t transactionId)
 {
+  m_chordLookup (ownerAddress, ownerNodeId, ownerKey, transactionId);
+}
 
-    CHORD_LOG ("\nLookupResult<CurrentNodeKey: " << ipHash(message.GetLookupRsp().successor_node_ip_address) << ", TargetKey: " << message.GetLookupRsp().target_key << ", OrignatorNode: " << message.GetLookupRsp().originator_node_id << ">");
+void
+GUChord::IterativeLookupAddCandidate (uint32_t lookupId, Ipv4Address address, uint8_t vnode)
+{
+  IterativeLookup &lookup = m_iterativeLookups[lookupId];
+  RingNode node (address, vnode);
+  if (lookup.probed.find (node) != lookup.probed.end ())
+    {
+      return;
+    }
+
+  // order by clockwise distance to the target, closest preceding first
+  std::pair<ChordId, RingNode> candidate = std::make_pair (lookup.target.Subtract (NodeKey (address, vnode)), node);
+  std::vector<std::pair<ChordId, RingNode> >::iterator it;
+  it = std::lower_bound (lookup.candidates.begin (), lookup.candidates.end (), candidate);
+  if (it == lookup.candidates.end () || *it != candidate)
+    {
+      lookup.candidates.insert (it, candidate);
+    }
+}
+
+void
+GUChord::IterativeLookupCancel (uint32_t lookupId)
+{
+  std::map<uint32_t, IterativeLookup>::iterator it = m_iterativeLookups.find (lookupId);
+  if (it == m_iterativeLookups.end ())
+    {
+      return;
+    }
+  const std::set<uint32_t> &probes = it->second.probes;
+  for (std::set<uint32_t>::const_iterator probe = probes.begin (); probe != probes.end (); probe++)
+    {
+      m_probeTracker.erase (*probe);
+      m_probeDeadlines.Remove (*probe);
+    }
+  m_iterativeLookups.erase (it);
+}
+
+void
+GUChord::IterativeLookupStep (uint32_t lookupId)
+{
+  std::map<uint32_t, IterativeLookup>::iterator it = m_iterativeLookups.find (lookupId);
+  if (it == m_iterativeLookups.end ())
+    {
+      return;
+    }
+  IterativeLookup &lookup = it->second;
+
+  // keep up to alpha probes in flight to the closest known nodes
+  while (lookup.in_flight < m_lookupAlpha && !lookup.candidates.empty ())
+    {
+      RingNode destination = lookup.candidates.front ().second;
+      lookup.candidates.erase (lookup.candidates.begin ());
+      lookup.probed.insert (destination);
+
+      uint32_t probeId = GetNextTransactionId ();
+      LookupProbe probe;
+      probe.lookup_id = lookupId;
+      probe.destination = destination.ip_address;
+      probe.timestamp = Simulator::Now ();
+      m_probeTracker.insert (std::make_pair (probeId, probe));
+      m_probeDeadlines.Insert (probeId, probe.timestamp + m_probeTimeout);
+      lookup.probes.insert (probeId);
+      lookup.in_flight++;
+
+      Ptr<Packet> packet = Create<Packet> ();
+      GUChordMessage guChordMessage = GUChordMessage (GUChordMessage::ITERATIVE_LOOKUP_REQ, probeId);
+      guChordMessage.SetIterativeLookupReq (atoi (ReverseLookup (GetLocalAddress ()).c_str ()), GetLocalAddress (), lookup.target);
+      guChordMessage.SetVirtualNode (destination.vnode);
+      packet->AddHeader (guChordMessage);
+      m_socket->SendTo (packet, 0 , InetSocketAddress (destination.ip_address, m_appPort));
+    }
+
+  if (lookup.in_flight == 0)
+    {
+      // every node we heard of was probed and none knew the owner, the
+      // transaction deadline retries from scratch
+      DEBUG_LOG ("Iterative lookup exhausted its candidates, TargetKey: " << lookup.target);
+      m_iterativeLookups.erase (it);
+    }
 
-    m_chordLookup (message.GetLookupRsp().successor_node_ip_address, message.GetLookupRsp().successor_node_id, ipHash(message.GetLookupRsp().successor_node_ip_address), message.GetTransactionId());
+  if (!m_probeDeadlines.IsEmpty () && !m_auditProbesTimer.IsRunning ())
+    {
+      m_auditProbesTimer.Schedule (m_probeDeadlines.GetTick ());
+    }
+}
 
+void
+GUChord::AuditProbes ()
+{
+  std::set<uint32_t> lookups;
+  std::vector<uint32_t> expired = m_probeDeadlines.Expire (Simulator::Now ());
+  for (uint32_t i = 0; i < expired.size (); i++)
+    {
+      std::map<uint32_t, LookupProbe>::iterator iter = m_probeTracker.find (expired[i]);
+      if (iter == m_probeTracker.end ())
+        {
+          continue;
+        }
+      LookupProbe probe = iter->second;
+      DEBUG_LOG ("Lookup probe expired. Node: " << ReverseLookup (probe.destination) << " Timestamp: " << probe.timestamp.GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
+      m_probeTracker.erase (iter);
+      std::map<uint32_t, IterativeLookup>::iterator lookup = m_iterativeLookups.find (probe.lookup_id);
+      if (lookup != m_iterativeLookups.end ())
+        {
+          lookup->second.in_flight--;
+          lookup->second.probes.erase (expired[i]);
+          lookups.insert (probe.lookup_id);
+        }
+    }
+  // replace the lost probes with the next candidates
+  for (std::set<uint32_t>::iterator it = lookups.begin (); it != lookups.end (); it++)
+    {
+      IterativeLookupStep (*it);
+    }
+  if (!m_probeDeadlines.IsEmpty () && !m_auditProbesTimer.IsRunning ())
+    {
+      m_auditProbesTimer.Schedule (m_probeDeadlines.GetTick ());
+    }
 }
 
 void
 GUChord::AuditPings ()
 {
-  std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  for (iter = m_pingTracker.begin () ; iter != m_pingTracker.end();)
+  std::set<Ipv4Address> failedAddresses;
+  std::vector<bool> successorFailed (m_virtualNodes.size (), false);
+  VirtualNodeScope scope (*this);
+  // transaction ids are unique across the trackers, find whose each one is
+  std::vector<uint32_t> expired = m_pingDeadlines.Expire (Simulator::Now ());
+  for (uint32_t i = 0; i < expired.size (); i++)
     {
-      Ptr<PingRequest> pingRequest = iter->second;
-      if (pingRequest->GetTimestamp().GetMilliSeconds() + m_pingTimeout.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
+      std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
+      if ((iter = m_pingTracker.find (expired[i])) != m_pingTracker.end ())
         {
+          Ptr<PingRequest> pingRequest = iter->second;
           DEBUG_LOG ("Ping expired. Message: " << pingRequest->GetPingMessage () << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
           // Remove stale entries
-          m_pingTracker.erase (iter++);
+          m_pingTracker.erase (iter);
           // Send indication to application layer
           m_pingFailureFn (pingRequest->GetDestinationAddress(), pingRequest->GetPingMessage ());
+          failedAddresses.insert (pingRequest->GetDestinationAddress());
+        }
+      else if ((iter = m_proximityPingTracker.find (expired[i])) != m_proximityPingTracker.end ())
+        {
+          Ptr<PingRequest> pingRequest = iter->second;
+          m_proximityPingTracker.erase (iter);
+          RemoveProximityCandidate (pingRequest->GetDestinationAddress());
         }
       else
         {
-          ++iter;
+          // a stabilize request of one of the virtual nodes
+          for (uint32_t v = 0; v < m_virtualNodes.size (); v++)
+            {
+              SelectVirtualNode (v);
+              if ((iter = m_stabilizeTracker.find (expired[i])) == m_stabilizeTracker.end ())
+                continue;
+              Ptr<PingRequest> stabilizeRequest = iter->second;
+              DEBUG_LOG ("Stabilize expired. Node: " << ReverseLookup (stabilizeRequest->GetDestinationAddress()) << " Timestamp: " << stabilizeRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
+              m_stabilizeTracker.erase (iter);
+              if (stabilizeRequest->GetDestinationAddress() == successor_ip_address)
+                {
+                  successorFailed[v] = true;
+                }
+              break;
+            }
+          if (m_ringSnapshotPending && expired[i] == m_ringSnapshotRun.transactionId)
+            {
+              DEBUG_LOG ("Ring snapshot stalled. Records: " << m_ringSnapshotRun.records.size ());
+              SelectVirtualNode (m_ringSnapshotRun.vnode);
+              FinishRingSnapshot ();
+              continue;
+            }
+          // or a finger bootstrap lookup of one of them
+          for (uint32_t v = 0; v < m_virtualNodes.size (); v++)
+            {
+              SelectVirtualNode (v);
+              std::map<uint32_t, FingerBootstrapRun>::iterator run = m_fingerBootstrapPending.begin ();
+              while (run != m_fingerBootstrapPending.end () && run->second.transactionId != expired[i])
+                run++;
+              if (run == m_fingerBootstrapPending.end ())
+                continue;
+              ExpireFingerBootstrapReq (run->first);
+              break;
+            }
+        }
+    }
+  for (uint32_t v = 0; v < m_virtualNodes.size (); v++)
+    {
+      SelectVirtualNode (v);
+      if (in_ring && (successorFailed[v] || failedAddresses.count (successor_ip_address) > 0))
+        {
+          PromoteSuccessor (successor_ip_address);
+        }
+      // the JOIN_REQ or its answer was lost, or the landmark was not in the ring yet
+      if (!in_ring && m_joinPending && m_joinSent.GetMilliSeconds () + m_joinTimeout.GetMilliSeconds () <= Simulator::Now ().GetMilliSeconds ())
+        {
+          DEBUG_LOG ("JOIN_REQ expired. Landmark: " << ReverseLookup (m_joinLandmark));
+          SendJoinReq ();
+        }
+      // A predecessor that stopped stabilizing is forgotten so the next live
+      // node behind us can take its place. It may have backed off to the
+      // longest stabilize period, so allow two of those.
+      if (in_ring && predecessor_node_key != ChordId () && predecessor_node_key != my_node_key &&
+          m_predecessorLastSeen.GetMilliSeconds() + 2 * m_stabilizeMaxInterval.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
+        {
+          DEBUG_LOG ("Predecessor expired. Node: " << ReverseLookup (predecessor_ip_address));
+          predecessor_ip_address = Ipv4Address ();
+          predecessor_node_key = ChordId ();
+          StabilizeChurn ();
         }
     }
   // Rechedule timer
   m_auditPingsTimer.Schedule (m_pingTimeout); 
 }
 
+void
+GUChord::ResetSuccessorList ()
+{
+  successor_list.clear ();
+  successor_list.push_back (RingNode (successor_ip_address, successor_vnode));
+}
+
+void
+GUChord::PromoteSuccessor (Ipv4Address failedAddress)
+{
+  // forget the dead node wherever we knew it from
+  RemoveProximityCandidate (failedAddress);
+  RingNode self (GetLocalAddress (), m_currentVirtualNode);
+  std::vector<RingNode>::iterator it = successor_list.begin ();
+  while (it != successor_list.end ())
+    {
+      if (it->ip_address == failedAddress || *it == self)
+        it = successor_list.erase (it);
+      else
+        it++;
+    }
+
+  // nobody left, we are alone on the ring
+  RingNode next = successor_list.empty () ? self : successor_list.front ();
+
+  CHORD_LOG ("\nSuccessorFailed<" << ReverseLookup (GetLocalAddress ()) << ">: Dead<" << ReverseLookup (failedAddress) << ">, Promoted<" << ReverseLookup (next.ip_address) << ">");
+
+  successor_id = atoi (ReverseLookup (next.ip_address).c_str ());
+  successor_ip_address = next.ip_address;
+  successor_vnode = next.vnode;
+  successor_node_key = NodeKey (next.ip_address, next.vnode);
+  if (successor_list.empty ())
+    {
+      successor_list.push_back (next);
+    }
+
+  if (predecessor_ip_address == failedAddress)
+    {
+      predecessor_ip_address = Ipv4Address ();
+      predecessor_node_key = ChordId ();
+    }
+
+  // fingers on the dead node fall back to the new successor until fixed
+  for (uint32_t i = 0; i < finger_table.size (); i++)
+    {
+      if (finger_table[i].finger_ip_address == failedAddress)
+        {
+          finger_table[i].finger_ip_address = successor_ip_address;
+          finger_table[i].finger_vnode = successor_vnode;
+          finger_table[i].finger_node_id = ReverseLookup (successor_ip_address);
+          finger_table[i].finger_key_hash = successor_node_key;
+        }
+    }
+  UpdateFingerNodes ();
+
+  m_stabilizeTracker.clear ();
+  StabilizeChurn ();
+  // the promoted node lost its predecessor too
+  SendStabilizeNotify (next.ip_address, next.vnode);
+}
+
 uint32_t
 GUChord::GetNextTransactionId ()
 {
@@ -1223,6 +2927,12 @@ GUChord::SetChordLookupCallback (Callback <void, Ipv4Address, uint32_t, std::str
    m_chordLookup = chordLookup;
 }
 
+void
+GUChord::SetChordLookupFailureCallback (Callback <void, std::string, uint32_t> chordLookupFailure)
+{
+   m_chordLookupFailure = chordLookupFailure;
+}
+
 void
 GUChord::SetChordLeaveCallback (Callback <void, Ipv4Address, uint32_t> chordLeave)
 {
@@ -1235,4 +2945,10 @@ GUChord::SetPredecessorChangeCallback (Callback <void, Ipv4Address, std::string>
    m_predChange= predChange;
 }
 
+void
+GUChord::SetKeyCountCallback (Callback <uint32_t> keyCount)
+{
+   m_keyCount = keyCount;
+}
+
 
@@ -21,7 +21,9 @@
 
 #include "ns3/gu-application.h"
 #include "ns3/gu-chord-message.h"
+#include "ns3/gu-chord-id.h"
 #include "ns3/ping-request.h"
+#include "ns3/timer-wheel.h"
 
 #include <openssl/sha.h>
 #include <stdio.h>
@@ -30,6 +32,8 @@
 #include "ns3/ipv4-address.h"
 #include <map>
 #include <set>
+#include <list>
+#include <deque>
 #include <vector>
 #include <string>
 #include "ns3/socket.h"
@@ -38,8 +42,6 @@
 #include "ns3/uinteger.h"
 #include "ns3/boolean.h"
 
-#include "gmp.h"
-
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -54,23 +56,41 @@ class GUChord : public GUApplication
     virtual ~GUChord ();
 
     void RunStabilize ();
+    void StabilizeVirtualNode ();
+    void StabilizeChurn ();
+    void SendStabilizeNotify (Ipv4Address destAddress, uint8_t vnode);
     void SendPing (Ipv4Address destAddress, std::string pingMessage);
+    void SendProximityPing (Ipv4Address destAddress);
     void RecvMessage (Ptr<Socket> socket);
     void ProcessPingReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessPingRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessJoinReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void SendJoinReq ();
     void SendJoinRsp (GUChordMessage, uint16_t);
     void ProcessJoinRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessDepartureReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessStabilizeReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessStabilizeRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessStabilizeNotify (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessRingStatePing (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessRingSnapshot (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessRingSnapshotRecord (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessFindSuccessorReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessFindSuccessorRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessLookupReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessLookupRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessFingerTableReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessFingerTableRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessIterativeLookupReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessIterativeLookupRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessLookupBatchReq (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessLookupBatchRsp (GUChordMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     
     void AuditPings ();
+    void AuditProbes ();
+    void AuditLookups ();
+    void ResetSuccessorList ();
+    void PromoteSuccessor (Ipv4Address failedAddress);
     uint32_t GetNextTransactionId ();
     void StopChord ();
 
@@ -81,30 +101,193 @@ class GUChord : public GUApplication
     
     void SetChordLookupCallback (Callback <void, Ipv4Address, uint32_t, std::string, uint32_t> chordLookup);
 
+    // Target key (hex) and transaction id of a lookup that ran out of retries
+    void SetChordLookupFailureCallback (Callback <void, std::string, uint32_t> chordLookupFailure);
+
     void SetChordLeaveCallback (Callback <void, Ipv4Address, uint32_t> chordLeave);
 
     void SetPredecessorChangeCallback (Callback <void, Ipv4Address, std::string> predChange);
 
+    // Number of keys the selected virtual node stores, for ring snapshots
+    void SetKeyCountCallback (Callback <uint32_t> keyCount);
+
     // From GUApplication
     virtual void ProcessCommand (std::vector<std::string> tokens);
        
     void FingerInit(int);
 
-    void SendChordLookup(std::string, uint32_t);
-
-    bool isSuccessor(mpz_t, mpz_t, mpz_t);
-    bool isInBetween(mpz_t, mpz_t, mpz_t);
-    
-    void FingerFix(uint32_t);
+    void SendChordLookup(ChordId, uint32_t);
+
+    /**
+     *  \brief Resolves many keys at once; each result is reported through
+     *  the lookup callback with the transaction id paired with its key
+     */
+    void SendChordLookupBatch(std::vector<ChordId>, std::vector<uint32_t>);
+
+    // Lookup transactions: deadlines, retries and completion
+    bool TrackChordLookup(ChordId, uint32_t);
+    bool CompleteChordLookup(uint32_t);
+    void IssueChordLookup(ChordId, uint32_t);
+    void DeliverChordLookupFailure(std::string, uint32_t);
+
+    // Iterative lookups: the originator probes nodes itself
+    void IterativeLookupStep(uint32_t);
+    void IterativeLookupCancel(uint32_t);
+    void IterativeLookupAddCandidate(uint32_t, Ipv4Address, uint8_t);
+
+    // Lookup result cache
+    bool LookupCacheFind(const ChordId &, uint32_t &, Ipv4Address &, ChordId &);
+    void LookupCacheInsert(const ChordId &, uint32_t, Ipv4Address, uint8_t);
+    void LookupCacheClear();
+    // Forgets the owner cached for key, once that owner turned out stale
+    void LookupCacheInvalidate(const ChordId &);
+    void DeliverChordLookup(Ipv4Address, uint32_t, std::string, uint32_t);
+
+    void FingerFix();
+
+    // Parallel finger bootstrap after join
+    void FingerBootstrap();
+    void FingerBootstrapLookups();
+    void SendFingerBootstrapReq(uint32_t, uint32_t, Ipv4Address, uint8_t);
+    void FingerBootstrapDone();
+    void ExpireFingerBootstrapReq(uint32_t);
+
+    /**
+     *  \returns Time from issuing JOIN until every finger was resolved
+     */
+    Time GetJoinRoutedTime () const;
+
+    /**
+     *  \returns Time from issuing JOIN until the JOIN_RSP placed the node
+     */
+    Time GetJoinTime () const;
+
+    /**
+     *  \returns Nodes the accepted JOIN_REQ was forwarded through
+     */
+    uint32_t GetJoinHops () const;
+
+    /**
+     *  \returns Records of the last ring snapshot, in ring order from the originator
+     */
+    std::vector<GUChordMessage::RingRecord> GetRingSnapshot () const;
 
     struct FingerTableEntry {
 
-        std::string start_value;
+        FingerTableEntry () : finger_vnode (0), stable_rounds (0), skip_rounds (0) {}
+
+        ChordId start_value;
         Ipv4Address finger_ip_address;
+        uint8_t finger_vnode;
         std::string finger_node_id;
-        std::string finger_key_hash;
+        ChordId finger_key_hash;
+        // consecutive fix rounds that confirmed the same node
+        uint32_t stable_rounds;
+        // fix rounds skipped since the last check
+        uint32_t skip_rounds;
+
+     };
+
+    // Distinct finger node, ordered by clockwise distance from this node
+    struct FingerNode {
+
+        ChordId offset;
+        ChordId key;
+        Ipv4Address ip_address;
+        uint8_t vnode;
 
      };
+
+    // A position on the ring: a node and one of its virtual nodes
+    struct RingNode {
+
+        RingNode () : vnode (0) {}
+        RingNode (Ipv4Address address, uint8_t index) : ip_address (address), vnode (index) {}
+
+        Ipv4Address ip_address;
+        uint8_t vnode;
+
+     };
+
+    /**
+     *  \brief Rebuilds m_fingerNodes; call after finger_table changes
+     */
+    void UpdateFingerNodes();
+
+    /**
+     *  \returns Index into m_fingerNodes of the closest finger preceding
+     *  target, or -1 if no finger lies in (me, target)
+     */
+    int32_t ClosestPrecedingFinger(const ChordId &target) const;
+
+    /**
+     *  \brief Remembers a node as a possible finger and measures its RTT;
+     *  at most ProximityCandidates nodes are kept per finger interval
+     */
+    void AddProximityCandidate(Ipv4Address, uint8_t);
+    void RemoveProximityCandidate(Ipv4Address);
+
+    /**
+     *  \brief Makes the given virtual node the one the ring members below
+     *  (successor, predecessor, finger_table, ...) belong to
+     *
+     *  Between events virtual node 0 is selected. Everything that selects
+     *  another one holds a VirtualNodeScope, so the members read from
+     *  outside always belong to virtual node 0, or to the virtual node a
+     *  callback is made for.
+     */
+    void SelectVirtualNode(uint8_t);
+
+    /**
+     * \brief Restores the virtual node selected when it was made
+     */
+    class VirtualNodeScope
+    {
+      public:
+        VirtualNodeScope (GUChord &chord);
+        ~VirtualNodeScope ();
+
+      private:
+        GUChord &m_chord;
+        uint8_t m_vnode;
+    };
+    friend class VirtualNodeScope;
+
+    /**
+     *  \brief Selects the virtual node that owns key or, failing that, the
+     *  one closest before it; lookups for key start from there
+     */
+    void SelectVirtualNodeFor(const ChordId &);
+
+    uint8_t GetVirtualNodeCount() const;
+
+    /**
+     *  \returns true if key lies in (predecessor, me] of the selected
+     *  virtual node. While the predecessor is unknown nothing is owned,
+     *  unless the node is its own successor
+     */
+    bool OwnsKey(const ChordId &) const;
+
+    /**
+     *  \returns true if any virtual node of this node owns key
+     */
+    bool IsLocalKey(const ChordId &);
+
+    /**
+     *  \returns true if any virtual node of this node is in the ring
+     */
+    bool IsInRing();
+
+    /**
+     *  \returns Up to count other nodes following the virtual node that
+     *  owns key, one entry per node; they hold its replicas
+     */
+    std::vector<Ipv4Address> GetReplicaSet(const ChordId &, uint32_t count);
+
+    /**
+     *  \returns Share of the ring owned by all virtual nodes of this node
+     */
+    double GetKeySpaceShare();
     
 
      // start of new Chord variables
@@ -112,8 +295,12 @@ class GUChord : public GUApplication
     uint32_t predecessor_id;
     Ipv4Address successor_ip_address;
     Ipv4Address predecessor_ip_address;
-    std::string successor_node_key_hex;
-    std::string predecessor_node_key_hex;
+    ChordId successor_node_key;
+    ChordId predecessor_node_key;
+    uint8_t successor_vnode;
+    uint8_t predecessor_vnode;
+    // successor followed by the next live nodes clockwise
+    std::vector<RingNode> successor_list;
     
     Timer stabilize_timer;
     Time stabilize_timeout;
@@ -123,7 +310,19 @@ class GUChord : public GUApplication
     bool stabilization_messages;
     int counter;
 
-    std::string my_node_key_hex;
+    ChordId my_node_key;
+
+    /**
+     *  \returns Ring identifier of the node at the given address; hashed
+     *  once per address and served from m_nodeKeyCache afterwards
+     */
+    ChordId ipHash(Ipv4Address);
+
+    /**
+     *  \returns Ring identifier of one virtual node of the node at the
+     *  given address, cached like ipHash
+     */
+    ChordId NodeKey(Ipv4Address, uint8_t);
 
   protected:
     virtual void DoDispose ();
@@ -132,23 +331,126 @@ class GUChord : public GUApplication
     virtual void StartApplication (void);
     virtual void StopApplication (void);
 
-    std::string ipHash(Ipv4Address);
-
     uint32_t m_currentTransactionId;
     Ptr<Socket> m_socket;
     Time m_pingTimeout;
     uint16_t m_appPort;
     // Timers
     Timer m_auditPingsTimer;
+    Timer m_auditProbesTimer;
+    Timer m_auditLookupsTimer;
     // Ping tracker
     std::map<uint32_t, Ptr<PingRequest> > m_pingTracker;
+    // Outstanding STABILIZE_REQ, used to detect a dead successor
+    std::map<uint32_t, Ptr<PingRequest> > m_stabilizeTracker;
+    // Deadlines of everything in the ping, stabilize and proximity trackers
+    // and of the finger bootstrap lookups
+    TimerWheel m_pingDeadlines;
+    uint32_t m_successorListSize;
+    // Round-robin finger fixing
+    uint32_t m_fingerFixCursor;
+    uint32_t m_fingerFixCount;
+    uint32_t m_fingerStableRounds;
+    // Adaptive stabilization
+    Time m_stabilizeMinInterval;
+    Time m_stabilizeMaxInterval;
+    ChordId m_lastStabilizeSuccessor;
+    ChordId m_lastStabilizePredecessor;
+    Time m_predecessorLastSeen;
+    Time m_nextStabilize;
+    // Outstanding lookups issued here, keyed by the caller's transaction id
+    struct LookupTransaction {
+        ChordId target;
+        uint32_t attempts;
+    };
+    Time m_lookupTimeout;
+    uint32_t m_lookupRetries;
+    uint32_t m_maxPendingLookups;
+    std::map<uint32_t, LookupTransaction> m_lookupTransactions;
+    TimerWheel m_lookupDeadlines;
+    // Lookup outcome counters
+    uint32_t m_lookupsIssued;
+    uint32_t m_lookupsSucceeded;
+    uint32_t m_lookupsFailed;
+    uint32_t m_lookupsRetried;
+    // Iterative lookups, keyed by the caller's transaction id
+    struct IterativeLookup {
+        ChordId target;
+        // nodes not probed yet, closest preceding target first
+        std::vector<std::pair<ChordId, RingNode> > candidates;
+        std::set<RingNode> probed;
+        // ids of this lookup's probes in m_probeTracker
+        std::set<uint32_t> probes;
+        uint32_t in_flight;
+    };
+    struct LookupProbe {
+        uint32_t lookup_id;
+        Ipv4Address destination;
+        Time timestamp;
+    };
+    bool m_iterativeLookup;
+    uint32_t m_lookupAlpha;
+    Time m_probeTimeout;
+    std::map<uint32_t, IterativeLookup> m_iterativeLookups;
+    // Probe tracker
+    std::map<uint32_t, LookupProbe> m_probeTracker;
+    TimerWheel m_probeDeadlines;
+    // Most payload bytes of one LOOKUP_BATCH_REQ or its answers
+    uint32_t m_lookupBatchSize;
+    // Lookup cache: every key in [low, owner key] is known to belong to
+    // the owner until it expires; entries are keyed by owner key, LRU order
+    // kept in a list
+    struct LookupCacheEntry {
+        ChordId low;
+        uint32_t owner_node_id;
+        Ipv4Address owner_ip_address;
+        Time expires;
+        std::list<ChordId>::iterator lru;
+    };
+    uint32_t m_lookupCacheSize;
+    Time m_lookupCacheLifetime;
+    std::map<ChordId, LookupCacheEntry> m_lookupCache;
+    std::list<ChordId> m_lookupCacheLru;
+    // Proximity neighbor selection: candidates keyed by clockwise offset
+    // from us, RTT measured with PING_REQ/PING_RSP
+    uint32_t m_proximityCandidates;
+    std::map<ChordId, RingNode> m_proximityNodes;
+    std::map<Ipv4Address, Time> m_nodeRtt;
+    std::map<uint32_t, Ptr<PingRequest> > m_proximityPingTracker;
+    // Address and virtual node to ring identifier cache
+    std::map<std::pair<Ipv4Address, uint8_t>, ChordId> m_nodeKeyCache;
     // Callbacks
     Callback <void, Ipv4Address, std::string> m_pingSuccessFn;
     Callback <void, Ipv4Address, std::string> m_pingFailureFn;
     Callback <void, Ipv4Address, std::string> m_pingRecvFn;
     Callback <void, Ipv4Address, uint32_t, std::string, uint32_t> m_chordLookup;
+    Callback <void, std::string, uint32_t> m_chordLookupFailure;
     Callback <void, Ipv4Address, uint32_t> m_chordLeave;
     Callback <void, Ipv4Address, std::string> m_predChange;
+    Callback <uint32_t> m_keyCount;
+
+    // Ring snapshot: the token goes round the ring and every position
+    // sends its record straight back. The deadline on m_pingDeadlines is
+    // pushed back by every record, so a stalled snapshot ends partial.
+    struct RingSnapshotRun {
+        RingSnapshotRun () : transactionId (0), vnode (0), positions (0), returned (false), broken (false) {}
+        uint32_t transactionId;
+        uint8_t vnode;
+        // known once the token is back
+        uint32_t positions;
+        bool returned;
+        bool broken;
+        std::map<uint32_t, GUChordMessage::RingRecord> records;
+    };
+    GUChordMessage::RingRecord MakeRingRecord ();
+    void FinishRingSnapshot ();
+    bool m_ringSnapshotPending;
+    RingSnapshotRun m_ringSnapshotRun;
+    Time m_ringSnapshotTimeout;
+    // tokens passed on lately, "originator#vnode:transaction@vnode", so a
+    // ring looping short of the originator is noticed
+    std::deque<std::string> m_ringSnapshotsSeen;
+    std::vector<GUChordMessage::RingRecord> m_ringSnapshot;
     
 
     /*// start of new Chord variables
@@ -171,9 +473,98 @@ class GUChord : public GUApplication
 
     //std::map<std::string, FingerInfo> finger_table;
     std::vector<FingerTableEntry> finger_table;
+    std::vector<FingerNode> m_fingerNodes;
+
+    // Finger bootstrap state
+    bool m_parallelFingerInit;
+    bool m_fingerBootstrapping;
+    bool m_fingerSeedPending;
+    // an outstanding lookup, its deadline is on m_pingDeadlines
+    struct FingerBootstrapRun {
+        // last finger index the answer may cover
+        uint32_t last;
+        uint32_t transactionId;
+        uint32_t attempts;
+    };
+    // first finger index of an outstanding lookup -> its run
+    std::map<uint32_t, FingerBootstrapRun> m_fingerBootstrapPending;
+    uint32_t m_fingerBootstrapLookups;
+    Time m_joinStart;
+    Time m_joinRoutedTime;
+    Time m_joinTime;
+    uint32_t m_joinHops;
+    // JOIN_REQ outstanding, resent after m_joinTimeout without an answer
+    bool m_joinPending;
+    Time m_joinSent;
+    Time m_joinTimeout;
+    uint32_t m_joinLandmarkId;
+    Ipv4Address m_joinLandmark;
+
+    // Virtual nodes: every one has its own ring position and ring state.
+    // The selected one lives in the members above, the others are parked
+    // here and swapped in by SelectVirtualNode.
+    struct VirtualNode {
+        VirtualNode () : successor_id (0), predecessor_id (0), successor_vnode (0), predecessor_vnode (0),
+                         in_ring (false), finger_fix_cursor (1), finger_bootstrapping (false),
+                         finger_seed_pending (false), finger_bootstrap_lookups (0), join_hops (0),
+                         join_pending (false) {}
+        uint32_t successor_id;
+        uint32_t predecessor_id;
+        Ipv4Address successor_ip_address;
+        Ipv4Address predecessor_ip_address;
+        ChordId successor_node_key;
+        ChordId predecessor_node_key;
+        uint8_t successor_vnode;
+        uint8_t predecessor_vnode;
+        std::vector<RingNode> successor_list;
+        Time stabilize_timeout;
+        bool in_ring;
+        ChordId my_node_key;
+        std::map<uint32_t, Ptr<PingRequest> > stabilize_tracker;
+        uint32_t finger_fix_cursor;
+        ChordId last_stabilize_successor;
+        ChordId last_stabilize_predecessor;
+        Time predecessor_last_seen;
+        Time next_stabilize;
+        std::vector<FingerTableEntry> finger_table;
+        std::vector<FingerNode> finger_nodes;
+        std::map<ChordId, RingNode> proximity_nodes;
+        bool finger_bootstrapping;
+        bool finger_seed_pending;
+        std::map<uint32_t, FingerBootstrapRun> finger_bootstrap_pending;
+        uint32_t finger_bootstrap_lookups;
+        Time join_start;
+        Time join_routed_time;
+        Time join_time;
+        uint32_t join_hops;
+        bool join_pending;
+        Time join_sent;
+    };
+    void SwapVirtualNode(VirtualNode &);
+    uint32_t m_virtualNodeCount;
+    std::vector<VirtualNode> m_virtualNodes;
+    uint8_t m_currentVirtualNode;
 
 };
 
+inline bool
+operator== (const GUChord::RingNode &a, const GUChord::RingNode &b)
+{
+  return a.ip_address == b.ip_address && a.vnode == b.vnode;
+}
+
+inline bool
+operator!= (const GUChord::RingNode &a, const GUChord::RingNode &b)
+{
+  return !(a == b);
+}
+
+inline bool
+operator< (const GUChord::RingNode &a, const GUChord::RingNode &b)
+{
+  return a.ip_address < b.ip_address || (a.ip_address == b.ip_address && a.vnode < b.vnode);
+}
+
 #endif
 
 
@@ -67,6 +67,7 @@ GUSearchMessage::GetSerializedSize (void) const
         size += m_message.pingRsp.GetSerializedSize ();
         break;
       case STORE_REQ:
+      case STORE_MISS:
         size += m_message.storeReq.GetSerializedSize ();
         break;  
       case FETCH_REQ:
@@ -75,6 +76,21 @@ GUSearchMessage::GetSerializedSize (void) const
       case FETCH_RSP:
         size += m_message.fetchRsp.GetSerializedSize ();
         break;
+      case HANDOFF_REQ:
+        size += m_message.handoffReq.GetSerializedSize ();
+        break;
+      case HANDOFF_RSP:
+        size += m_message.handoffRsp.GetSerializedSize ();
+        break;
+      case REPLICA_SET_REQ:
+        size += m_message.replicaSetReq.GetSerializedSize ();
+        break;
+      case REPLICA_SET_RSP:
+        size += m_message.replicaSetRsp.GetSerializedSize ();
+        break;
+      case FETCH_ACK:
+        size += m_message.fetchAck.GetSerializedSize ();
+        break;
       default:
         NS_ASSERT (false);
     }
@@ -98,6 +114,7 @@ GUSearchMessage::Print (std::ostream &os) const
         m_message.pingRsp.Print (os);
         break;
       case STORE_REQ:
+      case STORE_MISS:
         m_message.storeReq.Print (os);
         break;  
       case FETCH_REQ:
@@ -106,6 +123,21 @@ GUSearchMessage::Print (std::ostream &os) const
       case FETCH_RSP:
         m_message.fetchRsp.Print (os);
         break;        
+      case HANDOFF_REQ:
+        m_message.handoffReq.Print (os);
+        break;
+      case HANDOFF_RSP:
+        m_message.handoffRsp.Print (os);
+        break;
+      case REPLICA_SET_REQ:
+        m_message.replicaSetReq.Print (os);
+        break;
+      case REPLICA_SET_RSP:
+        m_message.replicaSetRsp.Print (os);
+        break;
+      case FETCH_ACK:
+        m_message.fetchAck.Print (os);
+        break;
       default:
         break;  
     }
@@ -128,6 +160,7 @@ GUSearchMessage::Serialize (Buffer::Iterator start) const
         m_message.pingRsp.Serialize (i);
         break;
       case STORE_REQ:
+      case STORE_MISS:
         m_message.storeReq.Serialize (i);
         break;  
       case FETCH_REQ:
@@ -136,6 +169,21 @@ GUSearchMessage::Serialize (Buffer::Iterator start) const
       case FETCH_RSP:
         m_message.fetchRsp.Serialize (i);
         break;         
+      case HANDOFF_REQ:
+        m_message.handoffReq.Serialize (i);
+        break;
+      case HANDOFF_RSP:
+        m_message.handoffRsp.Serialize (i);
+        break;
+      case REPLICA_SET_REQ:
+        m_message.replicaSetReq.Serialize (i);
+        break;
+      case REPLICA_SET_RSP:
+        m_message.replicaSetRsp.Serialize (i);
+        break;
+      case FETCH_ACK:
+        m_message.fetchAck.Serialize (i);
+        break;
       default:
         NS_ASSERT (false);   
     }
@@ -160,6 +208,7 @@ GUSearchMessage::Deserialize (Buffer::Iterator start)
         size += m_message.pingRsp.Deserialize (i);
         break;
       case STORE_REQ:
+      case STORE_MISS:
         size += m_message.storeReq.Deserialize (i);
         break;  
       case FETCH_REQ:
@@ -168,6 +217,21 @@ GUSearchMessage::Deserialize (Buffer::Iterator start)
       case FETCH_RSP:
         size += m_message.fetchRsp.Deserialize (i);
         break;
+      case HANDOFF_REQ:
+        size += m_message.handoffReq.Deserialize (i);
+        break;
+      case HANDOFF_RSP:
+        size += m_message.handoffRsp.Deserialize (i);
+        break;
+      case REPLICA_SET_REQ:
+        size += m_message.replicaSetReq.Deserialize (i);
+        break;
+      case REPLICA_SET_RSP:
+        size += m_message.replicaSetRsp.Deserialize (i);
+        break;
+      case FETCH_ACK:
+        size += m_message.fetchAck.Deserialize (i);
+        break;
       default:
         NS_ASSERT (false);
     }
@@ -287,7 +351,7 @@ uint32_t
 GUSearchMessage::StoreReq::GetSerializedSize (void) const
 {
   uint32_t size;
-  size = sizeof(uint16_t) + key.length();
+  size = sizeof(uint16_t) + key.length() + sizeof(uint8_t);
   size += sizeof(uint32_t);
   for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
     size += sizeof(uint16_t);
@@ -312,6 +376,7 @@ GUSearchMessage::StoreReq::Serialize (Buffer::Iterator &start) const
   //Print(std::cout);
   start.WriteU16 (key.length ());
   start.Write ((uint8_t *) (const_cast<char*> (key.c_str())), key.length());
+  start.WriteU8 (replica);
   
   start.WriteHtonU32(documents.size());
   
@@ -329,6 +394,7 @@ GUSearchMessage::StoreReq::Deserialize (Buffer::Iterator &start)
   start.Read ((uint8_t*)str, length);
   key = std::string (str, length);
   free (str);
+  replica = start.ReadU8 ();
   
   uint32_t dlen = start.ReadNtohU32();
   for (uint32_t i = 0; i < dlen; i++) {
@@ -345,7 +411,7 @@ GUSearchMessage::StoreReq::Deserialize (Buffer::Iterator &start)
 }
 
 void
-GUSearchMessage::SetStoreReq (std::string key, std::set<std::string> documents)
+GUSearchMessage::SetStoreReq (std::string key, std::set<std::string> documents, bool replica)
 {
   if (m_messageType == 0)
     {
@@ -357,6 +423,7 @@ GUSearchMessage::SetStoreReq (std::string key, std::set<std::string> documents)
     }
   m_message.storeReq.key = key;
   m_message.storeReq.documents = documents;
+  m_message.storeReq.replica = replica ? 1 : 0;
 }
 
 GUSearchMessage::StoreReq
@@ -365,38 +432,92 @@ GUSearchMessage::GetStoreReq ()
   return m_message.storeReq;
 }
 
+/* STORE_MISS, a STORE_REQ sent back */
+void
+GUSearchMessage::SetStoreMiss (std::string key, std::set<std::string> documents)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = STORE_MISS;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == STORE_MISS);
+    }
+  m_message.storeReq.key = key;
+  m_message.storeReq.documents = documents;
+  m_message.storeReq.replica = 0;
+}
+
+GUSearchMessage::StoreReq
+GUSearchMessage::GetStoreMiss ()
+{
+  return m_message.storeReq;
+}
+
 
 /* FETCH_REQ */
+static uint32_t
+GetCardinalitiesSize (const GUSearchMessage::Cardinalities &cardinalities)
+{
+  uint32_t size = sizeof(uint32_t);
+  for (GUSearchMessage::Cardinalities::const_iterator it = cardinalities.begin(); it != cardinalities.end(); it++) {
+    size += sizeof(uint16_t) + it->first.length() + sizeof(uint32_t);
+  }
+  return size;
+}
+
+static void
+WriteCardinalities (Buffer::Iterator &start, const GUSearchMessage::Cardinalities &cardinalities)
+{
+  start.WriteHtonU32(cardinalities.size());
+  for (GUSearchMessage::Cardinalities::const_iterator it = cardinalities.begin(); it != cardinalities.end(); it++) {
+    start.WriteU16 (it->first.length());
+    start.Write ((uint8_t *) (const_cast<char*> (it->first.c_str())), it->first.length());
+    start.WriteHtonU32(it->second);
+  }
+}
+
+static void
+ReadCardinalities (Buffer::Iterator &start, GUSearchMessage::Cardinalities &cardinalities)
+{
+  uint32_t clen = start.ReadNtohU32();
+  for (uint32_t i = 0; i < clen; i++) {
+    uint16_t length = start.ReadU16 ();
+    char* str = (char*) malloc (length);
+    start.Read ((uint8_t*)str, length);
+    std::string key (str, length);
+    free (str);
+    cardinalities[key] = start.ReadNtohU32();
+  }
+}
+
 uint32_t 
 GUSearchMessage::FetchReq::GetSerializedSize (void) const
 {
   uint32_t size = 0;
-  size += sizeof(uint32_t);
+  size += 2 * sizeof(uint32_t);
   size += sizeof(uint16_t) + key.length();
   
   size += sizeof(uint32_t);
-  for (std::set<std::string>::iterator it = searchKeys.begin(); it != searchKeys.end(); it++) {
+  for (std::vector<std::string>::const_iterator it = searchKeys.begin(); it != searchKeys.end(); it++) {
     size += sizeof(uint16_t);
     size += (*it).length();
   }
   
-  size += sizeof(uint32_t);
-  for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
-    size += sizeof(uint16_t);
-    size += (*it).length();
-  }
+  std::vector<uint8_t> encoded;
+  EncodeNames (documents, encoded);
+  size += 2 * sizeof(uint32_t) + encoded.size();
+  size += GetCardinalitiesSize (cardinalities);
   return size;
 }
 
 void
 GUSearchMessage::FetchReq::Print (std::ostream &os) const
 {
-  os << "FetchReq:: OriginatorNum: " << originatorNum << " Key: " << key << " Documents: " ; 
-  for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
-    os << *it << ", ";
-  }
+  os << "FetchReq:: OriginatorNum: " << originatorNum << " QueryId: " << queryId << " Key: " << key << " Documents: " << documents.size();
   os << " Search Keys: ";
-  for (std::set<std::string>::iterator it = searchKeys.begin(); it != searchKeys.end(); it++) {
+  for (std::vector<std::string>::const_iterator it = searchKeys.begin(); it != searchKeys.end(); it++) {
     os << *it << ", ";
   }
   os << "\n";
@@ -406,29 +527,32 @@ void
 GUSearchMessage::FetchReq::Serialize (Buffer::Iterator &start) const
 {
   start.WriteHtonU32(originatorNum);
+  start.WriteHtonU32(queryId);
   
   start.WriteU16 (key.length ());
   start.Write ((uint8_t *) (const_cast<char*> (key.c_str())), key.length());
   
   start.WriteHtonU32(searchKeys.size());
   
-  for (std::set<std::string>::iterator it = searchKeys.begin(); it != searchKeys.end(); it++) {
+  for (std::vector<std::string>::const_iterator it = searchKeys.begin(); it != searchKeys.end(); it++) {
     start.WriteU16 ((*it).length());
     start.Write ((uint8_t *) (const_cast<char*> ((*it).c_str())), (*it).length());
   }
   
+  std::vector<uint8_t> encoded;
+  EncodeNames (documents, encoded);
   start.WriteHtonU32(documents.size());
-  
-  for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
-    start.WriteU16 ((*it).length());
-    start.Write ((uint8_t *) (const_cast<char*> ((*it).c_str())), (*it).length());
-  }
+  start.WriteHtonU32(encoded.size());
+  if (!encoded.empty())
+    start.Write (&encoded[0], encoded.size());
+  WriteCardinalities (start, cardinalities);
 }
 
 uint32_t
 GUSearchMessage::FetchReq::Deserialize (Buffer::Iterator &start)
 {  
   originatorNum = start.ReadNtohU32();
+  queryId = start.ReadNtohU32();
   
   uint16_t length = start.ReadU16 ();
   char* str = (char*) malloc (length);
@@ -441,24 +565,23 @@ GUSearchMessage::FetchReq::Deserialize (Buffer::Iterator &start)
     uint16_t length = start.ReadU16 ();
     char* str = (char*) malloc (length);
     start.Read ((uint8_t*)str, length);
-    searchKeys.insert(std::string (str, length));
+    searchKeys.push_back(std::string (str, length));
     free (str);
   }
   
-  dlen = start.ReadNtohU32();
-  for (uint32_t i = 0; i < dlen; i++) {
-    uint16_t length = start.ReadU16 ();
-    char* str = (char*) malloc (length);
-    start.Read ((uint8_t*)str, length);
-    documents.insert(std::string (str, length));
-    free (str);
-  }
+  uint32_t count = start.ReadNtohU32();
+  std::vector<uint8_t> encoded (start.ReadNtohU32());
+  if (!encoded.empty())
+    start.Read (&encoded[0], encoded.size());
+  DecodeNames (encoded, count, documents);
+  ReadCardinalities (start, cardinalities);
   
   return FetchReq::GetSerializedSize ();
 }
 
 void
-GUSearchMessage::SetFetchReq (uint32_t originatorNum, std::string key, std::set<std::string> searchKeys, std::set<std::string> documents)
+GUSearchMessage::SetFetchReq (uint32_t originatorNum, uint32_t queryId, std::string key, std::vector<std::string> searchKeys, const std::set<std::string> &documents,
+                              const Cardinalities &cardinalities)
 {
   if (m_messageType == 0)
     {
@@ -469,9 +592,11 @@ GUSearchMessage::SetFetchReq (uint32_t originatorNum, std::string key, std::set<
       NS_ASSERT (m_messageType == FETCH_REQ);
     }
   m_message.fetchReq.originatorNum = originatorNum ;
+  m_message.fetchReq.queryId = queryId;
   m_message.fetchReq.key = key;
   m_message.fetchReq.searchKeys = searchKeys;
   m_message.fetchReq.documents = documents;
+  m_message.fetchReq.cardinalities = cardinalities;
 }
 
 GUSearchMessage::FetchReq
@@ -485,18 +610,19 @@ uint32_t
 GUSearchMessage::FetchRsp::GetSerializedSize (void) const
 {
   uint32_t size = 0;
-  size += sizeof(uint32_t);
+  size += 2 * sizeof(uint32_t);
   for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
     size += sizeof(uint16_t);
     size += (*it).length();
   }
+  size += GetCardinalitiesSize (cardinalities);
   return size;
 }
 
 void
 GUSearchMessage::FetchRsp::Print (std::ostream &os) const
 {
-  os << "FetchRsp:: Documents: " ; 
+  os << "FetchRsp:: QueryId: " << queryId << " Documents: " ; 
   for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
     os << *it << ", ";
   }
@@ -506,17 +632,20 @@ GUSearchMessage::FetchRsp::Print (std::ostream &os) const
 void
 GUSearchMessage::FetchRsp::Serialize (Buffer::Iterator &start) const
 { 
+  start.WriteHtonU32(queryId);
   start.WriteHtonU32(documents.size());
   
   for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
     start.WriteU16 ((*it).length());
     start.Write ((uint8_t *) (const_cast<char*> ((*it).c_str())), (*it).length());
   }
+  WriteCardinalities (start, cardinalities);
 }
 
 uint32_t
 GUSearchMessage::FetchRsp::Deserialize (Buffer::Iterator &start)
 {  
+  queryId = start.ReadNtohU32();
   uint32_t dlen = start.ReadNtohU32();
   for (uint32_t  i = 0; i < dlen; i++) {
     uint16_t length = start.ReadU16 ();
@@ -525,12 +654,13 @@ GUSearchMessage::FetchRsp::Deserialize (Buffer::Iterator &start)
     documents.insert(std::string (str, length));
     free (str);
   }
+  ReadCardinalities (start, cardinalities);
   
   return FetchRsp::GetSerializedSize ();
 }
 
 void
-GUSearchMessage::SetFetchRsp (std::set<std::string> documents)
+GUSearchMessage::SetFetchRsp (uint32_t queryId, std::set<std::string> documents, const Cardinalities &cardinalities)
 {
   if (m_messageType == 0)
     {
@@ -540,7 +670,9 @@ GUSearchMessage::SetFetchRsp (std::set<std::string> documents)
     {
       NS_ASSERT (m_messageType == FETCH_RSP);
     }
+  m_message.fetchRsp.queryId = queryId;
   m_message.fetchRsp.documents = documents;
+  m_message.fetchRsp.cardinalities = cardinalities;
 }
 
 GUSearchMessage::FetchRsp
@@ -549,6 +681,257 @@ GUSearchMessage::GetFetchRsp ()
   return m_message.fetchRsp;
 }
 
+/* HANDOFF_REQ */
+uint32_t 
+GUSearchMessage::HandoffReq::GetSerializedSize (void) const
+{
+  uint32_t size = 0;
+  size += 3 * sizeof(uint32_t);
+  for (std::map<std::string, std::set<std::string> >::const_iterator it = entries.begin(); it != entries.end(); it++) {
+    size += sizeof(uint16_t) + it->first.length();
+    size += sizeof(uint32_t);
+    for (std::set<std::string>::const_iterator doc = it->second.begin(); doc != it->second.end(); doc++) {
+      size += sizeof(uint16_t);
+      size += (*doc).length();
+    }
+  }
+  return size;
+}
+
+void
+GUSearchMessage::HandoffReq::Print (std::ostream &os) const
+{
+  os << "HandoffReq:: Chunk: " << chunk + 1 << "/" << chunks << " Keys: " << entries.size() << "\n";
+}
+
+void
+GUSearchMessage::HandoffReq::Serialize (Buffer::Iterator &start) const
+{ 
+  start.WriteHtonU32(chunk);
+  start.WriteHtonU32(chunks);
+  start.WriteHtonU32(entries.size());
+
+  for (std::map<std::string, std::set<std::string> >::const_iterator it = entries.begin(); it != entries.end(); it++) {
+    start.WriteU16 (it->first.length());
+    start.Write ((uint8_t *) (const_cast<char*> (it->first.c_str())), it->first.length());
+    start.WriteHtonU32(it->second.size());
+    for (std::set<std::string>::const_iterator doc = it->second.begin(); doc != it->second.end(); doc++) {
+      start.WriteU16 ((*doc).length());
+      start.Write ((uint8_t *) (const_cast<char*> ((*doc).c_str())), (*doc).length());
+    }
+  }
+}
+
+uint32_t
+GUSearchMessage::HandoffReq::Deserialize (Buffer::Iterator &start)
+{  
+  chunk = start.ReadNtohU32();
+  chunks = start.ReadNtohU32();
+  uint32_t klen = start.ReadNtohU32();
+  for (uint32_t i = 0; i < klen; i++) {
+    uint16_t length = start.ReadU16 ();
+    char* str = (char*) malloc (length);
+    start.Read ((uint8_t*)str, length);
+    std::set<std::string> &documents = entries[std::string (str, length)];
+    free (str);
+
+    uint32_t dlen = start.ReadNtohU32();
+    for (uint32_t j = 0; j < dlen; j++) {
+      uint16_t length = start.ReadU16 ();
+      char* str = (char*) malloc (length);
+      start.Read ((uint8_t*)str, length);
+      documents.insert(std::string (str, length));
+      free (str);
+    }
+  }
+  
+  return HandoffReq::GetSerializedSize ();
+}
+
+void
+GUSearchMessage::SetHandoffReq (uint32_t chunk, uint32_t chunks, std::map<std::string, std::set<std::string> > entries)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = HANDOFF_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == HANDOFF_REQ);
+    }
+  m_message.handoffReq.chunk = chunk;
+  m_message.handoffReq.chunks = chunks;
+  m_message.handoffReq.entries = entries;
+}
+
+GUSearchMessage::HandoffReq
+GUSearchMessage::GetHandoffReq ()
+{
+  return m_message.handoffReq;
+}
+
+/* HANDOFF_RSP */
+uint32_t 
+GUSearchMessage::HandoffRsp::GetSerializedSize (void) const
+{
+  return sizeof(uint32_t);
+}
+
+void
+GUSearchMessage::HandoffRsp::Print (std::ostream &os) const
+{
+  os << "HandoffRsp:: Chunk: " << chunk + 1 << "\n";
+}
+
+void
+GUSearchMessage::HandoffRsp::Serialize (Buffer::Iterator &start) const
+{ 
+  start.WriteHtonU32(chunk);
+}
+
+uint32_t
+GUSearchMessage::HandoffRsp::Deserialize (Buffer::Iterator &start)
+{  
+  chunk = start.ReadNtohU32();
+  return HandoffRsp::GetSerializedSize ();
+}
+
+void
+GUSearchMessage::SetHandoffRsp (uint32_t chunk)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = HANDOFF_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == HANDOFF_RSP);
+    }
+  m_message.handoffRsp.chunk = chunk;
+}
+
+GUSearchMessage::HandoffRsp
+GUSearchMessage::GetHandoffRsp ()
+{
+  return m_message.handoffRsp;
+}
+
+/* REPLICA_SET_REQ */
+uint32_t 
+GUSearchMessage::ReplicaSetReq::GetSerializedSize (void) const
+{
+  return sizeof(uint16_t) + key.length();
+}
+
+void
+GUSearchMessage::ReplicaSetReq::Print (std::ostream &os) const
+{
+  os << "ReplicaSetReq:: Key: " << key << "\n";
+}
+
+void
+GUSearchMessage::ReplicaSetReq::Serialize (Buffer::Iterator &start) const
+{ 
+  start.WriteU16 (key.length ());
+  start.Write ((uint8_t *) (const_cast<char*> (key.c_str())), key.length());
+}
+
+uint32_t
+GUSearchMessage::ReplicaSetReq::Deserialize (Buffer::Iterator &start)
+{  
+  uint16_t length = start.ReadU16 ();
+  char* str = (char*) malloc (length);
+  start.Read ((uint8_t*)str, length);
+  key = std::string (str, length);
+  free (str);
+  return ReplicaSetReq::GetSerializedSize ();
+}
+
+void
+GUSearchMessage::SetReplicaSetReq (std::string key)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = REPLICA_SET_REQ;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == REPLICA_SET_REQ);
+    }
+  m_message.replicaSetReq.key = key;
+}
+
+GUSearchMessage::ReplicaSetReq
+GUSearchMessage::GetReplicaSetReq ()
+{
+  return m_message.replicaSetReq;
+}
+
+/* REPLICA_SET_RSP */
+uint32_t 
+GUSearchMessage::ReplicaSetRsp::GetSerializedSize (void) const
+{
+  return sizeof(uint16_t) + key.length() + sizeof(uint16_t) + replicas.size() * IPV4_ADDRESS_SIZE;
+}
+
+void
+GUSearchMessage::ReplicaSetRsp::Print (std::ostream &os) const
+{
+  os << "ReplicaSetRsp:: Key: " << key << " Replicas: ";
+  for (uint32_t i = 0; i < replicas.size(); i++) {
+    os << replicas[i] << ", ";
+  }
+  os << "\n";
+}
+
+void
+GUSearchMessage::ReplicaSetRsp::Serialize (Buffer::Iterator &start) const
+{ 
+  start.WriteU16 (key.length ());
+  start.Write ((uint8_t *) (const_cast<char*> (key.c_str())), key.length());
+  start.WriteU16 (replicas.size());
+  for (uint32_t i = 0; i < replicas.size(); i++) {
+    start.WriteHtonU32 (replicas[i].Get());
+  }
+}
+
+uint32_t
+GUSearchMessage::ReplicaSetRsp::Deserialize (Buffer::Iterator &start)
+{  
+  uint16_t length = start.ReadU16 ();
+  char* str = (char*) malloc (length);
+  start.Read ((uint8_t*)str, length);
+  key = std::string (str, length);
+  free (str);
+  uint16_t count = start.ReadU16 ();
+  replicas.clear ();
+  for (uint16_t i = 0; i < count; i++) {
+    replicas.push_back (Ipv4Address (start.ReadNtohU32 ()));
+  }
+  return ReplicaSetRsp::GetSerializedSize ();
+}
+
+void
+GUSearchMessage::SetReplicaSetRsp (std::string key, std::vector<Ipv4Address> replicas)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = REPLICA_SET_RSP;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == REPLICA_SET_RSP);
+    }
+  m_message.replicaSetRsp.key = key;
+  m_message.replicaSetRsp.replicas = replicas;
+}
+
+GUSearchMessage::ReplicaSetRsp
+GUSearchMessage::GetReplicaSetRsp ()
+{
+  return m_message.replicaSetRsp;
+}
+
 
 //
 //
@@ -578,3 +961,54 @@ GUSearchMessage::GetTransactionId (void) const
   return m_transactionId;
 }
 
+
+/* FETCH_ACK */
+uint32_t 
+GUSearchMessage::FetchAck::GetSerializedSize (void) const
+{
+  return sizeof(uint16_t) + key.length();
+}
+
+void
+GUSearchMessage::FetchAck::Print (std::ostream &os) const
+{
+  os << "FetchAck:: Key: " << key << "\n";
+}
+
+void
+GUSearchMessage::FetchAck::Serialize (Buffer::Iterator &start) const
+{ 
+  start.WriteU16 (key.length ());
+  start.Write ((uint8_t *) (const_cast<char*> (key.c_str())), key.length());
+}
+
+uint32_t
+GUSearchMessage::FetchAck::Deserialize (Buffer::Iterator &start)
+{  
+  uint16_t length = start.ReadU16 ();
+  char* str = (char*) malloc (length);
+  start.Read ((uint8_t*)str, length);
+  key = std::string (str, length);
+  free (str);
+  return FetchAck::GetSerializedSize ();
+}
+
+void
+GUSearchMessage::SetFetchAck (std::string key)
+{
+  if (m_messageType == 0)
+    {
+      m_messageType = FETCH_ACK;
+    }
+  else
+    {
+      NS_ASSERT (m_messageType == FETCH_ACK);
+    }
+  m_message.fetchAck.key = key;
+}
+
+GUSearchMessage::FetchAck
+GUSearchMessage::GetFetchAck ()
+{
+  return m_message.fetchAck;
+}
@@ -21,7 +21,10 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/packet.h"
 #include "ns3/object.h"
+#include "ns3/search-index.h"
 #include <set>
+#include <map>
+#include <vector>
 
 using namespace ns3;
 
@@ -41,6 +44,12 @@ class GUSearchMessage : public Header
         STORE_REQ = 3,
         FETCH_REQ = 4,
         FETCH_RSP = 5,
+        HANDOFF_REQ = 6,
+        HANDOFF_RSP = 7,
+        REPLICA_SET_REQ = 8,
+        REPLICA_SET_RSP = 9,
+        FETCH_ACK = 10,
+        STORE_MISS = 11,
         // Define extra message types when needed       
       };
 
@@ -115,7 +124,12 @@ class GUSearchMessage : public Header
         // Payload
         std::string key;
         std::set<std::string> documents;
+        // 1 on the copies the owner sends to its replicas
+        uint8_t replica;
       };
+    // posting-list length of each key, as seen by the node owning it
+    typedef std::map<std::string, uint32_t> Cardinalities;
+
     struct FetchReq
       {
         void Print (std::ostream &os) const;
@@ -124,9 +138,16 @@ class GUSearchMessage : public Header
         uint32_t Deserialize (Buffer::Iterator &start);
         // Payload
         uint32_t originatorNum;
+        // set by the node the search entered through, the originator keeps
+        // the first answer to each query
+        uint32_t queryId;
         std::string key;
-        std::set<std::string> searchKeys;
+        // keys still to look up, in the order they are visited
+        std::vector<std::string> searchKeys;
+        // documents matching the keys looked up so far, front coded on the
+        // wire, see EncodeNames
         std::set<std::string> documents;
+        Cardinalities cardinalities;
       };
 
     struct FetchRsp
@@ -136,9 +157,68 @@ class GUSearchMessage : public Header
         void Serialize (Buffer::Iterator &start) const;
         uint32_t Deserialize (Buffer::Iterator &start);
         // Payload
+        uint32_t queryId;
         std::set<std::string> documents;
+        // gathered along the chain, for the originator's next plans
+        Cardinalities cardinalities;
       };  
 
+    // one chunk of the keys a leaving node hands to its successor
+    struct HandoffReq
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Payload
+        uint32_t chunk;
+        uint32_t chunks;
+        std::map<std::string, std::set<std::string> > entries;
+      };
+
+    struct HandoffRsp
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Payload
+        uint32_t chunk;
+      };
+
+    // asks the owner of key which nodes hold replicas of it
+    struct ReplicaSetReq
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Payload
+        std::string key;
+      };
+
+    struct ReplicaSetRsp
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Payload
+        std::string key;
+        std::vector<Ipv4Address> replicas;
+      };
+
+    // tells the sender of a FETCH_REQ that the chain goes on from here
+    struct FetchAck
+      {
+        void Print (std::ostream &os) const;
+        uint32_t GetSerializedSize (void) const;
+        void Serialize (Buffer::Iterator &start) const;
+        uint32_t Deserialize (Buffer::Iterator &start);
+        // Payload
+        std::string key;
+      };
+
   private:
     struct
       {
@@ -147,6 +227,11 @@ class GUSearchMessage : public Header
         StoreReq storeReq;
         FetchReq fetchReq;
         FetchRsp fetchRsp;
+        HandoffReq handoffReq;
+        HandoffRsp handoffRsp;
+        ReplicaSetReq replicaSetReq;
+        ReplicaSetRsp replicaSetRsp;
+        FetchAck fetchAck;
       } m_message;
     
   public:
@@ -181,8 +266,19 @@ class GUSearchMessage : public Header
     /**
      *  \brief Sets StoreReq message params
      *  \param key 
+     *  \param replica true on a copy sent to a replica
      */
-    void SetStoreReq (std::string key, std::set<std::string> documents);
+    void SetStoreReq (std::string key, std::set<std::string> documents, bool replica = false);
+
+    /**
+     *  \returns the StoreReq a node not owning its key sent back
+     */
+    StoreReq GetStoreMiss ();
+
+    /**
+     *  \brief Sets STORE_MISS message params, the StoreReq being returned
+     */
+    void SetStoreMiss (std::string key, std::set<std::string> documents);
     
     /**
      *  \returns PingReq Struct
@@ -194,7 +290,8 @@ class GUSearchMessage : public Header
      *  \param message Payload String
      */
 
-    void SetFetchReq (uint32_t originatorNum, std::string key, std::set<std::string> searchKeys, std::set<std::string> documents);
+    void SetFetchReq (uint32_t originatorNum, uint32_t queryId, std::string key, std::vector<std::string> searchKeys, const std::set<std::string> &documents,
+                      const Cardinalities &cardinalities);
     /**
      * \returns PingRsp Struct
      */
@@ -203,7 +300,60 @@ class GUSearchMessage : public Header
      *  \brief Sets FetchRsp message params
      *  \param message Payload String
      */
-    void SetFetchRsp (std::set<std::string> documents);
+    void SetFetchRsp (uint32_t queryId, std::set<std::string> documents, const Cardinalities &cardinalities);
+
+    /**
+     *  \returns HandoffReq Struct
+     */
+    HandoffReq GetHandoffReq ();
+    /**
+     *  \brief Sets HandoffReq message params
+     *  \param chunk index of this chunk in the transfer
+     *  \param chunks number of chunks in the transfer
+     *  \param entries keys and their documents
+     */
+    void SetHandoffReq (uint32_t chunk, uint32_t chunks, std::map<std::string, std::set<std::string> > entries);
+
+    /**
+     *  \returns HandoffRsp Struct
+     */
+    HandoffRsp GetHandoffRsp ();
+    /**
+     *  \brief Sets HandoffRsp message params
+     *  \param chunk index of the acknowledged chunk
+     */
+    void SetHandoffRsp (uint32_t chunk);
+
+    /**
+     *  \returns ReplicaSetReq Struct
+     */
+    ReplicaSetReq GetReplicaSetReq ();
+    /**
+     *  \brief Sets ReplicaSetReq message params
+     *  \param key term whose replicas are asked for
+     */
+    void SetReplicaSetReq (std::string key);
+
+    /**
+     *  \returns ReplicaSetRsp Struct
+     */
+    ReplicaSetRsp GetReplicaSetRsp ();
+    /**
+     *  \brief Sets ReplicaSetRsp message params
+     *  \param key term the replicas hold
+     *  \param replicas nodes holding a copy besides the owner
+     */
+    void SetReplicaSetRsp (std::string key, std::vector<Ipv4Address> replicas);
+
+    /**
+     *  \returns FetchAck Struct
+     */
+    FetchAck GetFetchAck ();
+    /**
+     *  \brief Sets FetchAck message params
+     *  \param key term of the acknowledged FETCH_REQ
+     */
+    void SetFetchAck (std::string key);
 
 }; // class GUSearchMessage
 
@@ -24,6 +24,13 @@
 #include <sstream>
 #include <ios>
 #include <iomanip>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "ns3/random-variable.h"
 #include "ns3/inet-socket-address.h"
 
@@ -50,14 +57,43 @@ GUSearch::GetTypeId ()
                    TimeValue (MilliSeconds (2000)),
                    MakeTimeAccessor (&GUSearch::m_pingTimeout),
                    MakeTimeChecker ())
+    .AddAttribute ("HandoffChunkSize",
+                   "Payload bytes per HANDOFF_REQ sent to the successor on leave",
+                   UintegerValue (1400),
+                   MakeUintegerAccessor (&GUSearch::m_handoffChunkSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("HandoffRetries",
+                   "Times an unacknowledged HANDOFF_REQ is sent again",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&GUSearch::m_handoffRetries),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ReplicationFactor",
+                   "Nodes holding every key: its owner and the successors after it",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&GUSearch::m_replicationFactor),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("ReplicaSetLifetime",
+                   "Time a replica set learned from an owner is used, in milliseconds",
+                   TimeValue (MilliSeconds (30000)),
+                   MakeTimeAccessor (&GUSearch::m_replicaSetLifetime),
+                   MakeTimeChecker ())
+    .AddAttribute ("CardinalityLifetime",
+                   "Time a posting-list size reported by an owner is used to plan searches, in milliseconds",
+                   TimeValue (MilliSeconds (60000)),
+                   MakeTimeAccessor (&GUSearch::m_cardinalityLifetime),
+                   MakeTimeChecker ())
     ;
   return tid;
 }
 
 GUSearch::GUSearch ()
-  : m_auditPingsTimer (Timer::CANCEL_ON_DESTROY)
+  : m_index (m_termDictionary, m_documentDictionary),
+    m_documents (m_termDictionary, m_documentDictionary),
+    m_replicas (m_termDictionary, m_documentDictionary),
+    m_auditPingsTimer (Timer::CANCEL_ON_DESTROY)
 {
   m_chord = NULL;
+  m_requestsServed = 0;
   RandomVariable random;
   SeedManager::SetSeed (time (NULL));
   random = UniformVariable (0x00000000, 0xFFFFFFFF);
@@ -102,8 +138,10 @@ GUSearch::StartApplication (void)
   m_chord->SetPingFailureCallback (MakeCallback (&GUSearch::HandleChordPingFailure, this));
   m_chord->SetPingRecvCallback (MakeCallback (&GUSearch::HandleChordPingRecv, this)); 
   m_chord->SetChordLookupCallback (MakeCallback (&GUSearch::HandleChordLookupCallback, this));
+  m_chord->SetChordLookupFailureCallback (MakeCallback (&GUSearch::HandleChordLookupFailure, this));
   m_chord->SetChordLeaveCallback (MakeCallback (&GUSearch::HandleChordLeaveRequest, this));
   m_chord->SetPredecessorChangeCallback (MakeCallback (&GUSearch::HandlePredecessorChangeCallback, this));
+  m_chord->SetKeyCountCallback (MakeCallback (&GUSearch::HandleChordKeyCount, this));
   
   // Start Chord
   m_chord->SetStartTime (Simulator::Now());
@@ -139,6 +177,12 @@ GUSearch::StopApplication (void)
   // Cancel timers
   m_auditPingsTimer.Cancel ();
   m_pingTracker.clear ();
+  m_handoffTracker.clear ();
+  m_pingDeadlines.Clear ();
+  m_replicaSets.clear ();
+  m_fetchTracker.clear ();
+  m_queriesAnswered.clear ();
+  m_cardinalities.clear ();
 }
 
 void
@@ -242,38 +286,61 @@ GUSearch::SendSearchRequest(uint32_t viaNodeNum, uint32_t requestingNodeNum,
   
   Ptr<Packet> packet = Create<Packet> ();
   
+  std::vector<std::string> plan = PlanSearch(searchKeys);
   std::stringstream ss;
-  std::set<std::string>::iterator b;
-  for(b = searchKeys.begin(); b != searchKeys.end(); b++){  
+  std::vector<std::string>::iterator b;
+  for(b = plan.begin(); b != plan.end(); b++){  
     ss << *b << " ";
   }
   SEARCH_LOG("Search< " << ss.str() << ">");
   
   
-  searchReqMsg.SetFetchReq (requestingNodeNum, "", searchKeys, existingDocuments);
+  searchReqMsg.SetFetchReq (requestingNodeNum, transId, "", plan, existingDocuments,
+                            GUSearchMessage::Cardinalities ());
   packet->AddHeader (searchReqMsg);
   m_socket->SendTo (packet, 0 , InetSocketAddress (destAddress, m_appPort));
 }
 
+// Keys go smallest posting list first, so the list shipped along the chain
+// only shrinks from the smallest. Sizes are known for keys held here and
+// for keys reported by the owners in earlier searches; the other keys come
+// last, in key order
+std::vector<std::string>
+GUSearch::PlanSearch (const std::set<std::string> &searchKeys)
+{
+  const uint64_t unknown = (uint64_t) 1 << 32;
+  std::vector<std::pair<uint64_t, std::string> > costs;
+  for (std::set<std::string>::const_iterator it = searchKeys.begin(); it != searchKeys.end(); it++) {
+    uint64_t cost = unknown;
+    std::map<std::string, TermCardinality>::iterator learned = m_cardinalities.find(*it);
+    if (IsInRing() && m_chord->IsLocalKey (ChordId::Hash (*it)))
+      cost = m_documents.GetCount(*it);
+    else if (learned != m_cardinalities.end())
+      cost = learned->second.count;
+    costs.push_back(std::make_pair(cost, *it));
+  }
+  std::sort(costs.begin(), costs.end());
+
+  std::vector<std::string> plan;
+  for (uint32_t i = 0; i < costs.size(); i++) {
+    plan.push_back(costs[i].second);
+  }
+  return plan;
+}
+
 void
 GUSearch::PublishList() {
   //print all the index
-  std::map<std::string,std::set<std::string> >::iterator key_it;
-  std::set<std::string>::iterator doc_it;
+  SearchIndex::Iterator key_it;
+  std::vector<ChordId> lookupKeys;
+  std::vector<uint32_t> transIds;
   
-  for(key_it = m_index.begin(); key_it != m_index.end(); key_it++){
+  for(key_it = m_index.Begin(); key_it != m_index.End(); key_it++){
     
-    std::string key = key_it->first;
+    std::string key = m_index.GetTerm(key_it->first);
     
     // 1. hash the key
-    unsigned char temp[20];
-    SHA1((unsigned char *)key.c_str(), strlen(key.c_str()), temp);
-    std::ostringstream s;
-    s << std::hex << std::setfill('0');
-    for (int i = 0; i < 20; i++) {
-      s << std::setw(2) << static_cast<int>(temp[i]);
-    }
-    std::string lookupKey = s.str();
+    ChordId lookupKey = ChordId::Hash (key);
     
     // 2. send chord lookup
     uint32_t transId = GetNextTransactionId();
@@ -284,75 +351,60 @@ GUSearch::PublishList() {
     kli.operationType = STORE;
     m_keyRequestTracker[transId] = kli;
     
-    std::set<std::string> results = m_index[key];
-    std::stringstream ss;
-    for(std::set<std::string>::iterator i = results.begin(); i != results.end(); i++){  
-      ss << *i << " ";
+    // decoding every list only pays off when it is printed
+    if (g_searchVerbose) {
+      PostingList results = key_it->second.Decode();
+      std::stringstream ss;
+      for(PostingList::const_iterator i = results.begin(); i != results.end(); i++){  
+        ss << m_index.GetDocument(*i) << " ";
+      }
+      SEARCH_LOG("Publish< " << key << ", " << ss.str() << ">");
     }
-    SEARCH_LOG("Publish< " << key << ", " << ss.str() << ">");
     
-    m_chord->SendChordLookup(lookupKey, transId);
+    lookupKeys.push_back(lookupKey);
+    transIds.push_back(transId);
     
   }
+  
+  // resolve every term in one ring traversal
+  m_chord->SendChordLookupBatch(lookupKeys, transIds);
 }
 
+// The metadata file is mapped and tokenized in place, no line or term is
+// copied before it reaches its posting set
 void 
 GUSearch::CreateInvertedList(std::string filename){
-  //std::cout<<"Creating inverted list"<<std::endl;
-  std::cout<<"Metadata file: "<<filename<<std::endl; 
-  
-  std::string line;
-  
-  std::ifstream file (filename.c_str());
-  if (file.is_open()) {
-    while ( getline (file,line) ) {
-      std::istringstream iss(line);
-      
-      std::string key_term; 
-      std::string document;
-      std::string temp;
-      uint32_t count = 0;
-      
-      while (std::getline(iss,temp, ' '))
-      {
-        if(count == 0){ 
-          //this is the document
-          document = temp;
-          count++;
-          continue; 
-        }else{
-          key_term = temp;
-        }
-        //Add document to key_term index
-        std::set<std::string> existing_docs (m_index[key_term]);
-        existing_docs.insert(document);
-        m_index[key_term] = existing_docs;
-        
-        std::set<std::string>::iterator it;
-      }
-    }
-    file.close();
+  int fd = open (filename.c_str (), O_RDONLY);
+  if (fd < 0) {
+    ERROR_LOG ("Cannot open metadata file: " << filename);
+    return;
   }
-  
-  //print all the index
-  typedef std::set<std::string> SET;
-  std::map<std::string,SET>::iterator key_it;
-  std::set<std::string>::iterator doc_it;
-  
-  for(key_it = m_index.begin(); key_it != m_index.end(); key_it++){
-    
-    std::string key = key_it->first;
-    std::set<std::string> tempSet = key_it->second;
-    
-    std::cout<< key << ": ";
-    for(doc_it = tempSet.begin(); doc_it != tempSet.end(); doc_it++){
-      
-      std::cout<< *doc_it << " ";
-      
+  struct stat info;
+  if (fstat (fd, &info) < 0) {
+    ERROR_LOG ("Cannot stat metadata file: " << filename);
+    close (fd);
+    return;
+  }
+
+  uint32_t pairs = 0;
+  if (info.st_size > 0) {
+    void *data = mmap (NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      madvise (data, info.st_size, MADV_SEQUENTIAL);
+      pairs = m_index.AddMetadata ((const char *) data, (const char *) data + info.st_size);
+      munmap (data, info.st_size);
+    } else {
+      // not mappable, read it in one piece instead
+      std::ifstream file (filename.c_str(), std::ios::binary);
+      std::vector<char> buffer ((std::istreambuf_iterator<char> (file)), std::istreambuf_iterator<char> ());
+      if (!buffer.empty ())
+        pairs = m_index.AddMetadata (&buffer[0], &buffer[0] + buffer.size ());
     }
-    std::cout<<std::endl;
   }
-  
+  close (fd);
+
+  SEARCH_LOG ("Metadata<" << filename << ", Bytes: " << info.st_size << ", Pairs: " << pairs << ", Terms: " << m_index.GetSize ()
+              << ", Stored: " << m_index.GetByteSize () << " bytes>");
 }
 
 void
@@ -374,6 +426,7 @@ GUSearch::SendGUSearchPing (Ipv4Address destAddress, std::string pingMessage)
       Ptr<PingRequest> pingRequest = Create<PingRequest> (transactionId, Simulator::Now(), destAddress, pingMessage);
       // Add to ping-tracker
       m_pingTracker.insert (std::make_pair (transactionId, pingRequest));
+      m_pingDeadlines.Insert (transactionId, pingRequest->GetTimestamp () + m_pingTimeout);
       Ptr<Packet> packet = Create<Packet> ();
       GUSearchMessage message = GUSearchMessage (GUSearchMessage::PING_REQ, transactionId);
       message.SetPingReq (pingMessage);
@@ -412,6 +465,24 @@ GUSearch::RecvMessage (Ptr<Socket> socket)
       case GUSearchMessage::FETCH_RSP:
         ProcessFetchRsp (message, sourceAddress, sourcePort);
         break;
+      case GUSearchMessage::HANDOFF_REQ:
+        ProcessHandoffReq (message, sourceAddress, sourcePort);
+        break;
+      case GUSearchMessage::HANDOFF_RSP:
+        ProcessHandoffRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUSearchMessage::REPLICA_SET_REQ:
+        ProcessReplicaSetReq (message, sourceAddress, sourcePort);
+        break;
+      case GUSearchMessage::REPLICA_SET_RSP:
+        ProcessReplicaSetRsp (message, sourceAddress, sourcePort);
+        break;
+      case GUSearchMessage::FETCH_ACK:
+        ProcessFetchAck (message, sourceAddress, sourcePort);
+        break;
+      case GUSearchMessage::STORE_MISS:
+        ProcessStoreMiss (message, sourceAddress, sourcePort);
+        break;
       default:
         ERROR_LOG ("Unknown Message Type!");
         break;
@@ -444,6 +515,7 @@ GUSearch::ProcessPingRsp (GUSearchMessage message, Ipv4Address sourceAddress, ui
       std::string fromNode = ReverseLookup (sourceAddress);
       SEARCH_LOG ("Received PING_RSP, From Node: " << fromNode << ", Message: " << message.GetPingRsp().pingMessage);
       m_pingTracker.erase (iter);
+      m_pingDeadlines.Remove (message.GetTransactionId ());
     }
   else
     {
@@ -454,40 +526,203 @@ GUSearch::ProcessPingRsp (GUSearchMessage message, Ipv4Address sourceAddress, ui
 void 
 GUSearch::ProcessStoreReq (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort) {
 
+  m_requestsServed++;
+
+  std::string key = message.GetStoreReq().key;
   std::set<std::string> documents = message.GetStoreReq().documents;
   std::stringstream ss;
-  for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
-    m_documents[message.GetStoreReq().key].insert(*it);
-    ss << *it << " ";
+  if (g_searchVerbose) {
+    for (std::set<std::string>::iterator it = documents.begin(); it != documents.end(); it++) {
+      ss << *it << " ";
+    }
+  }
+
+  if (message.GetStoreReq().replica) {
+    m_replicas.Add(key, documents);
+    SEARCH_LOG("StoreReplica< " << key << ", " << ss.str() << ">");
+    return;
+  }
+
+  // the sender's owner for this key is stale, it looks the key up again
+  if (IsInRing() && !m_chord->IsLocalKey(ChordId::Hash(key))) {
+    DEBUG_LOG("Not the owner of " << key << ", returning STORE_REQ to Node: " << ReverseLookup(sourceAddress));
+    GUSearchMessage storeMiss = GUSearchMessage (GUSearchMessage::STORE_MISS, message.GetTransactionId());
+    Ptr<Packet> packet = Create<Packet> ();
+    storeMiss.SetStoreMiss (key, documents);
+    packet->AddHeader (storeMiss);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
+    return;
+  }
+
+  // we may hold the key as a replica of an owner that is gone
+  PostingList replica;
+  std::set<std::string> held;
+  if (m_replicas.Find(key, replica)) {
+    held = m_replicas.GetDocuments(replica);
+    m_documents.Merge(key, replica);
+    m_replicas.Erase(key);
+  }
+  m_documents.Add(key, documents);
+  // the replicas already hold what was stored before, pass on only the new
+  // documents and whatever we held as a replica ourselves
+  held.insert(documents.begin(), documents.end());
+  Replicate(key, held);
+
+  SEARCH_LOG("Store< " << key << ", " << ss.str() << ">");
+}
+
+void
+GUSearch::Replicate (const std::string &key, const std::set<std::string> &documents)
+{
+  if (m_replicationFactor <= 1)
+    return;
+
+  std::vector<Ipv4Address> replicas = m_chord->GetReplicaSet (ChordId::Hash (key), m_replicationFactor - 1);
+  for (uint32_t i = 0; i < replicas.size(); i++) {
+    GUSearchMessage storeReq = GUSearchMessage (GUSearchMessage::STORE_REQ, GetNextTransactionId());
+    Ptr<Packet> packet = Create<Packet> ();
+    storeReq.SetStoreReq (key, documents, true);
+    packet->AddHeader (storeReq);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (replicas[i], m_appPort));
+  }
+}
+
+// The FETCH_REQ goes to one holder at a time. Until the replica set is known
+// that is the owner; after that the first holder is picked by queryId, so
+// the queries on a popular key spread over the owner and its replicas
+void
+GUSearch::SendFetchReq (Ipv4Address owner, GUSearchMessage::FetchReq fetchReq, uint32_t transactionId)
+{
+  PendingFetch &pending = m_fetchTracker[transactionId];
+  pending.fetchReq = fetchReq;
+  pending.holders.assign (1, owner);
+  pending.attempt = 0;
+
+  std::map<std::string, ReplicaSet>::iterator known = m_replicaSets.find(fetchReq.key);
+  if (known != m_replicaSets.end() && (known->second.owner != owner || known->second.expires <= Simulator::Now())) {
+    m_replicaSets.erase(known);
+    known = m_replicaSets.end();
   }
 
-  SEARCH_LOG("Store< " << message.GetStoreReq().key << ", " << ss.str() << ">");
+  if (known != m_replicaSets.end()) {
+    pending.holders.insert(pending.holders.end(), known->second.replicas.begin(), known->second.replicas.end());
+    std::rotate(pending.holders.begin(), pending.holders.begin() + fetchReq.queryId % pending.holders.size(), pending.holders.end());
+  } else if (m_replicationFactor > 1) {
+    // ask once, the answer also reaches this fetch if it is still pending
+    ReplicaSet &replicaSet = m_replicaSets[fetchReq.key];
+    replicaSet.owner = owner;
+    replicaSet.expires = Simulator::Now() + m_replicaSetLifetime;
+
+    GUSearchMessage replicaSetReq = GUSearchMessage (GUSearchMessage::REPLICA_SET_REQ, GetNextTransactionId());
+    Ptr<Packet> packet = Create<Packet> ();
+    replicaSetReq.SetReplicaSetReq (fetchReq.key);
+    packet->AddHeader (replicaSetReq);
+    m_socket->SendTo (packet, 0 , InetSocketAddress (owner, m_appPort));
+  }
+
+  SendFetchAttempt (transactionId);
+}
+
+void
+GUSearch::SendFetchAttempt (uint32_t transactionId)
+{
+  PendingFetch &pending = m_fetchTracker[transactionId];
+  Ipv4Address holder = pending.holders[pending.attempt++];
+  m_pingDeadlines.Insert (transactionId, Simulator::Now() + m_pingTimeout);
+
+  GUSearchMessage message = GUSearchMessage (GUSearchMessage::FETCH_REQ, transactionId);
+  Ptr<Packet> packet = Create<Packet> ();
+  const GUSearchMessage::FetchReq &fetchReq = pending.fetchReq;
+  message.SetFetchReq(fetchReq.originatorNum, fetchReq.queryId, fetchReq.key, fetchReq.searchKeys, fetchReq.documents, fetchReq.cardinalities);
+  packet->AddHeader(message);
+  m_socket->SendTo (packet, 0 , InetSocketAddress (holder, m_appPort));
+}
+
+void
+GUSearch::ProcessFetchAck (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  if (m_fetchTracker.erase (message.GetTransactionId()) > 0)
+    m_pingDeadlines.Remove (message.GetTransactionId());
+}
+
+// A returned STORE_REQ goes back into the index and is published again,
+// past the cached owner that sent it back
+void
+GUSearch::ProcessStoreMiss (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  GUSearchMessage::StoreReq miss = message.GetStoreMiss();
+  ChordId lookupKey = ChordId::Hash (miss.key);
+  m_chord->LookupCacheInvalidate (lookupKey);
+  m_index.Add (miss.key, miss.documents);
+
+  uint32_t transId = GetNextTransactionId();
+  KeyLookupInformation kli;
+  kli.lookupKey = lookupKey;
+  kli.actualKey = miss.key;
+  kli.operationType = STORE;
+  m_keyRequestTracker[transId] = kli;
+  m_chord->SendChordLookup (lookupKey, transId);
+}
+
+void
+GUSearch::SendFetchRsp (uint32_t originatorNum, uint32_t queryId, const std::set<std::string> &documents,
+                        const GUSearchMessage::Cardinalities &cardinalities)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  GUSearchMessage fetchRsp = GUSearchMessage (GUSearchMessage::FETCH_RSP, GetNextTransactionId());
+  std::stringstream nodeNumStream;
+  nodeNumStream << originatorNum;
+  fetchRsp.SetFetchRsp(queryId, documents, cardinalities);
+  packet->AddHeader(fetchRsp);
+  m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumStream.str()), m_appPort));
+}
+
+void
+GUSearch::ProcessReplicaSetReq (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  std::string key = message.GetReplicaSetReq().key;
+  GUSearchMessage replicaSetRsp = GUSearchMessage (GUSearchMessage::REPLICA_SET_RSP, message.GetTransactionId());
+  Ptr<Packet> packet = Create<Packet> ();
+  replicaSetRsp.SetReplicaSetRsp (key, m_chord->GetReplicaSet (ChordId::Hash (key), m_replicationFactor - 1));
+  packet->AddHeader (replicaSetRsp);
+  m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
+}
+
+void
+GUSearch::ProcessReplicaSetRsp (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  std::map<std::string, ReplicaSet>::iterator known = m_replicaSets.find(message.GetReplicaSetRsp().key);
+  if (known == m_replicaSets.end() || known->second.owner != sourceAddress)
+    return;
+  known->second.replicas = message.GetReplicaSetRsp().replicas;
+
+  // fetches of this key still waiting on the owner can fail over now
+  for (std::map<uint32_t, PendingFetch>::iterator it = m_fetchTracker.begin(); it != m_fetchTracker.end(); it++) {
+    PendingFetch &pending = it->second;
+    if (pending.fetchReq.key == known->first && pending.holders.size() == 1 && pending.holders[0] == sourceAddress)
+      pending.holders.insert(pending.holders.end(), known->second.replicas.begin(), known->second.replicas.end());
+  }
 }
 
 void 
 GUSearch::ProcessFetchReq(GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort){
 
+  m_requestsServed++;
+
   std::string firstKey = message.GetFetchReq().key;
-  std::set<std::string> l_searchKeys = message.GetFetchReq().searchKeys;
+  std::vector<std::string> l_searchKeys = message.GetFetchReq().searchKeys;
   
-  std::set<std::string> resultDocuments;
+  PostingList resultDocuments;
   
   if (firstKey == "" && !l_searchKeys.empty()) {
     // we are first!
     
-    std::set<std::string>::iterator it = l_searchKeys.begin();
+    std::vector<std::string>::iterator it = l_searchKeys.begin();
     firstKey = *it;
     l_searchKeys.erase(it); 
   
     // 1. hash the key
-    unsigned char temp[20];
-    SHA1((unsigned char *)firstKey.c_str(), strlen(firstKey.c_str()), temp);
-    std::ostringstream s;
-    s << std::hex << std::setfill('0');
-    for (int i = 0; i < 20; i++) {
-      s << std::setw(2) << static_cast<int>(temp[i]);
-    }
-    std::string lookupKey = s.str();
+    ChordId lookupKey = ChordId::Hash (firstKey);
     
     // 2. send chord lookup
     uint32_t transId = GetNextTransactionId();
@@ -499,8 +734,10 @@ GUSearch::ProcessFetchReq(GUSearchMessage message, Ipv4Address sourceAddress, ui
     GUSearchMessage::FetchReq fetchReq;
     fetchReq.key = firstKey;
     fetchReq.originatorNum = message.GetFetchReq().originatorNum;
+    fetchReq.queryId = message.GetFetchReq().queryId;
     fetchReq.searchKeys = l_searchKeys;
     fetchReq.documents = message.GetFetchReq().documents;
+    fetchReq.cardinalities = message.GetFetchReq().cardinalities;
     kli.fetchReq = fetchReq;
     m_keyRequestTracker[transId] = kli;
     
@@ -508,59 +745,54 @@ GUSearch::ProcessFetchReq(GUSearchMessage message, Ipv4Address sourceAddress, ui
     
   } else {
     // we are not first
-    
-    std::set<std::string> myResults;
-    if (m_documents.find(firstKey) != m_documents.end())
-      myResults = (m_documents.find(firstKey))->second;
+
+    // the owner's list is the answer, even an empty one. A replica standing
+    // in for it without a copy stays silent and the sender tries the next
+    PostingList myResults;
+    if (!m_documents.Find(firstKey, myResults) && !m_replicas.Find(firstKey, myResults)
+        && !m_chord->IsLocalKey(ChordId::Hash(firstKey))) {
+      DEBUG_LOG("No copy of " << firstKey << " for FETCH_REQ from Node: " << ReverseLookup(sourceAddress));
+      return;
+    }
+
+    // only one holder continues the chain
+    GUSearchMessage fetchAck = GUSearchMessage (GUSearchMessage::FETCH_ACK, message.GetTransactionId());
+    Ptr<Packet> ackPacket = Create<Packet> ();
+    fetchAck.SetFetchAck (firstKey);
+    ackPacket->AddHeader (fetchAck);
+    m_socket->SendTo (ackPacket, 0 , InetSocketAddress (sourceAddress, sourcePort));
+
+    // the originator orders its next searches by what the owners report
+    GUSearchMessage::Cardinalities cardinalities = message.GetFetchReq().cardinalities;
+    cardinalities[firstKey] = myResults.size();
     
     if (myResults.empty()) {
       
       SEARCH_LOG("SearchResults<" << g_nodeId << ",\"EmptyList\">");
       
       //  send "no results" to message.GetFetchReq().originatorNum
-      Ptr<Packet> packet = Create<Packet> ();
-      GUSearchMessage fetchRsp = GUSearchMessage (GUSearchMessage::FETCH_RSP, GetNextTransactionId());
-      uint32_t nodeNum = message.GetFetchReq().originatorNum;
-      std::stringstream nodeNumStream;
-      nodeNumStream << nodeNum;
-      std::string nodeNumStr = nodeNumStream.str();
-      
-      fetchRsp.SetFetchRsp(myResults);
-      packet->AddHeader(fetchRsp);
-      m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumStr), m_appPort));
+      SendFetchRsp(message.GetFetchReq().originatorNum, message.GetFetchReq().queryId, std::set<std::string> (), cardinalities);
       
       return;
     }
     
     if (message.GetFetchReq().documents.empty()) {
-      resultDocuments = myResults;
+      resultDocuments.swap(myResults);
     } else {
       
-      std::set<std::string> receivedDocuments = message.GetFetchReq().documents;
+      // names to our ids, a name unknown here is in none of our lists
+      PostingList receivedDocuments = m_documents.ToPostings(message.GetFetchReq().documents);
       
-      // resultDocuments = receivedDocuments INTERSECT myResults
-      for(std::set<std::string>::iterator myit = myResults.begin(); myit != myResults.end(); myit++) {
-        for(std::set<std::string>::iterator rcvit = receivedDocuments.begin(); 
-            rcvit != receivedDocuments.end(); rcvit++) {
-          if(*myit == *rcvit){
-            resultDocuments.insert(*myit);
-          } 
-        }
-      }
+      // resultDocuments = receivedDocuments INTERSECT myResults, both sorted
+      IntersectPostings(myResults, receivedDocuments, resultDocuments);
       
     }
     
     
-    if (l_searchKeys.empty()){
+    // an empty intersection stays empty, the remaining keys need no visit
+    if (l_searchKeys.empty() || resultDocuments.empty()){
     
       //  send result to message.GetFetchReq().originatorNum
-      Ptr<Packet> packet = Create<Packet> ();
-      GUSearchMessage fetchRsp = GUSearchMessage (GUSearchMessage::FETCH_RSP, GetNextTransactionId());
-
-      uint32_t nodeNum = message.GetFetchReq().originatorNum;
-      std::stringstream nodeNumStream;
-      nodeNumStream << nodeNum;
-      std::string nodeNumStr = nodeNumStream.str();
 
       /*      
       std::set<std::string>::iterator d;
@@ -576,26 +808,18 @@ GUSearch::ProcessFetchReq(GUSearchMessage message, Ipv4Address sourceAddress, ui
       }
       */
 
-      fetchRsp.SetFetchRsp(resultDocuments);
-      packet->AddHeader(fetchRsp);
-      m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumStr), m_appPort));
+      // a subset of our own list, so every name is known here
+      SendFetchRsp(message.GetFetchReq().originatorNum, message.GetFetchReq().queryId, m_documents.GetDocuments(resultDocuments), cardinalities);
       
     } else {
       // extract key
-      std::set<std::string> remainingSearchKeys = message.GetFetchReq().searchKeys;
-      std::set<std::string>::iterator it = remainingSearchKeys.begin();
+      std::vector<std::string> remainingSearchKeys = message.GetFetchReq().searchKeys;
+      std::vector<std::string>::iterator it = remainingSearchKeys.begin();
       std::string extractedKey = *it;
       remainingSearchKeys.erase(it); 
             
       // 1. hash the key
-      unsigned char temp[20];
-      SHA1((unsigned char *)extractedKey.c_str(), strlen(extractedKey.c_str()), temp);
-      std::ostringstream s;
-      s << std::hex << std::setfill('0');
-      for (int i = 0; i < 20; i++) {
-        s << std::setw(2) << static_cast<int>(temp[i]);
-      }
-      std::string lookupKey = s.str();
+      ChordId lookupKey = ChordId::Hash (extractedKey);
       
       // 2. send chord lookup
       uint32_t transId = GetNextTransactionId();
@@ -607,18 +831,24 @@ GUSearch::ProcessFetchReq(GUSearchMessage message, Ipv4Address sourceAddress, ui
       GUSearchMessage::FetchReq fetchReq;
       fetchReq.key = extractedKey;
       fetchReq.originatorNum = message.GetFetchReq().originatorNum;
+      fetchReq.queryId = message.GetFetchReq().queryId;
       fetchReq.searchKeys = remainingSearchKeys;
-      fetchReq.documents = resultDocuments;
+      fetchReq.documents = m_documents.GetDocuments(resultDocuments);
+      fetchReq.cardinalities = cardinalities;
       kli.fetchReq = fetchReq;
       m_keyRequestTracker[transId] = kli;
       
       m_chord->SendChordLookup(lookupKey, transId);
       
-      std::stringstream res;
-      for(std::set<std::string>::iterator i = resultDocuments.begin(); i != resultDocuments.end(); i++){  
-        res << *i << " ";
+      if (g_searchVerbose) {
+        std::stringstream res;
+        for(std::set<std::string>::iterator i = fetchReq.documents.begin(); i != fetchReq.documents.end(); i++){  
+          res << *i << " ";
+        }
+        std::vector<uint8_t> shipped;
+        EncodeNames(fetchReq.documents, shipped);
+        SEARCH_LOG("InvertedListShip< "<< extractedKey <<", " << res.str() << "(" << shipped.size() << " bytes) >");
       }
-      SEARCH_LOG("InvertedListShip< "<< extractedKey <<", " << res.str() << " >");
       
     }
   }
@@ -627,6 +857,18 @@ GUSearch::ProcessFetchReq(GUSearchMessage message, Ipv4Address sourceAddress, ui
     
 void 
 GUSearch::ProcessFetchRsp (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort) {
+  // a late owner and the replica that took over may both answer, the first wins
+  if (m_queriesAnswered.find(message.GetFetchRsp().queryId) != m_queriesAnswered.end())
+    return;
+  m_queriesAnswered[message.GetFetchRsp().queryId] = Simulator::Now();
+
+  GUSearchMessage::Cardinalities cardinalities = message.GetFetchRsp().cardinalities;
+  for (GUSearchMessage::Cardinalities::iterator it = cardinalities.begin(); it != cardinalities.end(); it++) {
+    TermCardinality &learned = m_cardinalities[it->first];
+    learned.count = it->second;
+    learned.learned = Simulator::Now();
+  }
+
   std::set<std::string> results = message.GetFetchRsp().documents;
 
   std::set<std::string>::iterator d;
@@ -648,37 +890,115 @@ GUSearch::PrintMyDocuments() {
   std::cout << "DOCUMENTS FOR NODE " << g_nodeId << ": "<<std::endl;
   
   //m_documents
-  std::map<std::string,std::set<std::string> >::iterator a;
-  std::set<std::string>::iterator b;
-  for(a = m_documents.begin(); a != m_documents.end(); a++){
-    std::string key = a->first;
-    std::cout << " " << key << ":";
-    std::set<std::string> tempSet = a->second;
-    for(b = tempSet.begin(); b != tempSet.end(); b++){  
-      std::cout<< *b << ",";
+  SearchIndex::Iterator a;
+  PostingList::const_iterator b;
+  for(a = m_documents.Begin(); a != m_documents.End(); a++){
+    std::cout << " " << m_documents.GetTerm(a->first) << ":";
+    PostingList postings = a->second.Decode();
+    for(b = postings.begin(); b != postings.end(); b++){  
+      std::cout<< m_documents.GetDocument(*b) << ",";
     }
     std::cout<<std::endl;
   }
 }
 
+bool
+GUSearch::IsInRing ()
+{
+  return m_chord != NULL && m_chord->IsInRing ();
+}
+
+uint32_t
+GUSearch::GetKeyCount ()
+{
+  return m_documents.GetSize ();
+}
+
+uint32_t
+GUSearch::GetRequestCount ()
+{
+  return m_requestsServed;
+}
+
+double
+GUSearch::GetKeySpaceShare ()
+{
+  return m_chord->GetKeySpaceShare ();
+}
+
+Ptr<GUChord>
+GUSearch::GetChord ()
+{
+  return m_chord;
+}
+
 
 void
 GUSearch::AuditPings ()
 {
-  std::map<uint32_t, Ptr<PingRequest> >::iterator iter;
-  for (iter = m_pingTracker.begin () ; iter != m_pingTracker.end();)
+  // only pings whose deadline passed, not every outstanding one
+  std::vector<uint32_t> expired = m_pingDeadlines.Expire (Simulator::Now ());
+  for (uint32_t i = 0; i < expired.size (); i++)
     {
-      Ptr<PingRequest> pingRequest = iter->second;
-      if (pingRequest->GetTimestamp().GetMilliSeconds() + m_pingTimeout.GetMilliSeconds() <= Simulator::Now().GetMilliSeconds())
+      std::map<uint32_t, HandoffChunk>::iterator handoff = m_handoffTracker.find (expired[i]);
+      if (handoff != m_handoffTracker.end ())
         {
-          DEBUG_LOG ("Ping expired. Message: " << pingRequest->GetPingMessage () << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
-          // Remove stale entries
-          m_pingTracker.erase (iter++);
+          if (handoff->second.attempts <= m_handoffRetries)
+            {
+              SendHandoffChunk (expired[i]);
+            }
+          else
+            {
+              ERROR_LOG ("Handoff to Node: " << ReverseLookup (handoff->second.destination) << " failed, dropping " << handoff->second.entries.size () << " keys");
+              m_handoffTracker.erase (handoff);
+            }
+          continue;
         }
-      else
+      std::map<uint32_t, PendingFetch>::iterator fetch = m_fetchTracker.find (expired[i]);
+      if (fetch != m_fetchTracker.end ())
+        {
+          // the holder we picked may not be the owner anymore
+          if (fetch->second.attempt == 1)
+            m_chord->LookupCacheInvalidate (ChordId::Hash (fetch->second.fetchReq.key));
+          if (fetch->second.attempt < fetch->second.holders.size ())
+            {
+              DEBUG_LOG ("FETCH_REQ for " << fetch->second.fetchReq.key << " not acknowledged, trying Node: " << ReverseLookup (fetch->second.holders[fetch->second.attempt]));
+              SendFetchAttempt (expired[i]);
+            }
+          else
+            {
+              // no holder left, the originator still gets its answer
+              ERROR_LOG ("No holder of " << fetch->second.fetchReq.key << " answered query " << fetch->second.fetchReq.queryId);
+              SendFetchRsp (fetch->second.fetchReq.originatorNum, fetch->second.fetchReq.queryId, std::set<std::string> (), fetch->second.fetchReq.cardinalities);
+              m_fetchTracker.erase (fetch);
+            }
+          continue;
+        }
+      std::map<uint32_t, Ptr<PingRequest> >::iterator iter = m_pingTracker.find (expired[i]);
+      if (iter == m_pingTracker.end ())
         {
-          ++iter;
+          continue;
         }
+      Ptr<PingRequest> pingRequest = iter->second;
+      DEBUG_LOG ("Ping expired. Message: " << pingRequest->GetPingMessage () << " Timestamp: " << pingRequest->GetTimestamp().GetMilliSeconds () << " CurrentTime: " << Simulator::Now().GetMilliSeconds ());
+      // Remove stale entries
+      m_pingTracker.erase (iter);
+    }
+  std::map<uint32_t, Time>::iterator answered = m_queriesAnswered.begin ();
+  while (answered != m_queriesAnswered.end ())
+    {
+      if (answered->second + m_replicaSetLifetime <= Simulator::Now ())
+        m_queriesAnswered.erase (answered++);
+      else
+        answered++;
+    }
+  std::map<std::string, TermCardinality>::iterator cardinality = m_cardinalities.begin ();
+  while (cardinality != m_cardinalities.end ())
+    {
+      if (cardinality->second.learned + m_cardinalityLifetime <= Simulator::Now ())
+        m_cardinalities.erase (cardinality++);
+      else
+        cardinality++;
     }
   // Rechedule timer
   m_auditPingsTimer.Schedule (m_pingTimeout); 
@@ -712,6 +1032,22 @@ GUSearch::HandleChordPingRecv (Ipv4Address destAddress, std::string message)
   SEARCH_LOG ("Chord Layer Received Ping! Source nodeId: " << ReverseLookup(destAddress) << " IP: " << destAddress << " Message: " << message);
 }
 
+void
+GUSearch::HandleChordLookupFailure (std::string targetKey, uint32_t transId)
+{
+  std::map<uint32_t, KeyLookupInformation>::iterator tracked = m_keyRequestTracker.find(transId);
+  if (tracked == m_keyRequestTracker.end())
+    return;
+  
+  ERROR_LOG ("Chord lookup failed! Key: " << tracked->second.actualKey << " TargetKey: " << targetKey << " Transaction ID: " << transId);
+  // a search stuck on the way still gets its answer, as when no holder acks
+  if (tracked->second.operationType == FETCH) {
+    const GUSearchMessage::FetchReq &fetchReq = tracked->second.fetchReq;
+    SendFetchRsp (fetchReq.originatorNum, fetchReq.queryId, std::set<std::string> (), fetchReq.cardinalities);
+  }
+  m_keyRequestTracker.erase(tracked);
+}
+
 void
 GUSearch::HandleChordLeaveRequest (Ipv4Address destAddress, uint32_t successorNodeNum)
 {
@@ -720,19 +1056,145 @@ GUSearch::HandleChordLeaveRequest (Ipv4Address destAddress, uint32_t successorNo
   nodeNumStream << successorNodeNum;
   std::string nodeNumStr = nodeNumStream.str();
 
-  std::map<std::string,std::set<std::string> >::iterator a;
-  for(a = m_documents.begin(); a != m_documents.end(); a++){
-    std::string key = a->first;
-    std::set<std::string> tempSet = a->second;
-    
-    Ptr<Packet> packet = Create<Packet> ();
-    GUSearchMessage storeReq = GUSearchMessage (GUSearchMessage::STORE_REQ, GetNextTransactionId());
-    
-    storeReq.SetStoreReq (key, tempSet);
-    packet->AddHeader (storeReq);
-    m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumStr), m_appPort));
+  // called once per leaving virtual node, hand over only what it owns
+  std::map<std::string, std::set<std::string> > owned;
+  SearchIndex::Iterator a = m_documents.Begin();
+  while (a != m_documents.End()) {
+    const std::string &key = m_documents.GetTerm(a->first);
+    if (!m_chord->OwnsKey (ChordId::Hash (key))) {
+      a++;
+      continue;
+    }
+    owned[key] = m_documents.GetDocuments (a->second);
+    m_documents.Erase(a++);
+  }
+  // copies we hold of an owner that failed are ours now
+  a = m_replicas.Begin();
+  while (a != m_replicas.End()) {
+    const std::string &key = m_replicas.GetTerm(a->first);
+    if (!m_chord->OwnsKey (ChordId::Hash (key))) {
+      a++;
+      continue;
+    }
+    std::set<std::string> documents = m_replicas.GetDocuments (a->second);
+    owned[key].insert (documents.begin (), documents.end ());
+    m_replicas.Erase(a++);
+  }
+  if (!owned.empty())
+    SendHandoff (ResolveNodeIpAddress(nodeNumStr), owned);
+}
+
+// Split the entries into HANDOFF_REQs of at most m_handoffChunkSize
+// payload bytes; a key larger than that is spread over several chunks
+// and the receiver merges its documents back together
+void
+GUSearch::SendHandoff (Ipv4Address destAddress, std::map<std::string, std::set<std::string> > &entries)
+{
+  std::vector<uint32_t> transIds;
+  HandoffChunk chunk;
+  chunk.destination = destAddress;
+  chunk.attempts = 0;
+  uint32_t bytes = 0;
+
+  std::map<std::string, std::set<std::string> >::iterator it;
+  for (it = entries.begin(); it != entries.end(); it++) {
+    uint32_t header = sizeof(uint16_t) + it->first.length() + sizeof(uint32_t);
+    std::set<std::string> *documents = 0;
+
+    for (std::set<std::string>::iterator doc = it->second.begin(); doc != it->second.end(); doc++) {
+      uint32_t size = sizeof(uint16_t) + (*doc).length();
+      if (documents == 0)
+        size += header;
+
+      if (!chunk.entries.empty() && bytes + size > m_handoffChunkSize) {
+        uint32_t transId = GetNextTransactionId();
+        m_handoffTracker[transId] = chunk;
+        transIds.push_back(transId);
+        chunk.entries.clear();
+        bytes = 0;
+        if (documents != 0)
+          size += header;
+        documents = 0;
+      }
+      if (documents == 0)
+        documents = &chunk.entries[it->first];
+      documents->insert(documents->end(), *doc);
+      bytes += size;
+    }
+    if (documents == 0 && it->second.empty()) {
+      if (!chunk.entries.empty() && bytes + header > m_handoffChunkSize) {
+        uint32_t transId = GetNextTransactionId();
+        m_handoffTracker[transId] = chunk;
+        transIds.push_back(transId);
+        chunk.entries.clear();
+        bytes = 0;
+      }
+      chunk.entries[it->first];
+      bytes += header;
+    }
+  }
+  uint32_t transId = GetNextTransactionId();
+  m_handoffTracker[transId] = chunk;
+  transIds.push_back(transId);
+
+  SEARCH_LOG ("Handoff<Node: " << ReverseLookup(destAddress) << ", Keys: " << entries.size() << ", Chunks: " << transIds.size() << ">");
+
+  for (uint32_t i = 0; i < transIds.size(); i++) {
+    HandoffChunk &pending = m_handoffTracker[transIds[i]];
+    pending.chunk = i;
+    pending.chunks = transIds.size();
+    SendHandoffChunk(transIds[i]);
   }
-  m_documents.clear();
+}
+
+void
+GUSearch::SendHandoffChunk (uint32_t transactionId)
+{
+  HandoffChunk &chunk = m_handoffTracker[transactionId];
+  chunk.attempts++;
+  m_pingDeadlines.Insert (transactionId, Simulator::Now() + m_pingTimeout);
+
+  Ptr<Packet> packet = Create<Packet> ();
+  GUSearchMessage handoffReq = GUSearchMessage (GUSearchMessage::HANDOFF_REQ, transactionId);
+  handoffReq.SetHandoffReq (chunk.chunk, chunk.chunks, chunk.entries);
+  packet->AddHeader (handoffReq);
+  m_socket->SendTo (packet, 0 , InetSocketAddress (chunk.destination, m_appPort));
+}
+
+void
+GUSearch::ProcessHandoffReq (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  // a resent chunk merges into the same sets, storing it twice is harmless
+  GUSearchMessage::HandoffReq req = message.GetHandoffReq();
+  std::map<std::string, std::set<std::string> >::iterator it;
+  for (it = req.entries.begin(); it != req.entries.end(); it++) {
+    m_documents.Add(it->first, it->second);
+    PostingList replica;
+    if (m_replicas.Find(it->first, replica)) {
+      m_documents.Merge(it->first, replica);
+      m_replicas.Erase(it->first);
+      std::set<std::string> held = m_replicas.GetDocuments(replica);
+      it->second.insert(held.begin(), held.end());
+    }
+    // the leaving node's replicas are one short now; a key split over
+    // several chunks is passed on one chunk at a time
+    Replicate(it->first, it->second);
+  }
+
+  SEARCH_LOG ("HandoffRecv<Node: " << ReverseLookup(sourceAddress) << ", Chunk: " << req.chunk + 1 << "/" << req.chunks << ", Keys: " << req.entries.size() << ">");
+
+  Ptr<Packet> packet = Create<Packet> ();
+  GUSearchMessage handoffRsp = GUSearchMessage (GUSearchMessage::HANDOFF_RSP, message.GetTransactionId());
+  handoffRsp.SetHandoffRsp (req.chunk);
+  packet->AddHeader (handoffRsp);
+  m_socket->SendTo (packet, 0 , InetSocketAddress (sourceAddress, sourcePort));
+}
+
+void
+GUSearch::ProcessHandoffRsp (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort)
+{
+  if (m_handoffTracker.erase (message.GetTransactionId()) > 0)
+    m_pingDeadlines.Remove (message.GetTransactionId());
 }
 
 void
@@ -742,75 +1204,47 @@ GUSearch::HandlePredecessorChangeCallback (Ipv4Address destAddress, std::string
   nodeNumStream << m_chord->predecessor_id;
   std::string nodeNumStr = nodeNumStream.str(); 
 
-  std::map<std::string,std::set<std::string> >::iterator a;
-  std::set<std::string>::iterator b;
-  for(a = m_documents.begin(); a != m_documents.end(); a++){
-    std::string key = a->first;
+  SearchIndex::Iterator a = m_documents.Begin();
+  while (a != m_documents.End()) {
+    std::string key = m_documents.GetTerm(a->first);
         
     // 1. hash the key
-    unsigned char temp[20];
-    SHA1((unsigned char *)key.c_str(), strlen(key.c_str()), temp);
-    std::ostringstream s;
-    s << std::hex << std::setfill('0');
-    for (int i = 0; i < 20; i++) {
-      s << std::setw(2) << static_cast<int>(temp[i]);
-    }
-    std::string lookupKeyStr = s.str();
-    
-    // 2. compare yourself
+    ChordId lookupKey = ChordId::Hash (key);
     
-    bool mine = false;
-
-    mpz_t my_key_gmp;
-    mpz_init_set_str(my_key_gmp, m_chord->my_node_key_hex.c_str() , 16);
-
-    mpz_t predecessor_key_gmp;
-    mpz_init_set_str(predecessor_key_gmp, m_chord->predecessor_node_key_hex.c_str() , 16);
-
-    mpz_t max;
-    mpz_init_set_str(max, "ffffffffffffffffffffffffffffffffffffffff" , 16);
-
-    mpz_t lookupKey;
-    mpz_init_set_str(lookupKey, lookupKeyStr.c_str() , 16);
-    
-    if ( mpz_cmp(predecessor_key_gmp, my_key_gmp) < 0 ) {
-      // I am bigger than my predecessor
-      if ( mpz_cmp(lookupKey, my_key_gmp) <= 0 && mpz_cmp(lookupKey, predecessor_key_gmp) > 0) {
-        mine = true;
-      }
-    } else {
-      // I am less or equal than predecessor - crosses hash boundary
-      mpz_t modifiedMe;
-      mpz_init_set(modifiedMe, my_key_gmp);
-      mpz_add(modifiedMe, modifiedMe, max);
-      
-      if ( mpz_cmp(lookupKey, modifiedMe) <= 0 && mpz_cmp(lookupKey, predecessor_key_gmp) > 0) {
-        mine = true;
-      } else {
-        mpz_t modifiedKey;
-        mpz_init_set(modifiedKey, lookupKey);
-        mpz_add(modifiedKey, modifiedKey, max);
-        
-        if ( mpz_cmp(modifiedKey, modifiedMe) <= 0 && mpz_cmp(modifiedKey, predecessor_key_gmp) > 0) {
-          mine = true;
-        }
-      }
-    }
+    // 2. compare against every one of our virtual nodes
+    bool mine = m_chord->IsLocalKey (lookupKey);
     
     if (!mine) {
       GUSearchMessage storeReq = GUSearchMessage (GUSearchMessage::STORE_REQ, GetNextTransactionId());
       Ptr<Packet> packet = Create<Packet> ();
-      storeReq.SetStoreReq (key, m_documents[key]);
+      storeReq.SetStoreReq (key, m_documents.GetDocuments(a->second));
       packet->AddHeader (storeReq);
       m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumStr), m_appPort));
       
-      // erase that key from documents since I already sent it
-      m_documents.erase(key);
+      // we follow the new owner, keep a copy as its replica
+      if (m_replicationFactor > 1)
+        m_replicas.Merge(key, a->second);
+      m_documents.Erase(a++);
     }
+    else
+      a++;
 
   }
 }
 
+// keys owned by chord's selected virtual node
+uint32_t
+GUSearch::HandleChordKeyCount ()
+{
+  uint32_t count = 0;
+  SearchIndex::ConstIterator a;
+  for (a = m_documents.Begin(); a != m_documents.End(); a++) {
+    if (m_chord->OwnsKey (ChordId::Hash (m_documents.GetTerm(a->first))))
+      count++;
+  }
+  return count;
+}
+
 void
 GUSearch::HandleChordLookupCallback (Ipv4Address destAddress, uint32_t nodeNum, std::string nodeHash, uint32_t transId)
 {
@@ -820,27 +1254,31 @@ GUSearch::HandleChordLookupCallback (Ipv4Address destAddress, uint32_t nodeNum,
   nodeNumStream << nodeNum;
   std::string nodeNumStr = nodeNumStream.str();
   
-  KeyLookupInformation kli = m_keyRequestTracker[transId];
+  std::map<uint32_t, KeyLookupInformation>::iterator tracked = m_keyRequestTracker.find(transId);
+  if (tracked == m_keyRequestTracker.end()) {
+    // chord's own lookups and results for requests we already gave up on
+    return;
+  }
+  KeyLookupInformation kli = tracked->second;
   std::string key = kli.actualKey;
   OperationType opType = kli.operationType;
   GUSearchMessage::FetchReq fetchRq = kli.fetchReq;
   
   GUSearchMessage storeReq = GUSearchMessage (GUSearchMessage::STORE_REQ, transId);
-  GUSearchMessage fetchReq = GUSearchMessage (GUSearchMessage::FETCH_REQ, transId);
   Ptr<Packet> packet = Create<Packet> ();
   
   switch (opType) {
     case STORE:
       // send the key + documents to ResolveNodeIpAddress(nodeNum) 
       // send Store Request 
-      storeReq.SetStoreReq (key, m_index[key]);
+      storeReq.SetStoreReq (key, m_index.GetDocuments(key));
       packet->AddHeader (storeReq);
 
 
       m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumStr), m_appPort));
 
       // erase that key from documents since I already sent it
-      m_index.erase(key);
+      m_index.Erase(key);
       
       // erase transaction ID from key request tracker
       m_keyRequestTracker.erase(transId);
@@ -848,9 +1286,7 @@ GUSearch::HandleChordLookupCallback (Ipv4Address destAddress, uint32_t nodeNum,
     case FETCH:
       // std::cout << "FETCH" << std::endl;
       
-      fetchReq.SetFetchReq(fetchRq.originatorNum, fetchRq.key, fetchRq.searchKeys, fetchRq.documents);
-      packet->AddHeader(fetchReq);
-      m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumStr), m_appPort));
+      SendFetchReq (ResolveNodeIpAddress(nodeNumStr), fetchRq, transId);
       
       m_keyRequestTracker.erase(transId);
       
@@ -858,12 +1294,12 @@ GUSearch::HandleChordLookupCallback (Ipv4Address destAddress, uint32_t nodeNum,
     case CHECK:
       if (nodeNumStr != g_nodeId) {
         // it is not mine, send it..
-        storeReq.SetStoreReq (key, m_documents[key]);
+        storeReq.SetStoreReq (key, m_documents.GetDocuments(key));
         packet->AddHeader (storeReq);
         m_socket->SendTo (packet, 0 , InetSocketAddress (ResolveNodeIpAddress(nodeNumStr), m_appPort));
         
         // erase that key from documents since I already sent it
-        m_documents.erase(key);
+        m_documents.Erase(key);
       } 
       m_keyRequestTracker.erase(transId);
       break;
@@ -23,6 +23,8 @@
 #include "ns3/gu-chord.h"
 #include "ns3/gu-search-message.h"
 #include "ns3/ping-request.h"
+#include "ns3/search-index.h"
+#include "ns3/timer-wheel.h"
 
 #include "ns3/ipv4-address.h"
 #include <map>
@@ -30,7 +32,6 @@
 #include <vector>
 #include <string>
 #include <openssl/sha.h>
-#include <gmp.h>
 #include "ns3/socket.h"
 #include "ns3/nstime.h"
 #include "ns3/timer.h"
@@ -54,14 +55,30 @@ class GUSearch : public GUApplication
     void ProcessStoreReq (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessFetchReq (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     void ProcessFetchRsp (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessHandoffReq (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessHandoffRsp (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessReplicaSetReq (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessReplicaSetRsp (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessFetchAck (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
+    void ProcessStoreMiss (GUSearchMessage message, Ipv4Address sourceAddress, uint16_t sourcePort);
     
     void AuditPings ();
 
     void CreateInvertedList(std::string filename);
     void PublishList();
     void SendSearchRequest(uint32_t , uint32_t , std::set<std::string>, std::set<std::string> );
+    std::vector<std::string> PlanSearch (const std::set<std::string> &searchKeys);
 
     uint32_t GetNextTransactionId ();
+
+    void SendHandoff (Ipv4Address destAddress, std::map<std::string, std::set<std::string> > &entries);
+    void SendHandoffChunk (uint32_t transactionId);
+
+    void Replicate (const std::string &key, const std::set<std::string> &documents);
+    void SendFetchReq (Ipv4Address owner, GUSearchMessage::FetchReq fetchReq, uint32_t transactionId);
+    void SendFetchAttempt (uint32_t transactionId);
+    void SendFetchRsp (uint32_t originatorNum, uint32_t queryId, const std::set<std::string> &documents,
+                       const GUSearchMessage::Cardinalities &cardinalities);
    
 
     // Chord Callbacks
@@ -69,8 +86,10 @@ class GUSearch : public GUApplication
     void HandleChordPingFailure (Ipv4Address destAddress, std::string message);
     void HandleChordPingRecv (Ipv4Address destAddress, std::string message);
     void HandleChordLookupCallback(Ipv4Address destAddress, uint32_t, std::string, uint32_t);
+    void HandleChordLookupFailure(std::string, uint32_t);
     void HandleChordLeaveRequest (Ipv4Address destAddress, uint32_t successorNodeNum);
     void HandlePredecessorChangeCallback (Ipv4Address destAddress, std::string message);
+    uint32_t HandleChordKeyCount ();
     
     // From GUApplication
     virtual void ProcessCommand (std::vector<std::string> tokens);
@@ -83,8 +102,20 @@ class GUSearch : public GUApplication
     virtual void SetSearchVerbose (bool on);
 
     void PrintMyDocuments();
+
+    // Load of this node, for the simulator's load report
+    bool IsInRing ();
+    uint32_t GetKeyCount ();
+    uint32_t GetRequestCount ();
+    double GetKeySpaceShare ();
+    Ptr<GUChord> GetChord ();
      
-    std::map<std::string, std::set<std::string> > m_index;
+    // terms and documents of every index below, interned
+    StringDictionary m_termDictionary;
+    DocumentDictionary m_documentDictionary;
+
+    // published here, not stored in the ring yet
+    SearchIndex m_index;
     
     enum OperationType {
       STORE, 
@@ -92,14 +123,16 @@ class GUSearch : public GUApplication
       CHECK,
     };
     struct KeyLookupInformation {
-      std::string lookupKey;
+      ChordId lookupKey;
       std::string actualKey;
       OperationType operationType;
       GUSearchMessage::FetchReq fetchReq;
     };
     std::map<uint32_t, KeyLookupInformation> m_keyRequestTracker;
 
-    std::map<std::string, std::set<std::string> > m_documents;
+    SearchIndex m_documents;
+    // copies of keys owned by the nodes before us
+    SearchIndex m_replicas;
     
   protected:
     virtual void DoDispose ();
@@ -110,6 +143,7 @@ class GUSearch : public GUApplication
 
     Ptr<GUChord> m_chord;
     uint32_t m_currentTransactionId;
+    uint32_t m_requestsServed;
     Ptr<Socket> m_socket;
     Time m_pingTimeout;
     uint16_t m_appPort, m_chordPort;
@@ -117,6 +151,46 @@ class GUSearch : public GUApplication
     Timer m_auditPingsTimer;
     // Ping tracker
     std::map<uint32_t, Ptr<PingRequest> > m_pingTracker;
+    TimerWheel m_pingDeadlines;
+    // Handoff chunks sent on leave, kept until acknowledged
+    struct HandoffChunk {
+      Ipv4Address destination;
+      uint32_t chunk;
+      uint32_t chunks;
+      uint32_t attempts;
+      std::map<std::string, std::set<std::string> > entries;
+    };
+    std::map<uint32_t, HandoffChunk> m_handoffTracker;
+    uint32_t m_handoffChunkSize;
+    uint32_t m_handoffRetries;
+    // Replication: the owner and the next m_replicationFactor-1 nodes hold
+    // every key. Replica sets learned from owners let a FETCH_REQ that the
+    // owner does not acknowledge in time fail over to them, one at a time
+    uint32_t m_replicationFactor;
+    Time m_replicaSetLifetime;
+    struct ReplicaSet {
+      Ipv4Address owner;
+      std::vector<Ipv4Address> replicas;
+      Time expires;
+    };
+    std::map<std::string, ReplicaSet> m_replicaSets;
+    // FETCH_REQs sent and not acknowledged yet, deadlines in m_pingDeadlines
+    struct PendingFetch {
+      GUSearchMessage::FetchReq fetchReq;
+      // the owner first, then its replicas
+      std::vector<Ipv4Address> holders;
+      uint32_t attempt;
+    };
+    std::map<uint32_t, PendingFetch> m_fetchTracker;
+    // a late owner and the replica that replaced it may both answer
+    std::map<uint32_t, Time> m_queriesAnswered;
+    // posting-list sizes reported along search chains, for PlanSearch
+    struct TermCardinality {
+      uint32_t count;
+      Time learned;
+    };
+    std::map<std::string, TermCardinality> m_cardinalities;
+    Time m_cardinalityLifetime;
 };
 
 #endif
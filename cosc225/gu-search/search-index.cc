@@ -0,0 +1,655 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/search-index.h"
+
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+
+uint32_t
+StringDictionary::Intern (const std::string &value)
+{
+  std::pair<std::map<std::string, uint32_t>::iterator, bool> inserted =
+    m_ids.insert (std::make_pair (value, (uint32_t) m_strings.size ()));
+  if (inserted.second)
+    {
+      m_strings.push_back (&inserted.first->first);
+    }
+  return inserted.first->second;
+}
+
+bool
+StringDictionary::Find (const std::string &value, uint32_t &id) const
+{
+  std::map<std::string, uint32_t>::const_iterator it = m_ids.find (value);
+  if (it == m_ids.end ())
+    {
+      return false;
+    }
+  id = it->second;
+  return true;
+}
+
+const std::string &
+StringDictionary::GetString (uint32_t id) const
+{
+  return *m_strings[id];
+}
+
+uint32_t
+StringDictionary::GetSize () const
+{
+  return m_strings.size ();
+}
+
+static void
+PutVarint (uint32_t value, std::vector<uint8_t> &bytes)
+{
+  while (value >= 0x80)
+    {
+      bytes.push_back ((uint8_t) (value | 0x80));
+      value >>= 7;
+    }
+  bytes.push_back ((uint8_t) value);
+}
+
+// returns NULL if the varint runs past end
+static const uint8_t *
+GetVarint (const uint8_t *p, const uint8_t *end, uint32_t &value)
+{
+  value = 0;
+  for (uint32_t shift = 0; p < end && shift < 35; shift += 7)
+    {
+      uint8_t byte = *p++;
+      value |= (uint32_t) (byte & 0x7f) << shift;
+      if (byte < 0x80)
+        {
+          return p;
+        }
+    }
+  return NULL;
+}
+
+static void
+PackBlock (const uint32_t *gaps, uint8_t width, std::vector<uint8_t> &bytes)
+{
+  uint64_t pending = 0;
+  uint32_t bits = 0;
+  for (uint32_t i = 0; i < CompressedPostings::BLOCK_SIZE; i++)
+    {
+      pending |= (uint64_t) gaps[i] << bits;
+      bits += width;
+      while (bits >= 8)
+        {
+          bytes.push_back ((uint8_t) pending);
+          pending >>= 8;
+          bits -= 8;
+        }
+    }
+}
+
+// Every lane reads the five bytes holding its own gap, so the loop carries
+// no dependency from one gap to the next and vectorizes
+static void
+UnpackBlock (const uint8_t *packed, uint8_t width, uint32_t *gaps)
+{
+  uint8_t padded[CompressedPostings::BLOCK_SIZE * 4 + 8];
+  uint32_t length = CompressedPostings::BLOCK_SIZE / 8 * width;
+  memcpy (padded, packed, length);
+  memset (padded + length, 0, 8);
+  uint64_t mask = ((uint64_t) 1 << width) - 1;
+  for (uint32_t i = 0; i < CompressedPostings::BLOCK_SIZE; i++)
+    {
+      uint32_t bit = i * width;
+      const uint8_t *p = padded + (bit >> 3);
+      uint64_t word = (uint64_t) p[0] | (uint64_t) p[1] << 8 | (uint64_t) p[2] << 16
+        | (uint64_t) p[3] << 24 | (uint64_t) p[4] << 32;
+      gaps[i] = (uint32_t) ((word >> (bit & 7)) & mask);
+    }
+}
+
+// Past this length ratio, searching the longer list beats walking it
+static const uint32_t GALLOP_RATIO = 32;
+
+// For every id of small, doubles the step into large until it passes the
+// id, then binary searches the last step
+static void
+IntersectGalloping (const PostingList &small, const PostingList &large, PostingList &result)
+{
+  PostingList::const_iterator from = large.begin ();
+  for (PostingList::const_iterator it = small.begin (); it != small.end () && from != large.end (); it++)
+    {
+      uint32_t step = 1;
+      PostingList::const_iterator to = from;
+      while ((uint32_t) (large.end () - to) > step && *(to + step) < *it)
+        {
+          to += step;
+          step <<= 1;
+        }
+      PostingList::const_iterator bound = (uint32_t) (large.end () - to) > step ? to + step + 1 : large.end ();
+      from = std::lower_bound (to, bound, *it);
+      if (from != large.end () && *from == *it)
+        {
+          result.push_back (*it);
+          from++;
+        }
+    }
+}
+
+void
+IntersectPostings (const PostingList &a, const PostingList &b, PostingList &result)
+{
+  if (a.empty () || b.empty ())
+    {
+      return;
+    }
+  if (a.size () * GALLOP_RATIO < b.size ())
+    {
+      IntersectGalloping (a, b, result);
+    }
+  else if (b.size () * GALLOP_RATIO < a.size ())
+    {
+      IntersectGalloping (b, a, result);
+    }
+  else
+    {
+      std::set_intersection (a.begin (), a.end (), b.begin (), b.end (), std::back_inserter (result));
+    }
+}
+
+CompressedPostings::CompressedPostings ()
+  : m_count (0)
+{
+}
+
+CompressedPostings::CompressedPostings (const PostingList &postings)
+  : m_count (0)
+{
+  Encode (postings);
+}
+
+void
+CompressedPostings::Encode (const PostingList &postings)
+{
+  m_count = postings.size ();
+  m_bytes.clear ();
+  uint32_t gaps[BLOCK_SIZE];
+  DocumentId previous = 0;
+  uint32_t i = 0;
+  for (; i + BLOCK_SIZE <= m_count; i += BLOCK_SIZE)
+    {
+      uint32_t widest = 0;
+      for (uint32_t j = 0; j < BLOCK_SIZE; j++)
+        {
+          gaps[j] = postings[i + j] - previous;
+          previous = postings[i + j];
+          widest |= gaps[j];
+        }
+      uint8_t width = 0;
+      while (width < 32 && (widest >> width) != 0)
+        {
+          width++;
+        }
+      m_bytes.push_back (width);
+      PackBlock (gaps, width, m_bytes);
+    }
+  for (; i < m_count; i++)
+    {
+      PutVarint (postings[i] - previous, m_bytes);
+      previous = postings[i];
+    }
+}
+
+void
+CompressedPostings::Decode (PostingList &postings) const
+{
+  postings.resize (m_count);
+  const uint8_t *p = m_bytes.empty () ? NULL : &m_bytes[0];
+  const uint8_t *end = p + m_bytes.size ();
+  uint32_t gaps[BLOCK_SIZE];
+  DocumentId previous = 0;
+  uint32_t i = 0;
+  for (; i + BLOCK_SIZE <= m_count; i += BLOCK_SIZE)
+    {
+      if (p >= end || *p > 32 || (uint32_t) (end - p - 1) < BLOCK_SIZE / 8 * *p)
+        {
+          // truncated, keep what decoded
+          postings.resize (i);
+          return;
+        }
+      uint8_t width = *p++;
+      UnpackBlock (p, width, gaps);
+      p += BLOCK_SIZE / 8 * width;
+      for (uint32_t j = 0; j < BLOCK_SIZE; j++)
+        {
+          previous += gaps[j];
+          postings[i + j] = previous;
+        }
+    }
+  for (; i < m_count; i++)
+    {
+      uint32_t gap;
+      p = GetVarint (p, end, gap);
+      if (p == NULL)
+        {
+          postings.resize (i);
+          return;
+        }
+      previous += gap;
+      postings[i] = previous;
+    }
+}
+
+PostingList
+CompressedPostings::Decode () const
+{
+  PostingList postings;
+  Decode (postings);
+  return postings;
+}
+
+uint32_t
+CompressedPostings::GetCount () const
+{
+  return m_count;
+}
+
+bool
+CompressedPostings::IsEmpty () const
+{
+  return m_count == 0;
+}
+
+const std::vector<uint8_t> &
+CompressedPostings::GetBytes () const
+{
+  return m_bytes;
+}
+
+MutablePostings::MutablePostings ()
+  : m_encodedLast (0)
+{
+}
+
+void
+MutablePostings::Add (const PostingList &documents)
+{
+  uint32_t limit = std::max (CompressedPostings::BLOCK_SIZE, m_encoded.GetCount () / 8);
+  if (m_encoded.IsEmpty () && m_buffer.empty ())
+    {
+      m_encoded.Encode (documents);
+      m_encodedLast = documents.empty () ? 0 : documents.back ();
+      return;
+    }
+
+  // new documents get new ids, so only an id re-added from an older list
+  // costs a decode to keep it out of the buffer
+  PostingList fresh;
+  const PostingList *added = &documents;
+  if (!m_encoded.IsEmpty () && !documents.empty () && documents.front () <= m_encodedLast)
+    {
+      PostingList encoded = m_encoded.Decode ();
+      fresh.reserve (documents.size ());
+      std::set_difference (documents.begin (), documents.end (), encoded.begin (), encoded.end (), std::back_inserter (fresh));
+      added = &fresh;
+    }
+
+  PostingList merged;
+  merged.reserve (m_buffer.size () + added->size ());
+  std::set_union (m_buffer.begin (), m_buffer.end (), added->begin (), added->end (), std::back_inserter (merged));
+  m_buffer.swap (merged);
+  if (m_buffer.size () >= limit)
+    {
+      Flush ();
+    }
+}
+
+void
+MutablePostings::Flush ()
+{
+  if (m_buffer.empty ())
+    {
+      return;
+    }
+  PostingList postings = Decode ();
+  m_encoded.Encode (postings);
+  m_encodedLast = postings.back ();
+  m_buffer.clear ();
+}
+
+void
+MutablePostings::Decode (PostingList &postings) const
+{
+  if (m_buffer.empty ())
+    {
+      m_encoded.Decode (postings);
+      return;
+    }
+  PostingList encoded = m_encoded.Decode ();
+  postings.clear ();
+  postings.reserve (encoded.size () + m_buffer.size ());
+  std::set_union (encoded.begin (), encoded.end (), m_buffer.begin (), m_buffer.end (), std::back_inserter (postings));
+}
+
+PostingList
+MutablePostings::Decode () const
+{
+  PostingList postings;
+  Decode (postings);
+  return postings;
+}
+
+uint32_t
+MutablePostings::GetCount () const
+{
+  return m_encoded.GetCount () + m_buffer.size ();
+}
+
+uint32_t
+MutablePostings::GetByteSize () const
+{
+  return m_encoded.GetBytes ().size () + m_buffer.size () * sizeof (DocumentId);
+}
+
+SearchIndex::SearchIndex (StringDictionary &terms, DocumentDictionary &documents)
+  : m_terms (terms),
+    m_documents (documents)
+{
+}
+
+void
+SearchIndex::Add (const std::string &term, const std::set<std::string> &documents)
+{
+  PostingList postings;
+  postings.reserve (documents.size ());
+  for (std::set<std::string>::const_iterator it = documents.begin (); it != documents.end (); it++)
+    {
+      postings.push_back (m_documents.Intern (*it));
+    }
+  std::sort (postings.begin (), postings.end ());
+  postings.erase (std::unique (postings.begin (), postings.end ()), postings.end ());
+  Merge (term, postings);
+}
+
+void
+SearchIndex::Merge (const std::string &term, const PostingList &documents)
+{
+  m_postings[m_terms.Intern (term)].Add (documents);
+}
+
+void
+SearchIndex::Merge (const std::string &term, const MutablePostings &documents)
+{
+  Merge (term, documents.Decode ());
+}
+
+// No line or term is copied out of data except into the dictionaries.
+// Postings are gathered per term and merged once at the end, since a line
+// may name a document seen before, whose id is older
+uint32_t
+SearchIndex::AddMetadata (const char *data, const char *end)
+{
+  uint32_t pairs = 0;
+  DocumentId document = 0;
+  std::string token;
+  std::map<uint32_t, PostingList> staged;
+  const char *p = data;
+  while (p < end)
+    {
+      const char *eol = (const char *) memchr (p, '\n', end - p);
+      if (eol == NULL)
+        {
+          eol = end;
+        }
+
+      bool first = true;
+      while (p < eol)
+        {
+          while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r'))
+            {
+              p++;
+            }
+          const char *start = p;
+          while (p < eol && *p != ' ' && *p != '\t' && *p != '\r')
+            {
+              p++;
+            }
+          if (p == start)
+            {
+              break;
+            }
+
+          token.assign (start, p - start);
+          if (first)
+            {
+              // the first token of a line names the document
+              document = m_documents.Intern (token);
+              first = false;
+            }
+          else
+            {
+              staged[m_terms.Intern (token)].push_back (document);
+              pairs++;
+            }
+        }
+      p = eol < end ? eol + 1 : end;
+    }
+
+  for (std::map<uint32_t, PostingList>::iterator it = staged.begin (); it != staged.end (); it++)
+    {
+      PostingList &postings = it->second;
+      std::sort (postings.begin (), postings.end ());
+      postings.erase (std::unique (postings.begin (), postings.end ()), postings.end ());
+      m_postings[it->first].Add (postings);
+    }
+  return pairs;
+}
+
+bool
+SearchIndex::Find (const std::string &term, PostingList &postings) const
+{
+  uint32_t id;
+  if (!m_terms.Find (term, id))
+    {
+      return false;
+    }
+  ConstIterator it = m_postings.find (id);
+  if (it == m_postings.end ())
+    {
+      return false;
+    }
+  it->second.Decode (postings);
+  return true;
+}
+
+uint32_t
+SearchIndex::GetCount (const std::string &term) const
+{
+  uint32_t id;
+  if (!m_terms.Find (term, id))
+    {
+      return 0;
+    }
+  ConstIterator it = m_postings.find (id);
+  return it == m_postings.end () ? 0 : it->second.GetCount ();
+}
+
+void
+SearchIndex::Erase (const std::string &term)
+{
+  uint32_t id;
+  if (m_terms.Find (term, id))
+    {
+      m_postings.erase (id);
+    }
+}
+
+void
+SearchIndex::Erase (Iterator it)
+{
+  m_postings.erase (it);
+}
+
+SearchIndex::Iterator
+SearchIndex::Begin ()
+{
+  return m_postings.begin ();
+}
+
+SearchIndex::Iterator
+SearchIndex::End ()
+{
+  return m_postings.end ();
+}
+
+SearchIndex::ConstIterator
+SearchIndex::Begin () const
+{
+  return m_postings.begin ();
+}
+
+SearchIndex::ConstIterator
+SearchIndex::End () const
+{
+  return m_postings.end ();
+}
+
+const std::string &
+SearchIndex::GetTerm (uint32_t term) const
+{
+  return m_terms.GetString (term);
+}
+
+const std::string &
+SearchIndex::GetDocument (DocumentId document) const
+{
+  return m_documents.GetString (document);
+}
+
+std::set<std::string>
+SearchIndex::GetDocuments (const PostingList &postings) const
+{
+  std::set<std::string> documents;
+  for (PostingList::const_iterator it = postings.begin (); it != postings.end (); it++)
+    {
+      documents.insert (m_documents.GetString (*it));
+    }
+  return documents;
+}
+
+std::set<std::string>
+SearchIndex::GetDocuments (const MutablePostings &postings) const
+{
+  return GetDocuments (postings.Decode ());
+}
+
+std::set<std::string>
+SearchIndex::GetDocuments (const std::string &term) const
+{
+  PostingList postings;
+  return Find (term, postings) ? GetDocuments (postings) : std::set<std::string> ();
+}
+
+PostingList
+SearchIndex::ToPostings (const std::set<std::string> &documents) const
+{
+  PostingList postings;
+  postings.reserve (documents.size ());
+  DocumentId id;
+  for (std::set<std::string>::const_iterator it = documents.begin (); it != documents.end (); it++)
+    {
+      if (m_documents.Find (*it, id))
+        {
+          postings.push_back (id);
+        }
+    }
+  std::sort (postings.begin (), postings.end ());
+  postings.erase (std::unique (postings.begin (), postings.end ()), postings.end ());
+  return postings;
+}
+
+uint32_t
+SearchIndex::GetSize () const
+{
+  return m_postings.size ();
+}
+
+uint32_t
+SearchIndex::GetPostingCount () const
+{
+  uint32_t count = 0;
+  for (ConstIterator it = m_postings.begin (); it != m_postings.end (); it++)
+    {
+      count += it->second.GetCount ();
+    }
+  return count;
+}
+
+uint32_t
+SearchIndex::GetByteSize () const
+{
+  uint32_t bytes = 0;
+  for (ConstIterator it = m_postings.begin (); it != m_postings.end (); it++)
+    {
+      bytes += it->second.GetByteSize ();
+    }
+  return bytes;
+}
+
+void
+EncodeNames (const std::set<std::string> &names, std::vector<uint8_t> &bytes)
+{
+  const std::string *previous = NULL;
+  for (std::set<std::string>::const_iterator it = names.begin (); it != names.end (); it++)
+    {
+      uint32_t shared = 0;
+      if (previous != NULL)
+        {
+          uint32_t limit = std::min (previous->length (), it->length ());
+          while (shared < limit && (*previous)[shared] == (*it)[shared])
+            {
+              shared++;
+            }
+        }
+      PutVarint (shared, bytes);
+      PutVarint (it->length () - shared, bytes);
+      bytes.insert (bytes.end (), it->begin () + shared, it->end ());
+      previous = &*it;
+    }
+}
+
+bool
+DecodeNames (const std::vector<uint8_t> &bytes, uint32_t count, std::set<std::string> &names)
+{
+  const uint8_t *p = bytes.empty () ? NULL : &bytes[0];
+  const uint8_t *end = p + bytes.size ();
+  std::string name;
+  for (uint32_t i = 0; i < count; i++)
+    {
+      uint32_t shared, rest;
+      if ((p = GetVarint (p, end, shared)) == NULL || (p = GetVarint (p, end, rest)) == NULL
+          || shared > name.length () || (uint32_t) (end - p) < rest)
+        {
+          return false;
+        }
+      name.resize (shared);
+      name.append ((const char *) p, rest);
+      p += rest;
+      names.insert (names.end (), name);
+    }
+  return true;
+}
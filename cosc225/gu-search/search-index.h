@@ -0,0 +1,248 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Interns strings as dense 32-bit ids, given out in order of first
+ * use
+ *
+ * Every distinct string is kept once. Ids are never reused, so an id stays
+ * valid for the lifetime of the dictionary.
+ */
+class StringDictionary
+{
+  public:
+    /**
+     *  \returns Id of value, added if it was not interned yet
+     */
+    uint32_t Intern (const std::string &value);
+
+    /**
+     *  \returns true and sets id if value is interned
+     */
+    bool Find (const std::string &value, uint32_t &id) const;
+
+    const std::string &GetString (uint32_t id) const;
+    uint32_t GetSize () const;
+
+  private:
+    std::map<std::string, uint32_t> m_ids;
+    // id -> its key in m_ids; map keys do not move
+    std::vector<const std::string *> m_strings;
+};
+
+typedef uint32_t DocumentId;
+
+/**
+ * Document names get dense ids in order of first use, like terms, so the
+ * gaps in a posting list stay small and the lists compress well. The ids
+ * mean nothing to other nodes: posting lists travel as names, see
+ * EncodeNames, and are translated at the message boundary.
+ */
+typedef StringDictionary DocumentDictionary;
+
+// Document ids in ascending order
+typedef std::vector<DocumentId> PostingList;
+
+/**
+ * \brief Appends the ids in both a and b to result, in ascending order
+ *
+ * Gallops through the longer list when the lengths differ a lot and
+ * otherwise merges the two with std::set_intersection.
+ * bench/search-index-bench measures it against std::set_intersection and
+ * the nested loop it replaced.
+ */
+void IntersectPostings (const PostingList &a, const PostingList &b, PostingList &result);
+
+/**
+ * \brief A posting list, delta coded
+ *
+ * Gaps between consecutive ids come in blocks of BLOCK_SIZE bit-packed at
+ * the width of the block's widest gap, so a block unpacks with the same
+ * shift and mask in every lane. The last count % BLOCK_SIZE gaps are
+ * varints. With the dense ids of a DocumentDictionary a list takes well
+ * under a byte per id; bench/search-index-bench measures it.
+ */
+class CompressedPostings
+{
+  public:
+    static const uint32_t BLOCK_SIZE = 128;
+
+    CompressedPostings ();
+    explicit CompressedPostings (const PostingList &postings);
+
+    void Encode (const PostingList &postings);
+    void Decode (PostingList &postings) const;
+    PostingList Decode () const;
+
+    uint32_t GetCount () const;
+    bool IsEmpty () const;
+
+    const std::vector<uint8_t> &GetBytes () const;
+
+  private:
+    uint32_t m_count;
+    std::vector<uint8_t> m_bytes;
+};
+
+/**
+ * \brief A compressed posting list that takes updates
+ *
+ * Added ids wait, sorted, in an uncompressed buffer and are merged into
+ * the encoded list once the buffer outgrows an eighth of it, so an update
+ * costs a buffer insert rather than a decode and encode of the whole list.
+ * Lists added to an empty one, or as large as the buffer limit, are
+ * encoded at once. The buffer never holds an id already encoded.
+ */
+class MutablePostings
+{
+  public:
+    MutablePostings ();
+
+    /**
+     *  \brief Adds the ids of a sorted list
+     */
+    void Add (const PostingList &documents);
+
+    void Decode (PostingList &postings) const;
+    PostingList Decode () const;
+
+    /**
+     *  \returns Number of distinct ids
+     */
+    uint32_t GetCount () const;
+    uint32_t GetByteSize () const;
+
+    /**
+     *  \brief Merges the buffer into the encoded list
+     */
+    void Flush ();
+
+  private:
+    CompressedPostings m_encoded;
+    // largest encoded id, anything above it cannot be encoded yet
+    DocumentId m_encodedLast;
+    PostingList m_buffer;
+};
+
+/**
+ * \brief Posting lists of interned terms
+ *
+ * Terms and documents are interned in dictionaries shared by all indexes
+ * of a node, so ids can be compared across its indexes. Lists are held
+ * compressed and decoded on access, see MutablePostings; strings are only
+ * needed again at the message boundary.
+ */
+class SearchIndex
+{
+  public:
+    typedef std::map<uint32_t, MutablePostings>::iterator Iterator;
+    typedef std::map<uint32_t, MutablePostings>::const_iterator ConstIterator;
+
+    SearchIndex (StringDictionary &terms, DocumentDictionary &documents);
+
+    void Add (const std::string &term, const std::set<std::string> &documents);
+
+    /**
+     *  \brief Adds the documents of a posting list to those of term
+     */
+    void Merge (const std::string &term, const PostingList &documents);
+    void Merge (const std::string &term, const MutablePostings &documents);
+
+    /**
+     *  \brief Indexes lines of "document term term ..." in place
+     *
+     *  \returns Number of (document, term) pairs read
+     */
+    uint32_t AddMetadata (const char *data, const char *end);
+
+    /**
+     *  \returns true and decodes the posting list of term into postings if
+     *  the term has one here
+     */
+    bool Find (const std::string &term, PostingList &postings) const;
+
+    /**
+     *  \returns Length of the posting list of term, without decoding it
+     */
+    uint32_t GetCount (const std::string &term) const;
+
+    void Erase (const std::string &term);
+    void Erase (Iterator it);
+
+    Iterator Begin ();
+    Iterator End ();
+    ConstIterator Begin () const;
+    ConstIterator End () const;
+
+    const std::string &GetTerm (uint32_t term) const;
+    const std::string &GetDocument (DocumentId document) const;
+
+    /**
+     *  \returns Names of the documents
+     */
+    std::set<std::string> GetDocuments (const PostingList &postings) const;
+    std::set<std::string> GetDocuments (const MutablePostings &postings) const;
+    std::set<std::string> GetDocuments (const std::string &term) const;
+
+    /**
+     *  \returns Posting list of the given documents; documents never
+     *  interned here are in no list here and are left out
+     */
+    PostingList ToPostings (const std::set<std::string> &documents) const;
+
+    /**
+     *  \returns Number of terms
+     */
+    uint32_t GetSize () const;
+    uint32_t GetPostingCount () const;
+
+    /**
+     *  \returns Bytes taken by the encoded posting lists
+     */
+    uint32_t GetByteSize () const;
+
+  private:
+    StringDictionary &m_terms;
+    DocumentDictionary &m_documents;
+    std::map<uint32_t, MutablePostings> m_postings;
+};
+
+/**
+ * \brief Appends names front coded, as a message carries a posting list
+ *
+ * In order, each name is the length of the prefix it shares with the one
+ * before and the length of the rest, both varints, then the rest. Names in
+ * one list tend to share most of their characters, so each usually takes
+ * two bytes plus its last few characters.
+ */
+void EncodeNames (const std::set<std::string> &names, std::vector<uint8_t> &bytes);
+
+/**
+ *  \returns false if bytes end before count names were read; the names
+ *  read so far are kept
+ */
+bool DecodeNames (const std::vector<uint8_t> &bytes, uint32_t count, std::set<std::string> &names);
+
+#endif
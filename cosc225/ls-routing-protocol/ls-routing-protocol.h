@@ -27,6 +27,7 @@
 #include "ns3/timer.h"
 
 #include "ns3/ping-request.h"
+#include "ns3/timer-wheel.h"
 #include "ns3/gu-routing-protocol.h"
 #include "ns3/ls-message.h"
 
@@ -236,6 +237,7 @@ class LSRoutingProtocol : public GURoutingProtocol
     Timer m_auditPingsTimer;
     // Ping tracker
     std::map<uint32_t, Ptr<PingRequest> > m_pingTracker;
+    TimerWheel m_pingDeadlines;
 };
 
 #endif
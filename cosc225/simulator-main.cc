@@ -33,6 +33,7 @@
 #include <string.h>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include "ns3/core-module.h"
 #include "ns3/common-module.h"
 #include "ns3/node-module.h"
@@ -101,6 +102,13 @@ class SimulatorMain
     void LinkOperation (uint32_t linkNumber, bool isUp);
     void P2POperation (uint32_t nodeANum, uint32_t nodeBNum, bool isUp);
     void AllInterfacesOperation (uint32_t nodeNumber, bool isUp);
+    void LoadReport ();
+    void JoinReport ();
+
+    // Ring consistency checker
+    void StartRingCheck (uint32_t periodMs, std::string file);
+    void RingCheck ();
+    void MarkRingChurn ();
 
     void SetRoutingVerbose (Ptr<GURoutingProtocol> routingProtocol, std::vector<std::string> tokens);
     void SetApplicationVerbose (Ptr<GUApplication> application, std::vector<std::string> tokens);
@@ -120,6 +128,14 @@ class SimulatorMain
     uint32_t m_notReadyCount;
     uint32_t m_totalNodes, m_totalLinks;
 
+    // Ring checker: period, export file and time of the last JOIN/LEAVE
+    Time m_ringCheckPeriod;
+    EventId m_ringCheckEvent;
+    std::string m_ringCheckFile;
+    Time m_lastRingChurn;
+    bool m_ringConverged, m_fingersConverged;
+    Time m_ringConvergence, m_fingerConvergence;
+
     pthread_t m_commandHandlerThreadId;
     struct CommandHandlerArgument m_thArgument;
 
@@ -132,6 +148,8 @@ SimulatorMain::SimulatorMain ()
 {
   m_realStack = false;
   m_readyToRead = false;
+  m_ringConverged = false;
+  m_fingersConverged = false;
 }
 
 void
@@ -334,6 +352,32 @@ SimulatorMain::ProcessCommandTokens (std::vector<std::string> tokens, Time time)
     {
       std::cout << "Current Time: " <<  Simulator::Now().GetMilliSeconds() << " ms" << std::endl;
     }
+  else if (command == "LOADREPORT")
+    {
+      Simulator::Schedule (MilliSeconds (time.GetMilliSeconds ()), &SimulatorMain::LoadReport, this);
+    }
+  else if (command == "JOINREPORT")
+    {
+      Simulator::Schedule (MilliSeconds (time.GetMilliSeconds ()), &SimulatorMain::JoinReport, this);
+    }
+  else if (command == "RINGCHECK")
+    {
+      // RINGCHECK <period ms> [csv file] | RINGCHECK OFF
+      tokens.erase (iterator);
+      if (tokens.size () == 0)
+        return;
+      iterator = tokens.begin ();
+      UpperCase (*iterator);
+      uint32_t period = 0;
+      if (*iterator != "OFF")
+        {
+          std::istringstream sin (*iterator);
+          sin >> period;
+          period = std::max (period, (uint32_t) 1);
+        }
+      std::string file = tokens.size () > 1 ? tokens[1] : "ringcheck.csv";
+      Simulator::Schedule (MilliSeconds (time.GetMilliSeconds ()), &SimulatorMain::StartRingCheck, this, period, file);
+    }
   else if (tokens.size() < 2)
     {
       return;
@@ -448,6 +492,207 @@ SimulatorMain::ProcessCommandTokens (std::vector<std::string> tokens, Time time)
     }
 }
 
+// Keys stored, requests served and key space owned by every node in the
+// ring, with how far the busiest node is above the mean
+void
+SimulatorMain::LoadReport ()
+{
+  uint32_t nodes = 0;
+  double keys = 0, requests = 0, share = 0;
+  double maxKeys = 0, maxRequests = 0, maxShare = 0;
+  for (uint32_t i = 0; i < m_totalNodes; i++)
+    {
+      Ptr<GUSearch> application = m_nodeContainer.Get(i)->GetApplication(0)->GetObject<GUSearch> ();
+      if (application == 0 || !application->IsInRing ())
+        continue;
+      uint32_t nodeKeys = application->GetKeyCount ();
+      uint32_t nodeRequests = application->GetRequestCount ();
+      double nodeShare = application->GetKeySpaceShare ();
+      std::cout << "Load<Node: " << i << ", Keys: " << nodeKeys << ", Requests: " << nodeRequests << ", KeySpace: " << nodeShare << ">" << std::endl;
+      nodes++;
+      keys += nodeKeys;
+      requests += nodeRequests;
+      share += nodeShare;
+      maxKeys = std::max (maxKeys, (double) nodeKeys);
+      maxRequests = std::max (maxRequests, (double) nodeRequests);
+      maxShare = std::max (maxShare, nodeShare);
+    }
+  if (nodes == 0)
+    {
+      std::cout << "LoadReport: no node in the ring" << std::endl;
+      return;
+    }
+  std::cout << "LoadReport<Nodes: " << nodes
+            << ", MaxMeanKeys: " << (keys > 0 ? maxKeys * nodes / keys : 0)
+            << ", MaxMeanRequests: " << (requests > 0 ? maxRequests * nodes / requests : 0)
+            << ", MaxMeanKeySpace: " << (share > 0 ? maxShare * nodes / share : 0) << ">" << std::endl;
+}
+
+// Hops and time every ring position needed to join, and the time until its
+// fingers were resolved
+void
+SimulatorMain::JoinReport ()
+{
+  uint32_t joined = 0, routed = 0, maxHops = 0;
+  double hops = 0, joinTime = 0, routedTime = 0;
+  int64_t maxJoinTime = 0, maxRoutedTime = 0;
+  for (uint32_t i = 0; i < m_totalNodes; i++)
+    {
+      Ptr<GUSearch> application = m_nodeContainer.Get(i)->GetApplication(0)->GetObject<GUSearch> ();
+      if (application == 0 || application->GetChord () == 0)
+        continue;
+      Ptr<GUChord> chord = application->GetChord ();
+      for (uint32_t v = 0; v < chord->GetVirtualNodeCount (); v++)
+        {
+          chord->SelectVirtualNode (v);
+          // the landmark's first node does not join through anyone
+          if (!chord->in_ring || chord->GetJoinTime ().GetMilliSeconds () == 0)
+            continue;
+          joined++;
+          hops += chord->GetJoinHops ();
+          joinTime += chord->GetJoinTime ().GetMilliSeconds ();
+          maxHops = std::max (maxHops, chord->GetJoinHops ());
+          maxJoinTime = std::max (maxJoinTime, chord->GetJoinTime ().GetMilliSeconds ());
+          if (chord->GetJoinRoutedTime ().GetMilliSeconds () > 0)
+            {
+              routed++;
+              routedTime += chord->GetJoinRoutedTime ().GetMilliSeconds ();
+              maxRoutedTime = std::max (maxRoutedTime, chord->GetJoinRoutedTime ().GetMilliSeconds ());
+            }
+        }
+      chord->SelectVirtualNode (0);
+    }
+  if (joined == 0)
+    {
+      std::cout << "JoinReport: no node joined" << std::endl;
+      return;
+    }
+  std::cout << "JoinReport<Joined: " << joined
+            << ", MeanHops: " << hops / joined << ", MaxHops: " << maxHops
+            << ", MeanJoinTime: " << joinTime / joined << "ms, MaxJoinTime: " << maxJoinTime << "ms"
+            << ", Routed: " << routed
+            << ", MeanRoutedTime: " << (routed > 0 ? routedTime / routed : 0) << "ms, MaxRoutedTime: " << maxRoutedTime << "ms>" << std::endl;
+}
+
+// A period of 0 stops the checker
+void
+SimulatorMain::StartRingCheck (uint32_t periodMs, std::string file)
+{
+  m_ringCheckEvent.Cancel ();
+  m_ringCheckPeriod = MilliSeconds (periodMs);
+  if (periodMs == 0)
+    return;
+  if (file != m_ringCheckFile)
+    {
+      m_ringCheckFile = file;
+      std::ofstream csv (m_ringCheckFile.c_str ());
+      csv << "time_ms,positions,successors_ok,predecessors_ok,fingers_ok,fingers,ring_converged,ring_convergence_ms,fingers_converged,finger_convergence_ms" << std::endl;
+    }
+  RingCheck ();
+}
+
+void
+SimulatorMain::MarkRingChurn ()
+{
+  m_lastRingChurn = Simulator::Now ();
+  m_ringConverged = false;
+  m_fingersConverged = false;
+}
+
+// Position on the ideal ring: the key and where it belongs
+struct RingPosition
+{
+  ChordId key;
+  uint32_t node;
+  uint8_t vnode;
+  bool operator< (const RingPosition &other) const { return key < other.key; }
+};
+
+static uint32_t
+IdealOwner (const std::vector<RingPosition> &ring, const ChordId &key)
+{
+  RingPosition target;
+  target.key = key;
+  uint32_t index = std::lower_bound (ring.begin (), ring.end (), target) - ring.begin ();
+  return index == ring.size () ? 0 : index;
+}
+
+// Compares every GUChord's successor, predecessor and fingers with the ring
+// its members' keys define, and records when the ring and the fingers
+// became correct after the last JOIN/LEAVE; one CSV row per check
+void
+SimulatorMain::RingCheck ()
+{
+  std::vector<RingPosition> ring;
+  for (uint32_t i = 0; i < m_totalNodes; i++)
+    {
+      Ptr<GUSearch> application = m_nodeContainer.Get(i)->GetApplication(0)->GetObject<GUSearch> ();
+      if (application == 0 || application->GetChord () == 0)
+        continue;
+      Ptr<GUChord> chord = application->GetChord ();
+      for (uint32_t v = 0; v < chord->GetVirtualNodeCount (); v++)
+        {
+          chord->SelectVirtualNode (v);
+          if (!chord->in_ring)
+            continue;
+          RingPosition position;
+          position.key = chord->my_node_key;
+          position.node = i;
+          position.vnode = v;
+          ring.push_back (position);
+        }
+      chord->SelectVirtualNode (0);
+    }
+  std::sort (ring.begin (), ring.end ());
+
+  uint32_t successorsOk = 0, predecessorsOk = 0, fingersOk = 0, fingers = 0;
+  for (uint32_t k = 0; k < ring.size (); k++)
+    {
+      Ptr<GUChord> chord = m_nodeContainer.Get(ring[k].node)->GetApplication(0)->GetObject<GUSearch> ()->GetChord ();
+      chord->SelectVirtualNode (ring[k].vnode);
+      const RingPosition &successor = ring[(k + 1) % ring.size ()];
+      const RingPosition &predecessor = ring[(k + ring.size () - 1) % ring.size ()];
+      if (chord->successor_node_key == successor.key && chord->successor_id == successor.node)
+        successorsOk++;
+      if (chord->predecessor_node_key == predecessor.key && chord->predecessor_id == predecessor.node)
+        predecessorsOk++;
+      for (uint32_t j = 0; j < chord->finger_table.size (); j++)
+        {
+          fingers++;
+          if (chord->finger_table[j].finger_key_hash == ring[IdealOwner (ring, chord->finger_table[j].start_value)].key)
+            fingersOk++;
+        }
+      chord->SelectVirtualNode (0);
+    }
+
+  bool ringCorrect = !ring.empty () && successorsOk == ring.size () && predecessorsOk == ring.size ();
+  bool fingersCorrect = ringCorrect && fingersOk == fingers;
+  if (ringCorrect && !m_ringConverged)
+    {
+      m_ringConverged = true;
+      m_ringConvergence = Simulator::Now () - m_lastRingChurn;
+      std::cout << "RingCheck: ring converged " << m_ringConvergence.GetMilliSeconds () << " ms after the last join/leave, " << ring.size () << " positions" << std::endl;
+    }
+  if (fingersCorrect && !m_fingersConverged)
+    {
+      m_fingersConverged = true;
+      m_fingerConvergence = Simulator::Now () - m_lastRingChurn;
+      std::cout << "RingCheck: fingers converged " << m_fingerConvergence.GetMilliSeconds () << " ms after the last join/leave" << std::endl;
+    }
+  // correctness can be lost again without churn, e.g. a node failing
+  m_ringConverged = m_ringConverged && ringCorrect;
+  m_fingersConverged = m_fingersConverged && fingersCorrect;
+
+  std::ofstream file (m_ringCheckFile.c_str (), std::ios::app);
+  file << Simulator::Now ().GetMilliSeconds () << "," << ring.size () << "," << successorsOk << "," << predecessorsOk << ","
+       << fingersOk << "," << fingers << "," << m_ringConverged << ","
+       << (m_ringConverged ? m_ringConvergence.GetMilliSeconds () : -1) << "," << m_fingersConverged << ","
+       << (m_fingersConverged ? m_fingerConvergence.GetMilliSeconds () : -1) << std::endl;
+
+  if (m_ringCheckPeriod.GetMilliSeconds () > 0)
+    m_ringCheckEvent = Simulator::Schedule (m_ringCheckPeriod, &SimulatorMain::RingCheck, this);
+}
+
 void
 SimulatorMain::ProcessNodeCommandTokens (uint32_t nodeNumber, std::vector<std::string> tokens, Time time)
 {
@@ -483,6 +728,14 @@ SimulatorMain::ProcessNodeCommandTokens (uint32_t nodeNumber, std::vector<std::s
         }
       else
         {
+          // the ring checker times convergence from the last membership change
+          if (command == "CHORD" && tokens.size () > 1)
+            {
+              std::string operation = tokens[1];
+              UpperCase (operation);
+              if (operation == "JOIN" || operation == "LEAVE")
+                Simulator::Schedule (MilliSeconds (time.GetMilliSeconds()), &SimulatorMain::MarkRingChurn, this);
+            }
           Simulator::Schedule (MilliSeconds (time.GetMilliSeconds()), &GUSearch::ProcessCommand, application, tokens);
           return;
         }